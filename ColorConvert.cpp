@@ -0,0 +1,389 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : ColorConvert.cpp             | SIMD RGBA to NV12 and P010         |
+| Author   : Alexandre Buge               | conversion                         |
+| Started  : 17/10/2026 03:10             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "ColorConvert.h"
+#include "DX12SharedData.h" // for SharedBufferFormat
+#include "FrameCapture.h" // for toBGRA8
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+# define COLOR_CONVERT_X86
+# include <immintrin.h>
+# ifdef _MSC_VER
+#  define COLOR_CONVERT_TARGET(isa) // every intrinsic is available
+# else
+#  define COLOR_CONVERT_TARGET(isa) __attribute__((target(isa)))
+# endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+# define COLOR_CONVERT_NEON
+# include <arm_neon.h>
+#endif
+
+// BT.709 limited range, 15 bits fixed point, red green blue, each chroma row sums to 0
+#define COLOR_CONVERT_SHIFT 15
+static const int32_t lumaCoefficients[3] = { 5983, 20127, 2032 };
+static const int32_t blueCoefficients[3] = { -3298, -11094, 14392 };
+static const int32_t redCoefficients[3] = { 14392, -13073, -1319 };
+
+namespace colorconvert
+{
+
+static const char* formatNames[NUM_FORMATS] = { "rgb", "nv12", "p010" };
+
+const char* getFormatName(uint32_t format)
+  {return format < NUM_FORMATS ? formatNames[format] : "unknown";}
+
+uint32_t findFormat(const char* name)
+{
+  for (uint32_t i = 0; i < NUM_FORMATS; ++i)
+    if (!strcmp(name, formatNames[i]))
+      return i;
+  return NUM_FORMATS;
+}
+
+struct Matrix
+{
+  uint32_t red;  // byte of the channel in a pixel
+  uint32_t blue;
+  bool wide;     // P010, 10 bits values in 16 bits samples
+  int32_t lumaShift;
+  int32_t lumaBias;   // offset and rounding
+  int32_t chromaShift; // 2 more bits, the sum of 4 pixels
+  int32_t chromaBias;
+};
+
+static Matrix getMatrix(bool bgra, uint32_t format)
+{
+  Matrix res;
+  res.red = bgra ? 2 : 0;
+  res.blue = bgra ? 0 : 2;
+  res.wide = format == FORMAT_P010;
+  const int32_t extraBits = res.wide ? 2 : 0;
+  res.lumaShift = COLOR_CONVERT_SHIFT - extraBits;
+  res.lumaBias = ((16 << extraBits) << res.lumaShift) + (1 << (res.lumaShift - 1));
+  res.chromaShift = COLOR_CONVERT_SHIFT + 2 - extraBits;
+  res.chromaBias = ((128 << extraBits) << res.chromaShift) + (1 << (res.chromaShift - 1));
+  return res;
+}
+
+static inline void storeSample(uint8_t* plane, uint32_t index, int32_t value, bool wide)
+{
+  if (wide)
+  {
+    const uint16_t sample = (uint16_t)(value << 6);
+    memcpy(plane + index * 2, &sample, sizeof(sample));
+  }
+  else
+    plane[index] = (uint8_t)value;
+}
+
+/* ---------------------------------------- */
+
+// from pixel x of a row pair on, x even, the SIMD versions leave their tail to it
+static void convertRowsScalar(const uint8_t* row0, const uint8_t* row1, uint8_t* luma0, uint8_t* luma1, uint8_t* chroma,
+                              uint32_t x, uint32_t width, const Matrix& m)
+{
+  for (; x < width; x += 2)
+  {
+    const uint32_t x1 = x + 1 < width ? x + 1 : x;
+    const uint8_t* pixels[4] = { row0 + x * 4, row0 + x1 * 4, row1 + x * 4, row1 + x1 * 4 };
+    uint8_t* lumas[4] = { luma0, luma0, luma1, luma1 };
+    const uint32_t indices[4] = { x, x1, x, x1 };
+    int32_t red = 0, green = 0, blue = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+      const int32_t r = pixels[i][m.red], g = pixels[i][1], b = pixels[i][m.blue];
+      const int32_t luma = (lumaCoefficients[0] * r + lumaCoefficients[1] * g + lumaCoefficients[2] * b + m.lumaBias) >> m.lumaShift;
+      storeSample(lumas[i], indices[i], luma, m.wide);
+      red += r;
+      green += g;
+      blue += b;
+    }
+    storeSample(chroma, x, (blueCoefficients[0] * red + blueCoefficients[1] * green + blueCoefficients[2] * blue + m.chromaBias) >> m.chromaShift, m.wide);
+    storeSample(chroma, x + 1, (redCoefficients[0] * red + redCoefficients[1] * green + redCoefficients[2] * blue + m.chromaBias) >> m.chromaShift, m.wide);
+  }
+}
+
+#ifdef COLOR_CONVERT_X86
+// 16 bits coefficient pairs for the [byte 0, byte 2] and [byte 1, byte 3] channels of a pixel
+static inline int32_t lowPair(const int32_t* coefficients, const Matrix& m)
+{
+  const int32_t first = m.red ? coefficients[2] : coefficients[0];
+  const int32_t second = m.red ? coefficients[0] : coefficients[2];
+  return (int32_t)(((uint32_t)(uint16_t)second << 16) | (uint16_t)first);
+}
+
+static inline int32_t highPair(const int32_t* coefficients)
+  {return (int32_t)(uint16_t)coefficients[1];}
+
+COLOR_CONVERT_TARGET("sse4.1")
+static inline __m128i lumaSSE41(__m128i pixels, __m128i mask, __m128i lowCoefficients, __m128i highCoefficients, __m128i bias, __m128i shift)
+{
+  const __m128i low = _mm_and_si128(pixels, mask);
+  const __m128i high = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+  const __m128i sum = _mm_add_epi32(_mm_madd_epi16(low, lowCoefficients), _mm_madd_epi16(high, highCoefficients));
+  return _mm_sra_epi32(_mm_add_epi32(sum, bias), shift);
+}
+
+// 4 pixels of each row, Cb Cr of their 2 blocks
+COLOR_CONVERT_TARGET("sse4.1")
+static inline __m128i chromaSSE41(__m128i pixels0, __m128i pixels1, const __m128i* coefficients, __m128i mask, __m128i bias, __m128i shift)
+{
+  __m128i low = _mm_add_epi16(_mm_and_si128(pixels0, mask), _mm_and_si128(pixels1, mask));
+  __m128i high = _mm_add_epi16(_mm_and_si128(_mm_srli_epi32(pixels0, 8), mask), _mm_and_si128(_mm_srli_epi32(pixels1, 8), mask));
+  // even lanes hold the block sums
+  low = _mm_add_epi16(low, _mm_srli_epi64(low, 32));
+  high = _mm_add_epi16(high, _mm_srli_epi64(high, 32));
+  const __m128i blue = _mm_add_epi32(_mm_madd_epi16(low, coefficients[0]), _mm_madd_epi16(high, coefficients[1]));
+  const __m128i red = _mm_add_epi32(_mm_madd_epi16(low, coefficients[2]), _mm_madd_epi16(high, coefficients[3]));
+  const __m128i pairs = _mm_blend_epi16(blue, _mm_slli_epi64(red, 32), 0xcc);
+  return _mm_sra_epi32(_mm_add_epi32(pairs, bias), shift);
+}
+
+// 8 samples
+COLOR_CONVERT_TARGET("sse4.1")
+static inline void storeSSE41(uint8_t* plane, uint32_t index, __m128i samples, bool wide)
+{
+  if (wide)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(plane + index * 2), _mm_slli_epi16(samples, 6));
+  else
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(plane + index), _mm_packus_epi16(samples, samples));
+}
+
+// 8 pixels per step
+COLOR_CONVERT_TARGET("sse4.1")
+static uint32_t convertRowsSSE41(const uint8_t* row0, const uint8_t* row1, uint8_t* luma0, uint8_t* luma1, uint8_t* chroma,
+                                 uint32_t width, const Matrix& m)
+{
+  const __m128i mask = _mm_set1_epi32(0x00ff00ff);
+  const __m128i lumaLow = _mm_set1_epi32(lowPair(lumaCoefficients, m));
+  const __m128i lumaHigh = _mm_set1_epi32(highPair(lumaCoefficients));
+  const __m128i chromaCoefficients[4] = { _mm_set1_epi32(lowPair(blueCoefficients, m)), _mm_set1_epi32(highPair(blueCoefficients)),
+                                          _mm_set1_epi32(lowPair(redCoefficients, m)), _mm_set1_epi32(highPair(redCoefficients)) };
+  const __m128i lumaBias = _mm_set1_epi32(m.lumaBias);
+  const __m128i lumaShift = _mm_cvtsi32_si128(m.lumaShift);
+  const __m128i chromaBias = _mm_set1_epi32(m.chromaBias);
+  const __m128i chromaShift = _mm_cvtsi32_si128(m.chromaShift);
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8)
+  {
+    const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 4));
+    const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 4 + 16));
+    const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 4));
+    const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 4 + 16));
+    storeSSE41(luma0, x, _mm_packs_epi32(lumaSSE41(a0, mask, lumaLow, lumaHigh, lumaBias, lumaShift),
+                                         lumaSSE41(b0, mask, lumaLow, lumaHigh, lumaBias, lumaShift)), m.wide);
+    storeSSE41(luma1, x, _mm_packs_epi32(lumaSSE41(a1, mask, lumaLow, lumaHigh, lumaBias, lumaShift),
+                                         lumaSSE41(b1, mask, lumaLow, lumaHigh, lumaBias, lumaShift)), m.wide);
+    storeSSE41(chroma, x, _mm_packs_epi32(chromaSSE41(a0, a1, chromaCoefficients, mask, chromaBias, chromaShift),
+                                          chromaSSE41(b0, b1, chromaCoefficients, mask, chromaBias, chromaShift)), m.wide);
+  }
+  return x;
+}
+
+COLOR_CONVERT_TARGET("avx2")
+static inline __m256i lumaAVX2(__m256i pixels, __m256i mask, __m256i lowCoefficients, __m256i highCoefficients, __m256i bias, __m128i shift)
+{
+  const __m256i low = _mm256_and_si256(pixels, mask);
+  const __m256i high = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask);
+  const __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(low, lowCoefficients), _mm256_madd_epi16(high, highCoefficients));
+  return _mm256_sra_epi32(_mm256_add_epi32(sum, bias), shift);
+}
+
+COLOR_CONVERT_TARGET("avx2")
+static inline __m256i chromaAVX2(__m256i pixels0, __m256i pixels1, const __m256i* coefficients, __m256i mask, __m256i bias, __m128i shift)
+{
+  __m256i low = _mm256_add_epi16(_mm256_and_si256(pixels0, mask), _mm256_and_si256(pixels1, mask));
+  __m256i high = _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi32(pixels0, 8), mask), _mm256_and_si256(_mm256_srli_epi32(pixels1, 8), mask));
+  low = _mm256_add_epi16(low, _mm256_srli_epi64(low, 32));
+  high = _mm256_add_epi16(high, _mm256_srli_epi64(high, 32));
+  const __m256i blue = _mm256_add_epi32(_mm256_madd_epi16(low, coefficients[0]), _mm256_madd_epi16(high, coefficients[1]));
+  const __m256i red = _mm256_add_epi32(_mm256_madd_epi16(low, coefficients[2]), _mm256_madd_epi16(high, coefficients[3]));
+  const __m256i pairs = _mm256_blend_epi32(blue, _mm256_slli_epi64(red, 32), 0xaa);
+  return _mm256_sra_epi32(_mm256_add_epi32(pairs, bias), shift);
+}
+
+// 16 samples from two vectors of 8, packs works per 128 bits lane
+COLOR_CONVERT_TARGET("avx2")
+static inline void storeAVX2(uint8_t* plane, uint32_t index, __m256i first, __m256i second, bool wide)
+{
+  const __m256i samples = _mm256_permute4x64_epi64(_mm256_packs_epi32(first, second), 0xd8);
+  if (wide)
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(plane + index * 2), _mm256_slli_epi16(samples, 6));
+  else
+  {
+    const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(samples, samples), 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(plane + index), _mm256_castsi256_si128(bytes));
+  }
+}
+
+// 16 pixels per step
+COLOR_CONVERT_TARGET("avx2")
+static uint32_t convertRowsAVX2(const uint8_t* row0, const uint8_t* row1, uint8_t* luma0, uint8_t* luma1, uint8_t* chroma,
+                                uint32_t width, const Matrix& m)
+{
+  const __m256i mask = _mm256_set1_epi32(0x00ff00ff);
+  const __m256i lumaLow = _mm256_set1_epi32(lowPair(lumaCoefficients, m));
+  const __m256i lumaHigh = _mm256_set1_epi32(highPair(lumaCoefficients));
+  const __m256i chromaCoefficients[4] = { _mm256_set1_epi32(lowPair(blueCoefficients, m)), _mm256_set1_epi32(highPair(blueCoefficients)),
+                                          _mm256_set1_epi32(lowPair(redCoefficients, m)), _mm256_set1_epi32(highPair(redCoefficients)) };
+  const __m256i lumaBias = _mm256_set1_epi32(m.lumaBias);
+  const __m128i lumaShift = _mm_cvtsi32_si128(m.lumaShift);
+  const __m256i chromaBias = _mm256_set1_epi32(m.chromaBias);
+  const __m128i chromaShift = _mm_cvtsi32_si128(m.chromaShift);
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16)
+  {
+    const __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + x * 4));
+    const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + x * 4 + 32));
+    const __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + x * 4));
+    const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + x * 4 + 32));
+    storeAVX2(luma0, x, lumaAVX2(a0, mask, lumaLow, lumaHigh, lumaBias, lumaShift), lumaAVX2(b0, mask, lumaLow, lumaHigh, lumaBias, lumaShift), m.wide);
+    storeAVX2(luma1, x, lumaAVX2(a1, mask, lumaLow, lumaHigh, lumaBias, lumaShift), lumaAVX2(b1, mask, lumaLow, lumaHigh, lumaBias, lumaShift), m.wide);
+    storeAVX2(chroma, x, chromaAVX2(a0, a1, chromaCoefficients, mask, chromaBias, chromaShift),
+              chromaAVX2(b0, b1, chromaCoefficients, mask, chromaBias, chromaShift), m.wide);
+  }
+  return x;
+}
+#endif // COLOR_CONVERT_X86
+
+#ifdef COLOR_CONVERT_NEON
+static inline uint16x8_t lumaNEON(uint8x8_t r, uint8x8_t g, uint8x8_t b, const Matrix& m)
+{
+  const uint16x8_t r16 = vmovl_u8(r), g16 = vmovl_u8(g), b16 = vmovl_u8(b);
+  const uint32x4_t bias = vdupq_n_u32((uint32_t)m.lumaBias);
+  const int32x4_t shift = vdupq_n_s32(-m.lumaShift);
+  uint32x4_t low = vmlal_n_u16(bias, vget_low_u16(r16), (uint16_t)lumaCoefficients[0]);
+  low = vmlal_n_u16(low, vget_low_u16(g16), (uint16_t)lumaCoefficients[1]);
+  low = vmlal_n_u16(low, vget_low_u16(b16), (uint16_t)lumaCoefficients[2]);
+  uint32x4_t high = vmlal_n_u16(bias, vget_high_u16(r16), (uint16_t)lumaCoefficients[0]);
+  high = vmlal_n_u16(high, vget_high_u16(g16), (uint16_t)lumaCoefficients[1]);
+  high = vmlal_n_u16(high, vget_high_u16(b16), (uint16_t)lumaCoefficients[2]);
+  return vcombine_u16(vmovn_u32(vshlq_u32(low, shift)), vmovn_u32(vshlq_u32(high, shift)));
+}
+
+// block sums of 8 blocks
+static inline uint16x8_t chromaNEON(int16x8_t r, int16x8_t g, int16x8_t b, const int32_t* coefficients, const Matrix& m)
+{
+  const int32x4_t bias = vdupq_n_s32(m.chromaBias);
+  const int32x4_t shift = vdupq_n_s32(-m.chromaShift);
+  int32x4_t low = vmlal_n_s16(bias, vget_low_s16(r), (int16_t)coefficients[0]);
+  low = vmlal_n_s16(low, vget_low_s16(g), (int16_t)coefficients[1]);
+  low = vmlal_n_s16(low, vget_low_s16(b), (int16_t)coefficients[2]);
+  int32x4_t high = vmlal_n_s16(bias, vget_high_s16(r), (int16_t)coefficients[0]);
+  high = vmlal_n_s16(high, vget_high_s16(g), (int16_t)coefficients[1]);
+  high = vmlal_n_s16(high, vget_high_s16(b), (int16_t)coefficients[2]);
+  return vreinterpretq_u16_s16(vcombine_s16(vmovn_s32(vshlq_s32(low, shift)), vmovn_s32(vshlq_s32(high, shift))));
+}
+
+static inline void storeLumaNEON(uint8_t* plane, uint32_t index, uint16x8_t first, uint16x8_t second, bool wide)
+{
+  if (wide)
+  {
+    uint16_t* samples = reinterpret_cast<uint16_t*>(plane) + index;
+    vst1q_u16(samples, vshlq_n_u16(first, 6));
+    vst1q_u16(samples + 8, vshlq_n_u16(second, 6));
+  }
+  else
+    vst1q_u8(plane + index, vcombine_u8(vmovn_u16(first), vmovn_u16(second)));
+}
+
+// 16 pixels per step, the loads split the channels
+static uint32_t convertRowsNEON(const uint8_t* row0, const uint8_t* row1, uint8_t* luma0, uint8_t* luma1, uint8_t* chroma,
+                                uint32_t width, const Matrix& m)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16)
+  {
+    const uint8x16x4_t pixels0 = vld4q_u8(row0 + x * 4);
+    const uint8x16x4_t pixels1 = vld4q_u8(row1 + x * 4);
+    const uint8x16_t r0 = pixels0.val[m.red], g0 = pixels0.val[1], b0 = pixels0.val[m.blue];
+    const uint8x16_t r1 = pixels1.val[m.red], g1 = pixels1.val[1], b1 = pixels1.val[m.blue];
+    storeLumaNEON(luma0, x, lumaNEON(vget_low_u8(r0), vget_low_u8(g0), vget_low_u8(b0), m),
+                  lumaNEON(vget_high_u8(r0), vget_high_u8(g0), vget_high_u8(b0), m), m.wide);
+    storeLumaNEON(luma1, x, lumaNEON(vget_low_u8(r1), vget_low_u8(g1), vget_low_u8(b1), m),
+                  lumaNEON(vget_high_u8(r1), vget_high_u8(g1), vget_high_u8(b1), m), m.wide);
+
+    const int16x8_t r = vreinterpretq_s16_u16(vpadalq_u8(vpaddlq_u8(r0), r1));
+    const int16x8_t g = vreinterpretq_s16_u16(vpadalq_u8(vpaddlq_u8(g0), g1));
+    const int16x8_t b = vreinterpretq_s16_u16(vpadalq_u8(vpaddlq_u8(b0), b1));
+    const uint16x8_t blue = chromaNEON(r, g, b, blueCoefficients, m);
+    const uint16x8_t red = chromaNEON(r, g, b, redCoefficients, m);
+    if (m.wide)
+    {
+      const uint16x8x2_t pairs = { { vshlq_n_u16(blue, 6), vshlq_n_u16(red, 6) } };
+      vst2q_u16(reinterpret_cast<uint16_t*>(chroma) + x, pairs);
+    }
+    else
+    {
+      const uint8x8x2_t pairs = { { vmovn_u16(blue), vmovn_u16(red) } };
+      vst2_u8(chroma + x, pairs);
+    }
+  }
+  return x;
+}
+#endif // COLOR_CONVERT_NEON
+
+/* ---------------------------------------- */
+
+typedef uint32_t (*ConvertRows)(const uint8_t* row0, const uint8_t* row1, uint8_t* luma0, uint8_t* luma1, uint8_t* chroma,
+                                uint32_t width, const Matrix& m);
+
+void convert(const uint8_t* pixels, uint32_t rowPitch, bool bgra, uint32_t width, uint32_t height, uint32_t format, uint8_t* dst, uint32_t isa)
+{
+  if (format == FORMAT_NONE || format >= NUM_FORMATS)
+    return;
+  ConvertRows convertRows = nullptr;
+#ifdef COLOR_CONVERT_X86
+  if (isa == framecompare::ISA_AVX2 && framecompare::isSupported(framecompare::ISA_AVX2))
+    convertRows = convertRowsAVX2;
+  else if (isa == framecompare::ISA_SSE41 && framecompare::isSupported(framecompare::ISA_SSE41))
+    convertRows = convertRowsSSE41;
+#endif
+#ifdef COLOR_CONVERT_NEON
+  if (isa == framecompare::ISA_NEON)
+    convertRows = convertRowsNEON;
+#endif
+
+  const Matrix m = getMatrix(bgra, format);
+  const uint32_t pitch = getPitch(width, format);
+  uint8_t* chroma = dst + getChromaOffset(width, height, format);
+  for (uint32_t y = 0; y < height; y += 2, chroma += pitch)
+  {
+    // an odd last row is its own pair, its luma written twice
+    const bool pair = y + 1 < height;
+    const uint8_t* row0 = pixels + (size_t)y * rowPitch;
+    const uint8_t* row1 = pair ? row0 + rowPitch : row0;
+    uint8_t* luma0 = dst + (size_t)y * pitch;
+    uint8_t* luma1 = pair ? luma0 + pitch : luma0;
+    const uint32_t x = convertRows ? convertRows(row0, row1, luma0, luma1, chroma, width, m) : 0;
+    convertRowsScalar(row0, row1, luma0, luma1, chroma, x, width, m);
+  }
+}
+
+void convertShared(const uint8_t* pixels, uint32_t rowPitch, uint32_t sharedFormat, uint32_t width, uint32_t height, uint32_t format,
+                   uint8_t* dst, std::vector<uint8_t>& scratch)
+{
+  switch (sharedFormat)
+  {
+    case SHARED_FORMAT_RGBA8:
+    case SHARED_FORMAT_RGBA8_SRGB:
+      convert(pixels, rowPitch, false, width, height, format, dst);
+      break;
+    case SHARED_FORMAT_BGRA8:
+    case SHARED_FORMAT_BGRA8_SRGB:
+      convert(pixels, rowPitch, true, width, height, format, dst);
+      break;
+    default:
+      scratch.resize((size_t)width * 4 * height);
+      for (uint32_t y = 0; y < height; ++y)
+        FrameCapture::toBGRA8(pixels + (size_t)y * rowPitch, scratch.data() + (size_t)y * width * 4, width, sharedFormat);
+      convert(scratch.data(), width * 4, true, width, height, format, dst);
+  }
+}
+
+}; /* namespace colorconvert */
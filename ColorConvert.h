@@ -0,0 +1,56 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : ColorConvert.h               | SIMD RGBA to NV12 and P010         |
+| Author   : Alexandre Buge               | conversion                         |
+| Started  : 17/10/2026 03:10             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _COLOR_CONVERT_H_
+#define _COLOR_CONVERT_H_
+
+#include "FrameCompare.h" // for Isa
+#include <stddef.h>
+#include <vector>
+
+/*
+** 4:2:0 frames for the encoders, BT.709 limited range in 15 bits fixed point, chroma averaged
+** over each 2x2 block (centered, an odd last row or column is repeated).
+** The layout is the one of DXGI_FORMAT_NV12 and P010 in a linear buffer: height luma rows then
+** (height + 1) / 2 rows of interleaved Cb Cr pairs, both planes at getPitch(), which holds width
+** rounded up to 4 samples so a GPU writes whole 32 bits words. P010 samples are 16 bits little
+** endian with the value in their 10 high bits.
+** The kernels take 8 bits RGBA or BGRA rows and have a scalar, an SSE4.1, an AVX2 and a NEON
+** version returning the same bytes, the producer GPU pass of VkRender computes them alike.
+*/
+namespace colorconvert
+{
+
+enum Format
+{
+  FORMAT_NONE, // RGB as shared, no conversion
+  FORMAT_NV12,
+  FORMAT_P010,
+  NUM_FORMATS
+};
+
+const char* getFormatName(uint32_t format);
+uint32_t findFormat(const char* name); // NUM_FORMATS when unknown
+
+inline uint32_t getBytesPerSample(uint32_t format)
+  {return format == FORMAT_P010 ? 2 : 1;}
+inline uint32_t getPitch(uint32_t width, uint32_t format)
+  {return ((width + 3) & ~3u) * getBytesPerSample(format);}
+inline size_t getChromaOffset(uint32_t width, uint32_t height, uint32_t format)
+  {return (size_t)getPitch(width, format) * height;}
+inline size_t getSize(uint32_t width, uint32_t height, uint32_t format)
+  {return format == FORMAT_NONE ? 0 : (size_t)getPitch(width, format) * (height + (height + 1) / 2);}
+
+void convert(const uint8_t* pixels, uint32_t rowPitch, bool bgra, uint32_t width, uint32_t height, uint32_t format, uint8_t* dst,
+             uint32_t isa = framecompare::getBestIsa());
+
+// any SharedBufferFormat, the ones without 8 bits channels are first expanded to BGRA8 in scratch
+void convertShared(const uint8_t* pixels, uint32_t rowPitch, uint32_t sharedFormat, uint32_t width, uint32_t height, uint32_t format,
+                   uint8_t* dst, std::vector<uint8_t>& scratch);
+
+}; /* namespace colorconvert */
+
+#endif // _COLOR_CONVERT_H_
@@ -9,13 +9,79 @@
 #include "DX12Present.h"
 #include "stdio.h"
 #include "DX12SharedData.h"
+#include "ColorConvert.h"
+#include "Trace.h"
 #include "d3d12.h"
 
 #define NVIDIA_VENDOR_ID    0x10DE
 
+static DXGI_FORMAT SharedTextureFormat(UINT format)
+{
+    switch (format) {
+    case SHARED_FORMAT_RGBA8_SRGB:  return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    case SHARED_FORMAT_BGRA8:       return DXGI_FORMAT_B8G8R8A8_UNORM;
+    case SHARED_FORMAT_BGRA8_SRGB:  return DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+    case SHARED_FORMAT_RGB10A2:     return DXGI_FORMAT_R10G10B10A2_UNORM;
+    case SHARED_FORMAT_RGBA16F:     return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    default:                        return DXGI_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+// flip model back buffers cannot be sRGB, the copy from the sRGB shared texture keeps the encoded values
+static DXGI_FORMAT SwapChainFormat(UINT format)
+{
+    switch (format) {
+    case SHARED_FORMAT_RGBA8_SRGB:  return DXGI_FORMAT_R8G8B8A8_UNORM;
+    case SHARED_FORMAT_BGRA8_SRGB:  return DXGI_FORMAT_B8G8R8A8_UNORM;
+    default:                        return SharedTextureFormat(format);
+    }
+}
+
+uint64_t DX12GpuClock::getTimestampFrequency()
+{
+    UINT64 frequency = 0;
+    if (FAILED(pCommandQueue->GetTimestampFrequency(&frequency)))
+        return 0;
+    return frequency;
+}
+
+bool DX12GpuClock::getCalibration(uint64_t& gpuTimestamp, int64_t& cpuTicks)
+{
+    UINT64 gpu, cpu;
+    if (FAILED(pCommandQueue->GetClockCalibration(&gpu, &cpu)))
+        return false;
+    gpuTimestamp = gpu;
+    cpuTicks = (int64_t)cpu;
+    return true;
+}
+
 DX12Present::DX12Present()
+    : m_hDC(0)
+    , m_pFactory(nullptr)
+    , m_pAdapter(nullptr)
+    , m_pDevice(nullptr)
+    , m_pSwapChain(nullptr)
+    , m_pCommandAllocator(nullptr)
+    , m_pCommandQueue(nullptr)
+    , m_pTimestampHeap(nullptr)
+    , m_pTimestampReadback(nullptr)
+    , m_pTimestamps(nullptr)
+    , m_captureSlots()
+    , m_pCaptureFence(nullptr)
+    , m_captureFenceValue(0)
+    , m_sharedFormat(DXGI_FORMAT_R8G8B8A8_UNORM)
+    , m_swapChainFormat(DXGI_FORMAT_R8G8B8A8_UNORM)
+    , m_viewport()
+    , m_scissorRect()
+    , m_pSharedData(nullptr)
+    , m_pSharedHeap(nullptr)
+    , m_sharedHeapHandle(nullptr)
+    , m_sharedHeapStride(0)
+    , m_numSharedBuffers(0)
+    , m_frameIndex(0)
+    , m_numFrames(0)
+    , m_initialized(false)
 {
-    ZeroMemory(this, sizeof(DX12Present));
 }
 
 DX12Present::~DX12Present()
@@ -27,7 +93,11 @@ bool DX12Present::Init(DX12SharedData* pSharedData)
 {
     m_pSharedData = pSharedData;
 
-    m_hDC = GetDC(pSharedData->hWnd);
+    // headless without a window, the back buffers are offscreen textures and nothing is shown
+    const bool headless = !pSharedData->config.hWnd;
+    if (!headless) {
+        m_hDC = GetDC(pSharedData->config.hWnd);
+    }
 
 #ifdef _DEBUG
     if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
@@ -65,7 +135,9 @@ bool DX12Present::Init(DX12SharedData* pSharedData)
         //if (adapterDesc.VendorId == NVIDIA_VENDOR_ID)
         {
             foundNvDevice = true;
-            m_pSharedData->AdapterLuid = adapterDesc.AdapterLuid;
+            m_pSharedData->BeginConfigWrite();
+            m_pSharedData->config.AdapterLuid = adapterDesc.AdapterLuid;
+            m_pSharedData->EndConfigWrite();
             break;
         }
         i++;
@@ -88,27 +160,42 @@ bool DX12Present::Init(DX12SharedData* pSharedData)
     if (FAILED(hr))
         return false;
 
-    DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-    swapChainDesc.BufferCount = m_pSharedData->numSharedBuffers;
-    swapChainDesc.Width = m_pSharedData->width;
-    swapChainDesc.Height = m_pSharedData->height;
-    swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-    swapChainDesc.SampleDesc.Count = 1;
-
-    IDXGISwapChain1* swapChain = NULL;
-    hr = m_pFactory->CreateSwapChainForHwnd(m_pCommandQueue, m_pSharedData->hWnd, &swapChainDesc, NULL, NULL, &swapChain);
-    if (SUCCEEDED(hr)) {
-        hr = swapChain->QueryInterface(__uuidof(IDXGISwapChain3), (void**)&m_pSwapChain);
-    }
-    if (swapChain) {
-        swapChain->Release();
-    }
-    if (FAILED(hr))
+    if (!NegotiateFormat())
         return false;
 
-    m_pFactory->MakeWindowAssociation(m_pSharedData->hWnd, DXGI_MWA_NO_ALT_ENTER);
+    if (!headless) {
+        DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+        swapChainDesc.BufferCount = m_pSharedData->numSharedBuffers;
+        swapChainDesc.Width = m_pSharedData->config.width;
+        swapChainDesc.Height = m_pSharedData->config.height;
+        swapChainDesc.Format = m_swapChainFormat;
+        swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+        swapChainDesc.SampleDesc.Count = 1;
+
+        IDXGISwapChain1* swapChain = NULL;
+        hr = m_pFactory->CreateSwapChainForHwnd(m_pCommandQueue, m_pSharedData->config.hWnd, &swapChainDesc, NULL, NULL, &swapChain);
+        if (SUCCEEDED(hr)) {
+            hr = swapChain->QueryInterface(__uuidof(IDXGISwapChain3), (void**)&m_pSwapChain);
+        }
+        if (swapChain) {
+            swapChain->Release();
+        }
+        if (FAILED(hr))
+            return false;
+
+        // float content is scRGB, linear with sRGB primaries, no conversion pass before the compositor
+        if (m_swapChainFormat == DXGI_FORMAT_R16G16B16A16_FLOAT) {
+            UINT colorSpaceSupport = 0;
+            const DXGI_COLOR_SPACE_TYPE colorSpace = DXGI_COLOR_SPACE_RGB_FULL_G10_NONE_P709;
+            if (SUCCEEDED(m_pSwapChain->CheckColorSpaceSupport(colorSpace, &colorSpaceSupport)) &&
+                (colorSpaceSupport & DXGI_SWAP_CHAIN_COLOR_SPACE_SUPPORT_FLAG_PRESENT)) {
+                m_pSwapChain->SetColorSpace1(colorSpace);
+            }
+        }
+
+        m_pFactory->MakeWindowAssociation(m_pSharedData->config.hWnd, DXGI_MWA_NO_ALT_ENTER);
+    }
 
     m_pFactory->Release();
     m_pFactory = nullptr;
@@ -117,20 +204,164 @@ bool DX12Present::Init(DX12SharedData* pSharedData)
     if (FAILED(hr))
         return false;
 
-    for (UINT index = 0; index < m_pSharedData->numSharedBuffers; index++) {
-        D3D12_HEAP_PROPERTIES defaultHeapProps = { D3D12_HEAP_TYPE_DEFAULT, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 1, 1 };
+    m_numSharedBuffers = m_pSharedData->numSharedBuffers;
+    m_pRenderTargets.assign(m_numSharedBuffers, nullptr);
+    m_pCommandList.assign(m_numSharedBuffers * m_numSharedBuffers, nullptr);
+    m_pSharedMem.assign(m_numSharedBuffers, nullptr);
+    m_pSharedFence.assign(m_numSharedBuffers, nullptr);
+    m_sharedMemHandle.assign(m_numSharedBuffers, nullptr);
+    m_sharedFenceHandle.assign(m_numSharedBuffers, nullptr);
+    m_pPlanarMem.assign(m_numSharedBuffers, nullptr);
+    m_planarMemHandle.assign(m_numSharedBuffers, nullptr);
+
+    if (!CreateSharedHeap())
+        return false;
+
+    for (UINT index = 0; index < m_numSharedBuffers; index++) {
+        hr = m_pDevice->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&m_pSharedFence[index]));
+        if (FAILED(hr))
+            return false;
+
+        hr = m_pDevice->CreateSharedHandle(m_pSharedFence[index], nullptr, GENERIC_ALL, nullptr, &m_sharedFenceHandle[index]);
+        if (FAILED(hr))
+            return false;
+
+        m_pSharedData->Buffer(index).sharedFenceHandle = m_sharedFenceHandle[index];
+        m_pSharedData->Buffer(index).sharedFenceValue = 0;
+
+        if (!CreateSharedBuffer(index))
+            return false;
+    }
+
+    // GPU timings are optional, recorded in the copy command lists
+    InitTimestamps();
+
+    for (UINT index = 0; index < m_numSharedBuffers; index++) {
+        if (!RecordCopyCommandList(index, index))
+            return false;
+    }
+
+    if (FrameCapture::isNeeded(m_pSharedData->config) && !InitCapture())
+        return false;
+
+    m_frameIndex = m_pSwapChain ? m_pSwapChain->GetCurrentBackBufferIndex() : 0;
+    m_pSharedData->currentBufferIndex = m_frameIndex;
+    m_initialized = true;
+    m_numFrames = 0;
+    return true;
+}
+
+// the requested config.format if the device renders to, shares and displays it, RGBA8 otherwise
+bool DX12Present::NegotiateFormat()
+{
+    UINT format = m_pSharedData->config.format;
+    if (format >= NUM_SHARED_FORMATS)
+        return false;
+
+    D3D12_FEATURE_DATA_FORMAT_SUPPORT sharedSupport = { SharedTextureFormat(format) };
+    D3D12_FEATURE_DATA_FORMAT_SUPPORT swapChainSupport = { SwapChainFormat(format) };
+    const D3D12_FORMAT_SUPPORT1 sharedRequired = D3D12_FORMAT_SUPPORT1_TEXTURE2D | D3D12_FORMAT_SUPPORT1_RENDER_TARGET;
+    const D3D12_FORMAT_SUPPORT1 swapChainRequired = D3D12_FORMAT_SUPPORT1_DISPLAY;
+    const bool supported =
+        SUCCEEDED(m_pDevice->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &sharedSupport, sizeof(sharedSupport))) &&
+        ((sharedSupport.Support1 & sharedRequired) == sharedRequired) &&
+        SUCCEEDED(m_pDevice->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &swapChainSupport, sizeof(swapChainSupport))) &&
+        ((swapChainSupport.Support1 & swapChainRequired) == swapChainRequired);
+    if (!supported && format != SHARED_FORMAT_RGBA8) {
+        fprintf(stderr, "DX12: %s shared buffers not supported, falling back to %s.\n", SharedFormatName(format), SharedFormatName(SHARED_FORMAT_RGBA8));
+        format = SHARED_FORMAT_RGBA8;
+        m_pSharedData->BeginConfigWrite();
+        m_pSharedData->config.format = format;
+        m_pSharedData->EndConfigWrite();
+    }
+
+    m_sharedFormat = SharedTextureFormat(format);
+    m_swapChainFormat = SwapChainFormat(format);
+    return true;
+}
+
+D3D12_RESOURCE_DESC DX12Present::SharedTextureDesc() const
+{
+    D3D12_RESOURCE_DESC textureDesc = {};
+    textureDesc.MipLevels = 1;
+    textureDesc.Format = m_sharedFormat;
+    textureDesc.Width = m_pSharedData->config.width;
+    textureDesc.Height = m_pSharedData->config.height;
+    textureDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+    textureDesc.DepthOrArraySize = 1;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.SampleDesc.Quality = 0;
+    textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    return textureDesc;
+}
+
+// config.singleHeap: one shared heap and one handle for every shared texture instead of a committed resource each,
+// fewer kernel allocations and the whole ring made resident at once
+bool DX12Present::CreateSharedHeap()
+{
+    m_pSharedData->sharedHeapSize = 0;
+    if (!m_pSharedData->config.singleHeap)
+        return true;
+
+    const D3D12_RESOURCE_DESC textureDesc = SharedTextureDesc();
+    const D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = m_pDevice->GetResourceAllocationInfo(0, 1, &textureDesc);
+    if (allocationInfo.SizeInBytes == UINT64_MAX)
+        return false;
+    m_sharedHeapStride = (allocationInfo.SizeInBytes + allocationInfo.Alignment - 1) & ~(allocationInfo.Alignment - 1);
 
-        D3D12_RESOURCE_DESC textureDesc = {};
-        textureDesc.MipLevels = 1;
-        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        textureDesc.Width = m_pSharedData->width;
-        textureDesc.Height = m_pSharedData->height;
-        textureDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
-        textureDesc.DepthOrArraySize = 1;
-        textureDesc.SampleDesc.Count = 1;
-        textureDesc.SampleDesc.Quality = 0;
-        textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    D3D12_HEAP_DESC heapDesc = {};
+    heapDesc.SizeInBytes = m_sharedHeapStride * m_numSharedBuffers;
+    heapDesc.Properties = { D3D12_HEAP_TYPE_DEFAULT, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 1, 1 };
+    heapDesc.Alignment = allocationInfo.Alignment;
+    heapDesc.Flags = D3D12_HEAP_FLAG_SHARED | D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
 
+    HRESULT hr = m_pDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_pSharedHeap));
+    if (FAILED(hr))
+        return false;
+
+    hr = m_pDevice->CreateSharedHandle(m_pSharedHeap, nullptr, GENERIC_ALL, nullptr, &m_sharedHeapHandle);
+    if (FAILED(hr))
+        return false;
+
+    m_pSharedData->sharedHeapSize = heapDesc.SizeInBytes;
+    return true;
+}
+
+// once every texture placed in it is released
+void DX12Present::ReleaseSharedHeap()
+{
+    if (m_sharedHeapHandle) {
+        CloseHandle(m_sharedHeapHandle);
+        m_sharedHeapHandle = 0;
+    }
+    if (m_pSharedHeap) {
+        m_pSharedHeap->Release();
+        m_pSharedHeap = nullptr;
+    }
+}
+
+// shared texture at the config size and the back buffer it is copied to
+bool DX12Present::CreateSharedBuffer(UINT index)
+{
+    D3D12_HEAP_PROPERTIES defaultHeapProps = { D3D12_HEAP_TYPE_DEFAULT, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 1, 1 };
+    D3D12_RESOURCE_DESC textureDesc = SharedTextureDesc();
+
+    HRESULT hr;
+    if (m_pSharedHeap) {
+        const UINT64 offset = m_sharedHeapStride * index;
+        hr = m_pDevice->CreatePlacedResource(
+            m_pSharedHeap,
+            offset,
+            &textureDesc,
+            D3D12_RESOURCE_STATE_RENDER_TARGET,
+            NULL,
+            IID_PPV_ARGS(&m_pSharedMem[index]));
+        if (FAILED(hr))
+            return false;
+
+        m_pSharedData->Buffer(index).sharedMemHandle = m_sharedHeapHandle;
+        m_pSharedData->Buffer(index).sharedMemOffset = offset;
+    } else {
         hr = m_pDevice->CreateCommittedResource(
             &defaultHeapProps,
             D3D12_HEAP_FLAG_SHARED,
@@ -145,90 +376,460 @@ bool DX12Present::Init(DX12SharedData* pSharedData)
         if (FAILED(hr))
             return false;
 
-        m_pSharedData->sharedMemHandle[index] = m_sharedMemHandle[index];
+        m_pSharedData->Buffer(index).sharedMemHandle = m_sharedMemHandle[index];
+        m_pSharedData->Buffer(index).sharedMemOffset = 0;
+    }
 
-        hr = m_pDevice->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&m_pSharedFence[index]));
+    // linear NV12 or P010 target of the producer compute pass, read back with the texture by the recording
+    const DX12SharedConfig& config = m_pSharedData->config;
+    m_pSharedData->planarSize = config.recordYuvOnGpu ? colorconvert::getSize(config.width, config.height, config.recordYuvFormat) : 0;
+    m_pSharedData->Buffer(index).planarMemHandle = SMODE_INVALID_NATIVE_HANDLE;
+    if (m_pSharedData->planarSize) {
+        D3D12_RESOURCE_DESC bufferDesc = {};
+        bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        bufferDesc.Width = m_pSharedData->planarSize;
+        bufferDesc.Height = 1;
+        bufferDesc.DepthOrArraySize = 1;
+        bufferDesc.MipLevels = 1;
+        bufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+        bufferDesc.SampleDesc.Count = 1;
+        bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        bufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+        hr = m_pDevice->CreateCommittedResource(
+            &defaultHeapProps,
+            D3D12_HEAP_FLAG_SHARED,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_COMMON,
+            NULL,
+            IID_PPV_ARGS(&m_pPlanarMem[index]));
         if (FAILED(hr))
             return false;
 
-        hr = m_pDevice->CreateSharedHandle(m_pSharedFence[index], nullptr, GENERIC_ALL, nullptr, &m_sharedFenceHandle[index]);
+        hr = m_pDevice->CreateSharedHandle(m_pPlanarMem[index], nullptr, GENERIC_ALL, nullptr, &m_planarMemHandle[index]);
         if (FAILED(hr))
             return false;
 
-        m_pSharedData->sharedFenceHandle[index] = m_sharedFenceHandle[index];
+        m_pSharedData->Buffer(index).planarMemHandle = m_planarMemHandle[index];
+    }
 
+    if (m_pSwapChain) {
         hr = m_pSwapChain->GetBuffer(index, IID_PPV_ARGS(&m_pRenderTargets[index]));
+    } else {
+        // same state as a back buffer between two presents
+        textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+        textureDesc.Format = m_swapChainFormat;
+        hr = m_pDevice->CreateCommittedResource(
+            &defaultHeapProps,
+            D3D12_HEAP_FLAG_NONE,
+            &textureDesc,
+            D3D12_RESOURCE_STATE_PRESENT,
+            NULL,
+            IID_PPV_ARGS(&m_pRenderTargets[index]));
+    }
+    if (FAILED(hr))
+        return false;
+
+    return true;
+}
+
+void DX12Present::ReleaseSharedBuffer(UINT index)
+{
+    if (m_sharedMemHandle[index]) {
+        CloseHandle(m_sharedMemHandle[index]);
+        m_sharedMemHandle[index] = 0;
+    }
+    if (m_pSharedMem[index]) {
+        m_pSharedMem[index]->Release();
+        m_pSharedMem[index] = nullptr;
+    }
+    if (m_planarMemHandle[index]) {
+        CloseHandle(m_planarMemHandle[index]);
+        m_planarMemHandle[index] = 0;
+    }
+    if (m_pPlanarMem[index]) {
+        m_pPlanarMem[index]->Release();
+        m_pPlanarMem[index] = nullptr;
+    }
+    if (m_pRenderTargets[index]) {
+        m_pRenderTargets[index]->Release();
+        m_pRenderTargets[index] = nullptr;
+    }
+}
+
+void DX12Present::ReleaseCommandLists()
+{
+    for (ID3D12GraphicsCommandList*& pCommandList : m_pCommandList) {
+        if (pCommandList) {
+            pCommandList->Release();
+            pCommandList = nullptr;
+        }
+    }
+}
+
+// every frame is presented: the shared textures and the back buffers are reallocated at the config size,
+// the device, the queue and the shared fences stay
+bool DX12Present::Resize()
+{
+    if (!m_initialized)
+        return false;
+
+    // the last producer frame and copy of each buffer, nothing references the old textures once they are signaled
+    for (UINT index = 0; index < m_numSharedBuffers; index++) {
+        HRESULT hr = m_pSharedFence[index]->SetEventOnCompletion(m_pSharedData->Buffer(index).sharedFenceValue, NULL);
         if (FAILED(hr))
             return false;
+    }
+    ReadTimestamps();
+
+    ReleaseCommandLists();
+    for (UINT index = 0; index < m_numSharedBuffers; index++) {
+        ReleaseSharedBuffer(index);
+    }
+    ReleaseSharedHeap();
+    m_pCommandAllocator->Reset();
 
-        hr = m_pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_pCommandAllocator, nullptr, IID_PPV_ARGS(&m_pCommandList[index]));
+    if (m_pSwapChain) {
+        HRESULT hr = m_pSwapChain->ResizeBuffers(0, m_pSharedData->config.width, m_pSharedData->config.height, DXGI_FORMAT_UNKNOWN, 0);
         if (FAILED(hr))
             return false;
+    }
 
-		D3D12_RESOURCE_BARRIER preCopySrcBarrier = {};
-        preCopySrcBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        preCopySrcBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-        preCopySrcBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        preCopySrcBarrier.Transition.pResource = m_pSharedMem[index];
-        preCopySrcBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-        preCopySrcBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
-        m_pCommandList[index]->ResourceBarrier(1, &preCopySrcBarrier);
-
-        D3D12_RESOURCE_BARRIER preCopyDstBarrier = {};
-        preCopyDstBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        preCopyDstBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-        preCopyDstBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        preCopyDstBarrier.Transition.pResource = m_pRenderTargets[index];
-        preCopyDstBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
-        preCopyDstBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
-        m_pCommandList[index]->ResourceBarrier(1, &preCopyDstBarrier);
-
-        D3D12_TEXTURE_COPY_LOCATION Dst = { m_pRenderTargets[index], D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX };
-        D3D12_TEXTURE_COPY_LOCATION Src = { m_pSharedMem[index],    D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX };
-
-        m_pCommandList[index]->CopyTextureRegion(&Dst, 0, 0, 0, &Src, nullptr);
-
-        D3D12_RESOURCE_BARRIER postCopySrcBarrier = {};
-        postCopySrcBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        postCopySrcBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-        postCopySrcBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        postCopySrcBarrier.Transition.pResource = m_pSharedMem[index];
-        postCopySrcBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
-        postCopySrcBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
-        m_pCommandList[index]->ResourceBarrier(1, &postCopySrcBarrier);
-
-        D3D12_RESOURCE_BARRIER postCopyDstBarrier = {};
-        postCopyDstBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        postCopyDstBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-        postCopyDstBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        postCopyDstBarrier.Transition.pResource = m_pRenderTargets[index];
-        postCopyDstBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-        postCopyDstBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
-        m_pCommandList[index]->ResourceBarrier(1, &postCopyDstBarrier);
-
-        hr = m_pCommandList[index]->Close();
-        if (FAILED(hr))
+    if (!CreateSharedHeap())
+        return false;
+    for (UINT index = 0; index < m_numSharedBuffers; index++) {
+        if (!CreateSharedBuffer(index))
+            return false;
+    }
+    for (UINT index = 0; index < m_numSharedBuffers; index++) {
+        if (!RecordCopyCommandList(index, index))
             return false;
     }
 
-    m_frameIndex = m_pSwapChain->GetCurrentBackBufferIndex();
+    m_frameIndex = m_pSwapChain ? m_pSwapChain->GetCurrentBackBufferIndex() : 0;
     m_pSharedData->currentBufferIndex = m_frameIndex;
-    m_initialized = true;
-    m_numFrames = 0;
     return true;
 }
 
-void DX12Present::Cleanup()
+// copy of a shared buffer into a back buffer, other pairs than [i][i] are only recorded when a mode presents out of order
+bool DX12Present::RecordCopyCommandList(UINT sharedIndex, UINT backBufferIndex)
 {
-    for (UINT i = 0; i < m_pSharedData->numSharedBuffers; i++) {
-        if (m_sharedMemHandle[i]) {
-            CloseHandle(m_sharedMemHandle[i]);
-            m_sharedMemHandle[i] = 0;
+    const UINT commandListIndex = sharedIndex * m_numSharedBuffers + backBufferIndex;
+    ID3D12GraphicsCommandList*& pCommandList = m_pCommandList[commandListIndex];
+
+    HRESULT hr = m_pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_pCommandAllocator, nullptr, IID_PPV_ARGS(&pCommandList));
+    if (FAILED(hr))
+        return false;
+
+    if (m_pTimestampHeap) {
+        pCommandList->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 2 * commandListIndex);
+    }
+
+    D3D12_RESOURCE_BARRIER preCopySrcBarrier = {};
+    preCopySrcBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    preCopySrcBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    preCopySrcBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    preCopySrcBarrier.Transition.pResource = m_pSharedMem[sharedIndex];
+    preCopySrcBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
+    preCopySrcBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+    pCommandList->ResourceBarrier(1, &preCopySrcBarrier);
+
+    D3D12_RESOURCE_BARRIER preCopyDstBarrier = {};
+    preCopyDstBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    preCopyDstBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    preCopyDstBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    preCopyDstBarrier.Transition.pResource = m_pRenderTargets[backBufferIndex];
+    preCopyDstBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
+    preCopyDstBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+    pCommandList->ResourceBarrier(1, &preCopyDstBarrier);
+
+    D3D12_TEXTURE_COPY_LOCATION Dst = { m_pRenderTargets[backBufferIndex], D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX };
+    D3D12_TEXTURE_COPY_LOCATION Src = { m_pSharedMem[sharedIndex],         D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX };
+
+    pCommandList->CopyTextureRegion(&Dst, 0, 0, 0, &Src, nullptr);
+
+    D3D12_RESOURCE_BARRIER postCopySrcBarrier = {};
+    postCopySrcBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    postCopySrcBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    postCopySrcBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    postCopySrcBarrier.Transition.pResource = m_pSharedMem[sharedIndex];
+    postCopySrcBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+    postCopySrcBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
+    pCommandList->ResourceBarrier(1, &postCopySrcBarrier);
+
+    D3D12_RESOURCE_BARRIER postCopyDstBarrier = {};
+    postCopyDstBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    postCopyDstBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    postCopyDstBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    postCopyDstBarrier.Transition.pResource = m_pRenderTargets[backBufferIndex];
+    postCopyDstBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    postCopyDstBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+    pCommandList->ResourceBarrier(1, &postCopyDstBarrier);
+
+    if (m_pTimestampHeap) {
+        pCommandList->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 2 * commandListIndex + 1);
+        pCommandList->ResolveQueryData(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 2 * commandListIndex, 2,
+                                       m_pTimestampReadback, 2 * commandListIndex * sizeof(UINT64));
+    }
+
+    hr = pCommandList->Close();
+    if (FAILED(hr))
+        return false;
+
+    return true;
+}
+
+// a query heap and a readback buffer holding two timestamps per copy command list
+bool DX12Present::InitTimestamps()
+{
+    m_gpuClock.pCommandQueue = m_pCommandQueue;
+    const UINT numQueries = 2 * m_numSharedBuffers * m_numSharedBuffers;
+
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = numQueries;
+    HRESULT hr = m_pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_pTimestampHeap));
+    if (FAILED(hr)) {
+        m_pTimestampHeap = nullptr;
+        return false;
+    }
+
+    D3D12_HEAP_PROPERTIES readbackHeapProps = { D3D12_HEAP_TYPE_READBACK, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 1, 1 };
+
+    D3D12_RESOURCE_DESC bufferDesc = {};
+    bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Width = numQueries * sizeof(UINT64);
+    bufferDesc.Height = 1;
+    bufferDesc.DepthOrArraySize = 1;
+    bufferDesc.MipLevels = 1;
+    bufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+    bufferDesc.SampleDesc.Count = 1;
+    bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    hr = m_pDevice->CreateCommittedResource(
+        &readbackHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        NULL,
+        IID_PPV_ARGS(&m_pTimestampReadback));
+    if (SUCCEEDED(hr)) {
+        // readback resources may stay mapped while the GPU writes them
+        hr = m_pTimestampReadback->Map(0, nullptr, (void**)&m_pTimestamps);
+    }
+    if (SUCCEEDED(hr) && m_gpuTimeline.init(&m_gpuClock, &m_pSharedData->presentQueue, "d3d12 queue")) {
+        m_timestampSubmissions.assign(m_numSharedBuffers * m_numSharedBuffers, TimestampSubmission());
+        return true;
+    }
+
+    if (m_pTimestampReadback) {
+        m_pTimestampReadback->Release();
+        m_pTimestampReadback = nullptr;
+    }
+    m_pTimestamps = nullptr;
+    m_pTimestampHeap->Release();
+    m_pTimestampHeap = nullptr;
+    return false;
+}
+
+// copies whose fence value is reached have their timestamps resolved, and their frame latency completed
+void DX12Present::ReadTimestamps()
+{
+    if (m_timestampSubmissions.empty()) {
+        return;
+    }
+
+    // flip time of the last present only, when the swap chain reports it (flip model, not minimized)
+    DXGI_FRAME_STATISTICS frameStatistics = {};
+    const bool flipKnown = m_pSwapChain && SUCCEEDED(m_pSwapChain->GetFrameStatistics(&frameStatistics));
+
+    for (UINT i = 0; i < (UINT)m_timestampSubmissions.size(); i++) {
+        TimestampSubmission& submission = m_timestampSubmissions[i];
+        if (!submission.fenceValue || m_pSharedFence[submission.bufferIndex]->GetCompletedValue() < submission.fenceValue)
+            continue;
+
+        FrameLatencySample& latency = submission.latency;
+        m_gpuTimeline.report(submission.frameId, latency.acquireTicks, m_pTimestamps[2 * i], m_pTimestamps[2 * i + 1]);
+        latency.renderedTicks = m_gpuTimeline.toCpuTicks(m_pTimestamps[2 * i]);
+        latency.copiedTicks = m_gpuTimeline.toCpuTicks(m_pTimestamps[2 * i + 1]);
+        if (flipKnown && (frameStatistics.PresentCount == submission.presentCount)) {
+            latency.presentedTicks = frameStatistics.SyncQPCTime.QuadPart;
+        } else if (latency.presentedTicks < latency.copiedTicks) {
+            latency.presentedTicks = latency.copiedTicks; // Present returned before the copy ran
+        }
+        m_pSharedData->latency.record(latency);
+        submission.fenceValue = 0;
+    }
+}
+
+// one command list and readback buffer per capture slot, the buffers are allocated by the first capture
+bool DX12Present::InitCapture()
+{
+    HRESULT hr = m_pDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_pCaptureFence));
+    if (FAILED(hr))
+        return false;
+    m_captureFenceValue = 0;
+
+    for (UINT slot = 0; slot < FRAME_CAPTURE_RING_SIZE; slot++) {
+        CaptureSlot& captureSlot = m_captureSlots[slot];
+        hr = m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&captureSlot.pCommandAllocator));
+        if (FAILED(hr))
+            return false;
+        hr = m_pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, captureSlot.pCommandAllocator, nullptr, IID_PPV_ARGS(&captureSlot.pCommandList));
+        if (FAILED(hr))
+            return false;
+        hr = captureSlot.pCommandList->Close(); // reset by each capture
+        if (FAILED(hr))
+            return false;
+    }
+
+    return m_capture.start(m_pSharedData, this);
+}
+
+// the writer thread first, it waits for the copies in flight
+void DX12Present::ReleaseCapture()
+{
+    m_capture.stop();
+    for (CaptureSlot& captureSlot : m_captureSlots) {
+        if (captureSlot.pReadback) {
+            captureSlot.pReadback->Unmap(0, nullptr);
+            captureSlot.pReadback->Release();
         }
-        if (m_pSharedMem[i]) {
-            m_pSharedMem[i]->Release();
-            m_pSharedMem[i] = nullptr;
+        if (captureSlot.pCommandList) {
+            captureSlot.pCommandList->Release();
         }
+        if (captureSlot.pCommandAllocator) {
+            captureSlot.pCommandAllocator->Release();
+        }
+        captureSlot = CaptureSlot();
+    }
+    if (m_pCaptureFence) {
+        m_pCaptureFence->Release();
+        m_pCaptureFence = nullptr;
+    }
+}
+
+// copy of a shared buffer into the readback buffer of a free slot, the writer thread is done with its previous frame
+bool DX12Present::RecordCapture(UINT slot, UINT bufferIndex)
+{
+    CaptureSlot& captureSlot = m_captureSlots[slot];
+    const D3D12_RESOURCE_DESC textureDesc = m_pSharedMem[bufferIndex]->GetDesc();
+    const D3D12_SUBRESOURCE_FOOTPRINT& footprint = captureSlot.footprint.Footprint;
+    HRESULT hr;
+
+    const UINT64 planarSize = m_pSharedData->planarSize;
+    if (!captureSlot.pReadback || (footprint.Width != (UINT)textureDesc.Width) ||
+        (footprint.Height != textureDesc.Height) || (footprint.Format != textureDesc.Format) ||
+        ((captureSlot.planarOffset != 0) != (planarSize != 0))) {
+        if (captureSlot.pReadback) {
+            captureSlot.pReadback->Unmap(0, nullptr);
+            captureSlot.pReadback->Release();
+            captureSlot.pReadback = nullptr;
+            captureSlot.pPixels = nullptr;
+        }
+
+        UINT64 totalBytes = 0;
+        m_pDevice->GetCopyableFootprints(&textureDesc, 0, 1, 0, &captureSlot.footprint, nullptr, nullptr, &totalBytes);
+        captureSlot.planarOffset = 0;
+        if (planarSize) {
+            captureSlot.planarOffset = (totalBytes + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~(UINT64)(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+            totalBytes = captureSlot.planarOffset + planarSize;
+        }
+
+        D3D12_HEAP_PROPERTIES readbackHeapProps = { D3D12_HEAP_TYPE_READBACK, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 1, 1 };
+
+        D3D12_RESOURCE_DESC bufferDesc = {};
+        bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        bufferDesc.Width = totalBytes;
+        bufferDesc.Height = 1;
+        bufferDesc.DepthOrArraySize = 1;
+        bufferDesc.MipLevels = 1;
+        bufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+        bufferDesc.SampleDesc.Count = 1;
+        bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+        hr = m_pDevice->CreateCommittedResource(
+            &readbackHeapProps,
+            D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            NULL,
+            IID_PPV_ARGS(&captureSlot.pReadback));
+        if (FAILED(hr))
+            return false;
+        hr = captureSlot.pReadback->Map(0, nullptr, (void**)&captureSlot.pPixels);
+        if (FAILED(hr))
+            return false;
+    }
+
+    hr = captureSlot.pCommandAllocator->Reset();
+    if (FAILED(hr))
+        return false;
+    ID3D12GraphicsCommandList* pCommandList = captureSlot.pCommandList;
+    hr = pCommandList->Reset(captureSlot.pCommandAllocator, nullptr);
+    if (FAILED(hr))
+        return false;
+
+    D3D12_RESOURCE_BARRIER preCopyBarrier = {};
+    preCopyBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    preCopyBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    preCopyBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    preCopyBarrier.Transition.pResource = m_pSharedMem[bufferIndex];
+    preCopyBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
+    preCopyBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+    pCommandList->ResourceBarrier(1, &preCopyBarrier);
+
+    D3D12_TEXTURE_COPY_LOCATION Dst = { captureSlot.pReadback,       D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT };
+    D3D12_TEXTURE_COPY_LOCATION Src = { m_pSharedMem[bufferIndex], D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX };
+    Dst.PlacedFootprint = captureSlot.footprint;
+
+    pCommandList->CopyTextureRegion(&Dst, 0, 0, 0, &Src, nullptr);
+    if (captureSlot.planarOffset) {
+        // promoted from the common state and decayed back at the end of the command list
+        pCommandList->CopyBufferRegion(captureSlot.pReadback, captureSlot.planarOffset, m_pPlanarMem[bufferIndex], 0, planarSize);
+    }
+
+    D3D12_RESOURCE_BARRIER postCopyBarrier = preCopyBarrier;
+    postCopyBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+    postCopyBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
+    pCommandList->ResourceBarrier(1, &postCopyBarrier);
+
+    hr = pCommandList->Close();
+    if (FAILED(hr))
+        return false;
+
+    return true;
+}
+
+bool DX12Present::waitCopy(uint32_t slot, uint64_t copyToken)
+{
+    // a null event blocks until the fence reaches the value
+    return SUCCEEDED(m_pCaptureFence->SetEventOnCompletion(copyToken, NULL));
+}
+
+const uint8_t* DX12Present::getPixels(uint32_t slot)
+{
+    return m_captureSlots[slot].pPixels;
+}
+
+void DX12Present::Cleanup()
+{
+    ReleaseCapture();
+    m_gpuTimeline.clear();
+    m_timestampSubmissions.clear();
+    if (m_pTimestampReadback) {
+        m_pTimestampReadback->Unmap(0, nullptr);
+        m_pTimestampReadback->Release();
+        m_pTimestampReadback = nullptr;
+        m_pTimestamps = nullptr;
+    }
+    if (m_pTimestampHeap) {
+        m_pTimestampHeap->Release();
+        m_pTimestampHeap = nullptr;
+    }
+
+    for (UINT i = 0; i < m_numSharedBuffers; i++) {
+        ReleaseSharedBuffer(i);
         if (m_sharedFenceHandle[i]) {
             CloseHandle(m_sharedFenceHandle[i]);
             m_sharedFenceHandle[i] = 0;
@@ -237,15 +838,18 @@ void DX12Present::Cleanup()
             m_pSharedFence[i]->Release();
             m_pSharedFence[i] = nullptr;
         }
-        if (m_pRenderTargets[i]) {
-            m_pRenderTargets[i]->Release();
-            m_pRenderTargets[i] = nullptr;
-        }
-        if (m_pCommandList[i]) {
-            m_pCommandList[i]->Release();
-            m_pCommandList[i] = nullptr;
-        }
     }
+    ReleaseSharedHeap();
+    ReleaseCommandLists();
+    m_pRenderTargets.clear();
+    m_pCommandList.clear();
+    m_pSharedMem.clear();
+    m_pSharedFence.clear();
+    m_sharedMemHandle.clear();
+    m_sharedFenceHandle.clear();
+    m_pPlanarMem.clear();
+    m_planarMemHandle.clear();
+    m_numSharedBuffers = 0;
 
     if (m_pCommandQueue) {
         m_pCommandQueue->Release();
@@ -273,7 +877,7 @@ void DX12Present::Cleanup()
     }
 
     if (m_hDC) {
-        ReleaseDC(m_pSharedData->hWnd, m_hDC);
+        ReleaseDC(m_pSharedData->config.hWnd, m_hDC);
         m_hDC = 0;
     }
 
@@ -281,27 +885,89 @@ void DX12Present::Cleanup()
 }
 
 bool DX12Present::Render()
+{
+    if (!Render(m_frameIndex))
+        return false;
+
+    m_pSharedData->currentBufferIndex = m_frameIndex;
+    return true;
+}
+
+// bufferIndex is chosen by the producer, it follows the swap chain back buffer rotation except in mailbox mode
+bool DX12Present::Render(UINT bufferIndex)
 {
     bool success = true;
     HRESULT hr;
 
-	hr = m_pCommandQueue->Wait(m_pSharedFence[m_frameIndex], ++m_sharedFenceValue[m_frameIndex]);
-    if (FAILED(hr))
-        return false;
+    const UINT commandListIndex = bufferIndex * m_numSharedBuffers + m_frameIndex;
+    if (!m_pCommandList[commandListIndex]) {
+        if (!RecordCopyCommandList(bufferIndex, m_frameIndex))
+            return false;
+    }
 
-    ID3D12CommandList* ppCommandLists[] = { m_pCommandList[m_frameIndex] };
-    m_pCommandQueue->ExecuteCommandLists(ARRAYSIZE(ppCommandLists), ppCommandLists);
+    UINT64& sharedFenceValue = m_pSharedData->Buffer(bufferIndex).sharedFenceValue;
 
-    hr = m_pSwapChain->Present(m_pSharedData->vsync ? 1 : 0, 0);
-    if (FAILED(hr))
-        return false;
+    // a few frames later, before a command list overwrites its own timestamps
+    ReadTimestamps();
+    FrameLatencySample latency = { m_pSharedData->Buffer(bufferIndex).SubmitTicks(sharedFenceValue), smode::getTicks(), 0, 0, 0 };
+    const UINT64 frameId = m_pSharedData->Buffer(bufferIndex).frameId.load(std::memory_order_relaxed);
+
+    // CPU side of the submission, the queue runs it asynchronously
+    {
+        TRACE_SCOPE_VALUE("Submit", "fence", sharedFenceValue);
+        hr = m_pCommandQueue->Wait(m_pSharedFence[bufferIndex], sharedFenceValue);
+        if (FAILED(hr))
+            return false;
 
-    m_pCommandQueue->Signal(m_pSharedFence[m_frameIndex], ++m_sharedFenceValue[m_frameIndex]);
+        ID3D12CommandList* ppCommandLists[] = { m_pCommandList[commandListIndex] };
+        m_pCommandQueue->ExecuteCommandLists(ARRAYSIZE(ppCommandLists), ppCommandLists);
+    }
 
-    m_frameIndex = m_pSwapChain->GetCurrentBackBufferIndex();
+    if (m_pSwapChain) {
+        // blocks when the swap chain runs out of back buffers
+        TRACE_SCOPE("SwapChainPresent");
+        hr = m_pSwapChain->Present(m_pSharedData->config.vsync ? 1 : 0, 0);
+        if (FAILED(hr))
+            return false;
+    }
+    latency.presentedTicks = smode::getTicks();
 
-    m_pSharedData->currentBufferIndex = m_frameIndex;
+    // behind the present on the queue, the producer gets the buffer back once the readback is done
+    const int captureSlot = m_capture.acquire(m_numFrames);
+    if (captureSlot >= 0) {
+        TRACE_SCOPE("CaptureSubmit");
+        if (!RecordCapture(captureSlot, bufferIndex))
+            return false;
+
+        ID3D12CommandList* ppCommandLists[] = { m_captureSlots[captureSlot].pCommandList };
+        m_pCommandQueue->ExecuteCommandLists(ARRAYSIZE(ppCommandLists), ppCommandLists);
+        m_pCommandQueue->Signal(m_pCaptureFence, ++m_captureFenceValue);
+
+        const D3D12_SUBRESOURCE_FOOTPRINT& footprint = m_captureSlots[captureSlot].footprint.Footprint;
+        m_capture.submit(captureSlot, m_numFrames, frameId, m_captureFenceValue, footprint.Width, footprint.Height, footprint.RowPitch, m_pSharedData->config.format,
+                         (uint32_t)m_captureSlots[captureSlot].planarOffset);
+    }
+
+    m_pCommandQueue->Signal(m_pSharedFence[bufferIndex], ++sharedFenceValue);
+
+    if (m_pTimestampHeap) {
+        // a submission still pending on this command list loses its timestamps
+        UINT presentCount = 0;
+        if (m_pSwapChain) {
+            m_pSwapChain->GetLastPresentCount(&presentCount);
+        }
+        m_timestampSubmissions[commandListIndex] = { bufferIndex, sharedFenceValue, frameId, presentCount, latency };
+    } else {
+        // no copy breakdown, present is the CPU return
+        m_pSharedData->latency.record(latency);
+    }
+
+    // offscreen targets rotate in order, unpaced: vsync needs a display
+    m_frameIndex = m_pSwapChain ? m_pSwapChain->GetCurrentBackBufferIndex() : (m_frameIndex + 1) % m_numSharedBuffers;
     m_numFrames++;
      
     return success;
 }
+
+AbstractPresent* newDX12Present()
+  {return new DX12Present();}
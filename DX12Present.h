@@ -11,47 +11,109 @@
 
 #include <d3d12.h>
 #include <dxgi1_4.h>
+#include <vector>
+#include "DX12SharedData.h" // for AbstractPresent
+#include "FrameCapture.h"
+#include "GpuTimeline.h"
 
-class DX12Present
+// queue timestamps against QueryPerformanceCounter, the smode::getTicks() clock
+class DX12GpuClock : public GpuClock
+{
+public:
+    ID3D12CommandQueue* pCommandQueue = nullptr;
+
+    uint64_t getTimestampFrequency() override;
+    bool getCalibration(uint64_t& gpuTimestamp, int64_t& cpuTicks) override;
+};
+
+class DX12Present : public AbstractPresent, private FrameCapture::Readback
 {
 public:
     DX12Present();
     ~DX12Present();
-    bool Init(struct DX12SharedData* pSharedData);
-    void Cleanup();
-    bool Render();
+    bool Init(DX12SharedData* pSharedData) override;
+    void Cleanup() override;
+    bool Render() override;
+    bool Render(UINT bufferIndex) override;
+    bool Resize() override;
     //bool VerifyResult();
-    //bool CaptureFrame();
     //void WaitForCompletion();
-    //bool WriteBMP(LPCSTR lpszFilename, LPCBYTE pPixels, UINT width, UINT rowPitch, UINT height);
 
 private:
+    bool NegotiateFormat();
+    D3D12_RESOURCE_DESC SharedTextureDesc() const;
+    bool CreateSharedHeap();
+    void ReleaseSharedHeap();
+    bool CreateSharedBuffer(UINT index);
+    void ReleaseSharedBuffer(UINT index);
+    void ReleaseCommandLists();
+    bool RecordCopyCommandList(UINT sharedIndex, UINT backBufferIndex);
+    bool InitTimestamps();
+    void ReadTimestamps();
+    bool InitCapture();
+    void ReleaseCapture();
+    bool RecordCapture(UINT slot, UINT bufferIndex);
+
+    // FrameCapture::Readback, on the writer thread
+    bool waitCopy(uint32_t slot, uint64_t copyToken) override;
+    const uint8_t* getPixels(uint32_t slot) override;
+
     HDC                                 m_hDC;
     IDXGIFactory2*                      m_pFactory;
     IDXGIAdapter1*                      m_pAdapter; 
     ID3D12Device*                       m_pDevice;
     IDXGISwapChain3*                    m_pSwapChain;
-    ID3D12Resource*                     m_pRenderTargets[MAX_SHARED_BUFFERS];
+    std::vector<ID3D12Resource*>        m_pRenderTargets;
     ID3D12CommandAllocator*             m_pCommandAllocator;
     ID3D12CommandQueue*                 m_pCommandQueue;
-    ID3D12GraphicsCommandList*          m_pCommandList[MAX_SHARED_BUFFERS];
+    std::vector<ID3D12GraphicsCommandList*> m_pCommandList; // [shared buffer * numSharedBuffers + back buffer]
+
+    // begin and end timestamps of every copy command list, resolved by the list itself
+    struct TimestampSubmission {
+        UINT bufferIndex;
+        UINT64 fenceValue;          // signaled after the copy, 0 when nothing is pending
+        UINT64 frameId;             // producer frame id, the one of the vulkan queue track and the capture
+        UINT presentCount;          // matched against the DXGI frame statistics for the flip time
+        FrameLatencySample latency; // acquireTicks is the copy submission, the GPU fills rendered and copied
+    };
+    ID3D12QueryHeap*                    m_pTimestampHeap;     // null when unsupported
+    ID3D12Resource*                     m_pTimestampReadback;
+    const UINT64*                       m_pTimestamps;        // m_pTimestampReadback persistently mapped
+    std::vector<TimestampSubmission>    m_timestampSubmissions; // per command list
+    DX12GpuClock                        m_gpuClock;
+    GpuTimeline                         m_gpuTimeline;
+
+    // FrameCapture::isNeeded, a shared buffer copied into a readback buffer before it goes back to the producer
+    struct CaptureSlot {
+        ID3D12CommandAllocator*            pCommandAllocator;
+        ID3D12GraphicsCommandList*         pCommandList;
+        ID3D12Resource*                    pReadback;   // reallocated when the shared buffers are resized
+        const UINT8*                       pPixels;     // pReadback persistently mapped
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+        UINT64                             planarOffset; // of the planar buffer copy behind the pixels, 0 without
+    };
+    CaptureSlot                         m_captureSlots[FRAME_CAPTURE_RING_SIZE];
+    ID3D12Fence*                        m_pCaptureFence;      // signaled after each readback copy
+    UINT64                              m_captureFenceValue;
+    FrameCapture                        m_capture;
 
-    //ID3D12Resource*                     m_pReadback;
-    //D3D12_PLACED_SUBRESOURCE_FOOTPRINT* m_pReadbackTexLayout;
-    //ID3D12Fence*                        m_pReadbackFence;
-    //ID3D12GraphicsCommandList*          m_pReadbackCommandList[MAX_SHARED_BUFFERS];
-    //HANDLE                              m_readbackFenceEvent;
-    //UINT64                              m_readbackFenceValue;
+    DXGI_FORMAT                         m_sharedFormat;       // negotiated config.format
+    DXGI_FORMAT                         m_swapChainFormat;    // same layout, never sRGB with the flip model
 
     D3D12_VIEWPORT                      m_viewport;
     D3D12_RECT                          m_scissorRect;
 
     DX12SharedData*                     m_pSharedData;
-    ID3D12Resource*                     m_pSharedMem[MAX_SHARED_BUFFERS];
-    ID3D12Fence*                        m_pSharedFence[MAX_SHARED_BUFFERS];
-    HANDLE                              m_sharedMemHandle[MAX_SHARED_BUFFERS];
-    HANDLE                              m_sharedFenceHandle[MAX_SHARED_BUFFERS];
-    UINT64                              m_sharedFenceValue[MAX_SHARED_BUFFERS];
+    std::vector<ID3D12Resource*>        m_pSharedMem;
+    std::vector<ID3D12Fence*>           m_pSharedFence;
+    std::vector<HANDLE>                 m_sharedMemHandle;
+    std::vector<HANDLE>                 m_sharedFenceHandle;
+    std::vector<ID3D12Resource*>        m_pPlanarMem;         // config.recordYuvOnGpu, written by the producer compute pass
+    std::vector<HANDLE>                 m_planarMemHandle;
+    ID3D12Heap*                         m_pSharedHeap;        // config.singleHeap, the shared textures are placed in it
+    HANDLE                              m_sharedHeapHandle;
+    UINT64                              m_sharedHeapStride;   // between two placed textures
+    UINT                                m_numSharedBuffers;
     UINT                                m_frameIndex;
     UINT                                m_numFrames;
     bool                                m_initialized;
@@ -9,27 +9,192 @@
 #ifndef _DX12_SHARED_DATA_H_
 #define _DX12_SHARED_DATA_H_
 
-#include <windows.h>
+#include "SmodePlatform.h" // for Win32 types and NativeHandle
+#include "FrameLatency.h"
+#include "FrameRecorder.h" // for FrameRecordStats
+#include "FrameValidator.h" // for FrameValidationStats
+#include "GpuTimeline.h" // for GpuQueueStats
+#include <atomic>
+#include <string.h> // for memcpy
+#include <new> // for placement new
 
+// DX12SharedData is mapped by both processes in CROSS_PROCESS mode, bump the ABI version on any layout change
+#define DX12_SHARED_DATA_MAGIC       0x5244485332315844ULL // "DX12SHDR"
+#define DX12_SHARED_DATA_ABI_VERSION 19
+#define DX12_SHARED_DATA_CACHE_LINE  64
 
-struct DX12SharedData {
+// shared buffers are also swap chain back buffers
+#define DX12_MIN_SHARED_BUFFERS      2
+#define DX12_MAX_SHARED_BUFFERS      16 // DXGI_MAX_SWAP_CHAIN_BUFFERS
+
+// MAILBOX mode per buffer state
+enum SharedBufferState : UINT {
+  BUFFER_FREE,       // producer may render into it
+  BUFFER_WRITING,    // producer is rendering into it
+  BUFFER_READY,      // holds a completed frame, presenter may take it or producer may overwrite it
+  BUFFER_PRESENTING, // presenter is copying it
+};
+
+// pixel format of the shared buffers, the swap chain uses the matching UNORM or float format
+enum SharedBufferFormat : UINT {
+  SHARED_FORMAT_RGBA8,
+  SHARED_FORMAT_RGBA8_SRGB,
+  SHARED_FORMAT_BGRA8,
+  SHARED_FORMAT_BGRA8_SRGB,
+  SHARED_FORMAT_RGB10A2,
+  SHARED_FORMAT_RGBA16F, // scRGB, linear
+  NUM_SHARED_FORMATS
+};
+
+inline const char* SharedFormatName(UINT format)
+{
+  static const char* names[NUM_SHARED_FORMATS] = { "rgba8", "rgba8srgb", "bgra8", "bgra8srgb", "rgb10a2", "rgba16f" };
+  return format < NUM_SHARED_FORMATS ? names[format] : "unknown";
+}
+
+inline UINT SharedFormatBytesPerPixel(UINT format)
+  {return format == SHARED_FORMAT_RGBA16F ? 8 : 4;}
+
+// written by the presenter side only, read through DX12SharedData::ReadConfig()
+struct DX12SharedConfig {
   LUID AdapterLuid;
   HWND hWnd;
   UINT width;
   UINT height;
-  UINT numSharedBuffers;
-  HANDLE sharedMemHandle[MAX_SHARED_BUFFERS];
-  HANDLE sharedFenceHandle[MAX_SHARED_BUFFERS];
-  HANDLE startEvent;
-  HANDLE doneEvent;
-  UINT currentBufferIndex;
+  class FrameQueue* frameQueue; // threaded modes only
   bool forceDedicatedMemory;
-  bool terminate;
-  //bool verify;
+  bool singleHeap;          // the presenter places every shared buffer in one shared heap
+  bool timelineSemaphores;  // VkRender imports the shared fences as timeline semaphores and waits on them
+  UINT format;              // SharedBufferFormat, requested then negotiated by the presenter Init, the producer checks it
+  bool mailbox;
+  bool validate;            // presented frames checked by a FrameValidator, renderers draw FRAME_VALIDATE_PERIOD periodic content
+  UINT validateTolerance;   // per channel, 0 for identical frames
   bool vsync;
-  bool terminated;
-  //UINT captureFrame;
-  //LPCSTR captureFile;
+  UINT renderBackend;       // index in the backend registry, both processes run the same binary
+  UINT simulatedGpuLatency; // microseconds from submission to fence signal, NullRender only
+  UINT refreshRate;         // Hz, virtual vsync of SoftwarePresent, 0 for 60
+  bool hashFrames;          // SoftwarePresent
+  UINT captureFrame;        // first captured frame
+  UINT captureCount;        // 0 captures every frame from captureFrame on
+  LPCSTR captureFile;       // presenter process only, see FrameCapture
+  LPCSTR recordFile;        // presenter process only, see FrameRecorder
+  UINT recordYuvFormat;     // colorconvert::Format the recorder encodes, FORMAT_NONE keeps the shared format
+  bool recordYuvOnGpu;      // the producer converts each frame into planarMemHandle, the presenter CPU otherwise
+  char traceFile[260];      // empty when not tracing, the client appends its events to <traceFile>.client
+  int64_t traceEpoch;       // smode::getTicks() of trace time 0, shared by both processes
+  char pipelineCacheFile[260]; // VkRender pipeline cache loaded at Init and saved at Cleanup, empty to disable
+};
+
+// cache line aligned per buffer, producer and presenter work on different buffers most of the time
+struct alignas(DX12_SHARED_DATA_CACHE_LINE) DX12SharedBuffer {
+  smode::NativeHandle sharedMemHandle = SMODE_INVALID_NATIVE_HANDLE;
+  smode::NativeHandle sharedFenceHandle = SMODE_INVALID_NATIVE_HANDLE;
+  smode::NativeHandle planarMemHandle = SMODE_INVALID_NATIVE_HANDLE; // planarSize bytes, the frame in recordYuvFormat
+  UINT64 sharedMemOffset;       // in the single heap, 0 when the buffer has its own allocation
+  UINT64 sharedFenceValue;      // last value signaled on the shared fence, the next user waits for it and signals +1
+  std::atomic<UINT> state;      // MAILBOX only, SharedBufferState
+  std::atomic<UINT64> frameId;  // frame held by the buffer, stamped with the two below
+  int64_t submitTicks;          // smode::getTicks() when the producer submitted it
+  UINT64 submitFenceValue;      // sharedFenceValue the frame signals, the presenter ignores a stamp not matching its wait
+
+  // producer side, once the frame is submitted and sharedFenceValue holds its signal value
+  void StampFrame(UINT64 id, int64_t ticks)
+  {
+    submitTicks = ticks;
+    submitFenceValue = sharedFenceValue;
+    frameId.store(id, std::memory_order_relaxed);
+  }
+
+  // presenter side, 0 when the stamp belongs to another frame than the one signaling fenceValue
+  int64_t SubmitTicks(UINT64 fenceValue) const
+    {return submitFenceValue == fenceValue ? submitTicks : 0;}
+};
+
+// followed in memory by numSharedBuffers DX12SharedBuffer, allocate SizeFor(n) bytes and Construct() in place
+struct DX12SharedData {
+  // header, written once at creation
+  UINT64 magic;
+  UINT abiVersion;
+  UINT size;
+  UINT numSharedBuffers;
+
+  // configuration, seqlock protected
+  alignas(DX12_SHARED_DATA_CACHE_LINE) std::atomic<UINT> configSequence;
+  DX12SharedConfig config;
+
+  // buffer the producer renders next, written every frame
+  alignas(DX12_SHARED_DATA_CACHE_LINE) std::atomic<UINT> currentBufferIndex;
+  // bumped by the presenter each time it reallocates the shared buffers, new sharedMemHandle values then follow
+  std::atomic<UINT> bufferGeneration;
+  // single heap every buffer is placed in, its handle is the sharedMemHandle of all of them, 0 without
+  UINT64 sharedHeapSize;
+  // colorconvert::getSize of the planar buffer of each shared buffer, 0 without producer conversion
+  UINT64 planarSize;
+
+  // termination handshake, written once by either side
+  alignas(DX12_SHARED_DATA_CACHE_LINE) std::atomic<bool> terminate;
+  std::atomic<bool> terminated;
+
+  // GPU timestamps, the producer and the presenter queues, empty when the backend has none
+  alignas(DX12_SHARED_DATA_CACHE_LINE) GpuQueueStats renderQueue; // written by the render backend
+  // presenter region, away from the producer one above
+  alignas(DX12_SHARED_DATA_CACHE_LINE) GpuQueueStats presentQueue;
+  FrameLatencyStats latency; // written by the present backend
+  FrameValidationStats validation; // config.validate, written by the present backend
+  FrameRecordStats record;         // config.recordFile, written by the present backend
+
+  // distinct sharedMemHandle values, Buffer(0) holds the heap one, then every planarMemHandle
+  UINT NumSharedMemHandles() const
+    {return (sharedHeapSize ? 1 : numSharedBuffers) + (planarSize ? numSharedBuffers : 0);}
+
+  static size_t SizeFor(UINT numSharedBuffers)
+    {return sizeof(DX12SharedData) + numSharedBuffers * sizeof(DX12SharedBuffer);}
+
+  // memory must be zeroed, SizeFor(numSharedBuffers) bytes and cache line aligned
+  static DX12SharedData* Construct(void* memory, UINT numSharedBuffers)
+  {
+    DX12SharedData* res = new (memory) DX12SharedData();
+    for (UINT i = 0; i < numSharedBuffers; i++)
+      new (&res->Buffer(i)) DX12SharedBuffer();
+    res->magic = DX12_SHARED_DATA_MAGIC;
+    res->abiVersion = DX12_SHARED_DATA_ABI_VERSION;
+    res->size = (UINT)SizeFor(numSharedBuffers);
+    res->numSharedBuffers = numSharedBuffers;
+    return res;
+  }
+
+  bool ValidHeader() const
+  {
+    return magic == DX12_SHARED_DATA_MAGIC && abiVersion == DX12_SHARED_DATA_ABI_VERSION &&
+      numSharedBuffers >= DX12_MIN_SHARED_BUFFERS && numSharedBuffers <= DX12_MAX_SHARED_BUFFERS && size == SizeFor(numSharedBuffers);
+  }
+
+  DX12SharedBuffer& Buffer(UINT index)
+    {return reinterpret_cast<DX12SharedBuffer*>(this + 1)[index];}
+  const DX12SharedBuffer& Buffer(UINT index) const
+    {return reinterpret_cast<const DX12SharedBuffer*>(this + 1)[index];}
+
+  void BeginConfigWrite()
+  {
+    configSequence.store(configSequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void EndConfigWrite()
+    {configSequence.store(configSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);}
+
+  DX12SharedConfig ReadConfig() const
+  {
+    DX12SharedConfig res;
+    UINT sequence;
+    do {
+      while ((sequence = configSequence.load(std::memory_order_acquire)) & 1)
+        YieldProcessor();
+      memcpy(&res, (const void*)&config, sizeof(res));
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while (configSequence.load(std::memory_order_relaxed) != sequence);
+    return res;
+  }
 };
 
 class AbstractRender
@@ -41,9 +206,26 @@ public:
   virtual void Cleanup() = 0;
   virtual void Render() = 0;
   virtual bool Initialized() = 0;
+  virtual bool Resize() = 0; // between two frames, re-imports the shared buffers reallocated by the presenter
+};
+
+// consumes the shared buffers, owns their allocation
+class AbstractPresent
+{
+public:
+  virtual ~AbstractPresent() {}
+
+  virtual bool Init(DX12SharedData* pSharedData) = 0;
+  virtual void Cleanup() = 0;
+  virtual bool Render() = 0;                 // presents currentBufferIndex, then publishes the next one
+  virtual bool Render(UINT bufferIndex) = 0; // presents bufferIndex, the producer owns the rotation
+  virtual bool Resize() = 0;                 // every frame presented, reallocates the shared buffers at the config size
 };
 
 extern AbstractRender* newVKRender();
 extern AbstractRender* newGLRender();
+extern AbstractRender* newNullRender();
+extern AbstractPresent* newDX12Present();
+extern AbstractPresent* newSoftwarePresent();
 
 #endif // _DX12_SHARED_DATA_H_
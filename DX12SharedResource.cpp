@@ -7,141 +7,476 @@
 // license agreement from NVIDIA CORPORATION is strictly prohibited.
 
 #include <stdio.h>
-#include "DX12Present.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
 #include "DX12SharedData.h"
+#include "ColorConvert.h"
+#include "FrameCompare.h"
+#include "FrameQueue.h"
+#include "FrameStats.h"
+#include "GpuTimeline.h"
+#include "SmodePlatform.h"
 #include "SmodeErrorAndAssert.h"
+#include "Trace.h"
 
 enum RuntimeMode {
   SINGLE_THREADED,
   MULTI_THREADED,
   CROSS_PROCESS,
+  PIPELINED,
+  MAILBOX,
 };
 
-#define MIN_SHARED_BUFFERS   2
+static const char* RuntimeModeName[] = { "single-threaded", "multi-threaded", "cross-process", "pipelined", "mailbox" };
 
-#define NEW_RENDERER newGLRender
-//#define NEW_RENDERER newVKRender
+#define FULLTEST_MAX_SHARED_BUFFERS 4
 
-class DX12SharedResource
+// selected with -renderer, the first one is the default
+typedef struct _RenderBackend {
+    const char* name;
+    AbstractRender* (*newRender)();
+    AbstractPresent* (*newPresent)(); // allocates shared buffers the renderer can import
+} RenderBackend;
+
+static const RenderBackend RenderBackends[] = {
+#ifdef _WIN32
+    { "gl",   newGLRender,   newDX12Present },
+    { "vk",   newVKRender,   newDX12Present },
+#endif
+    { "null", newNullRender, newSoftwarePresent },
+};
+
+#define NUM_RENDER_BACKENDS (sizeof(RenderBackends) / sizeof(RenderBackends[0]))
+
+static int FindRenderBackend(const char* name)
+{
+    for (UINT i = 0; i < NUM_RENDER_BACKENDS; i++) {
+        if (_stricmp(RenderBackends[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static bool IsNumber(const char* str)
+{
+    if (*str == '\0') {
+        return false;
+    }
+    for (; *str; str++) {
+        if ((*str < '0') || (*str > '9')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// <n>, <first>-<last> or <first>- for every frame from <first> on
+static bool ParseCaptureRange(const char* range, UINT* pFirst, UINT* pCount)
+{
+    char* end = nullptr;
+    const unsigned long first = strtoul(range, &end, 10);
+    if (end == range) {
+        return false;
+    }
+    *pFirst = (UINT)first;
+    *pCount = 1;
+    if (*end == '-') {
+        range = end + 1;
+        if (*range == '\0') {
+            *pCount = 0;
+            return true;
+        }
+        const unsigned long last = strtoul(range, &end, 10);
+        if ((end == range) || (last < first)) {
+            return false;
+        }
+        *pCount = (UINT)(last - first + 1);
+    }
+    return *end == '\0';
+}
+
+static int FindSharedFormat(const char* name)
+{
+    for (UINT i = 0; i < NUM_SHARED_FORMATS; i++) {
+        if (_stricmp(SharedFormatName(i), name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+class DX12SharedResource : public smode::WindowListener
 {
 protected:
   LPCSTR m_program = nullptr;
   RuntimeMode m_mode;
+  UINT m_renderBackend = 0;
   bool m_initialized = false;
-  HINSTANCE m_hInstance = nullptr;
-  HANDLE m_hThread = nullptr;
-  HANDLE m_hMapFile = nullptr;
-  class DX12Present* m_dxPresent = nullptr;
-  LARGE_INTEGER m_frequency = { 0, };
-  LARGE_INTEGER m_startTime = { 0, };
-  LARGE_INTEGER m_stopTime = { 0, };
+  smode::Thread m_presentThread;
+  smode::SharedMemory m_sharedMemory;  // CROSS_PROCESS
+  smode::Process m_clientProcess;      // CROSS_PROCESS
+  smode::HandleChannel m_clientChannel; // CROSS_PROCESS
+  class AbstractPresent* m_dxPresent = nullptr;
+  int64_t m_frequency = 0;
+  int64_t m_startTime = 0;
+  int64_t m_stopTime = 0;
   UINT m_numSharedBuffers = 0;
+  UINT m_pipelineDepth = 0;
   UINT m_numFrames = 0;
   UINT m_duration = 0;
   UINT m_elapsed = 0;
   UINT m_status = 0;
-  //bool m_verify = 0;
+  bool m_validate = false;
+  UINT m_validateTolerance = 0;
   bool m_vsync = false;
   bool m_forceDedicatedMemory = false;
-  //UINT m_captureFrame = 0;
-  //LPCSTR m_captureFile = nullptr;
-  HANDLE startEvent = nullptr;
-  HANDLE doneEvent = nullptr;
+  bool m_singleHeap = false;
+  bool m_timelineSemaphores = false;
+  UINT m_format = SHARED_FORMAT_RGBA8;
+  UINT m_gpuLatency = 0;
+  UINT m_refreshRate = 0;
+  bool m_hashFrames = false;
+  UINT m_captureFrame = 0;
+  UINT m_captureCount = 0;
+  LPCSTR m_captureFile = nullptr;
+  LPCSTR m_recordFile = nullptr;
+  UINT m_recordYuvFormat = 0;
+  bool m_recordYuvOnGpu = false;
+  LPCSTR m_traceFile = nullptr;
+  LPCSTR m_pipelineCacheFile = nullptr;
+  bool m_resizeCycle = false;
+  smode::Event m_startEvent; // CROSS_PROCESS
+  smode::Event m_doneEvent;  // CROSS_PROCESS
+  class FrameQueue* m_frameQueue = nullptr;
+  UINT64 m_frameId = 0;
   double m_fps = 0.0;
+  FrameStats m_frameStats;     // whole run, every frame
+  GpuQueueSummary m_renderQueue = {};  // GPU timestamps, collected at Cleanup
+  GpuQueueSummary m_presentQueue = {};
+  FrameLatencySummary m_latency = {};
+  FrameValidationStats m_validation = {};
+  FrameRecordStats m_record = {};
+  int64_t m_lastFrameTime = 0; // 0 until the first frame completed
+  UINT m_windowWidth = 0;  // at Init
+  UINT m_windowHeight = 0;
+  UINT m_width = 0;        // of the shared buffers
+  UINT m_height = 0;
+  UINT m_resizeWidth = 0;  // pending resize, applied before the next frame, 0 when none
+  UINT m_resizeHeight = 0;
   struct DX12SharedData* m_pSharedData = nullptr;
   class AbstractRender* m_vkRender = nullptr;
 
 public:
-  DX12SharedResource(HINSTANCE hInstance, LPCSTR lpszProgram, UINT numSharedBuffers, UINT duration, RuntimeMode mode, bool vsync, /*bool verify,*/ bool dedicated/*, UINT captureFrame, LPCSTR captureFile*/);
+  DX12SharedResource(LPCSTR lpszProgram, UINT renderBackend, UINT numSharedBuffers, UINT duration, RuntimeMode mode, UINT pipelineDepth, bool vsync, bool validate, UINT validateTolerance, bool dedicated, bool singleHeap, bool timelineSemaphores, UINT format, UINT gpuLatency, UINT refreshRate, bool hashFrames, UINT captureFrame, UINT captureCount, LPCSTR captureFile, LPCSTR recordFile, UINT recordYuvFormat, bool recordYuvOnGpu, LPCSTR traceFile, LPCSTR pipelineCacheFile, bool resizeCycle);
   ~DX12SharedResource();
 
   UINT GetStatus() { return m_status; }
   double GetFPS() { return m_fps; }
+  FrameStatsSummary GetFrameStats();
+  GpuQueueSummary GetRenderQueueStats() { return m_renderQueue; }
+  GpuQueueSummary GetPresentQueueStats() { return m_presentQueue; }
+  FrameLatencySummary GetLatencyStats() { return m_latency; }
+  FrameValidationStats GetValidationStats() { return m_validation; }
+  FrameRecordStats GetRecordStats() { return m_record; }
   void InitSharedData(HWND hWnd, UINT width, UINT height);
   bool Init(HWND hWnd, UINT width, UINT height);
   void Cleanup();
   void Render();
+  bool Resize(UINT width, UINT height);
+
+  // smode::WindowListener
+  bool windowCreated(HWND hWnd, UINT width, UINT height) override
+    {return Init(hWnd, width, height);}
+  void windowClosing() override
+    {Cleanup();}
+  void windowUpdate() override
+    {Render();}
+  void windowResized(UINT width, UINT height) override
+    {m_resizeWidth = width; m_resizeHeight = height;}
 };
 
-#define VK_DX12_SHARED_RESOURCE L"DX12SharedResource"
+#define VK_DX12_SHARED_RESOURCE "DX12SharedResource"
+#define TRACE_CLIENT_SUFFIX ".client"
 #define VK_DX12_SHARED_RESOURCE_CLIENT_ARG "DX12SharedResource$egahasu64167ghfggfadsd51545gjja66717615gsdfgajhjhsghdfghsjk$"
 
-DX12SharedResource::DX12SharedResource(HINSTANCE hInstance, LPCSTR lpszProgram, UINT numSharedBuffers, UINT duration, RuntimeMode mode, bool vsync, /*bool verify,*/ bool dedicated/*, UINT captureFrame, LPCSTR captureFile*/)
+DX12SharedResource::DX12SharedResource(LPCSTR lpszProgram, UINT renderBackend, UINT numSharedBuffers, UINT duration, RuntimeMode mode, UINT pipelineDepth, bool vsync, bool validate, UINT validateTolerance, bool dedicated, bool singleHeap, bool timelineSemaphores, UINT format, UINT gpuLatency, UINT refreshRate, bool hashFrames, UINT captureFrame, UINT captureCount, LPCSTR captureFile, LPCSTR recordFile, UINT recordYuvFormat, bool recordYuvOnGpu, LPCSTR traceFile, LPCSTR pipelineCacheFile, bool resizeCycle)
 {
   m_program = lpszProgram;
-  m_hInstance = hInstance;
+  m_renderBackend = renderBackend;
   m_numSharedBuffers = numSharedBuffers;
-  //m_verify = verify;
+  m_validate = validate;
+  m_validateTolerance = validateTolerance;
   m_vsync = vsync;
   m_forceDedicatedMemory = dedicated;
+  m_singleHeap = singleHeap;
+  m_timelineSemaphores = timelineSemaphores;
+  m_format = format;
+  m_gpuLatency = gpuLatency;
+  m_refreshRate = refreshRate;
+  m_hashFrames = hashFrames;
   m_mode = mode;
+  m_pipelineDepth = pipelineDepth;
   m_duration = duration;
-  //m_captureFrame = captureFrame;
-  //m_captureFile = captureFile;
+  m_captureFrame = captureFrame;
+  m_captureCount = captureCount;
+  m_captureFile = captureFile;
+  m_recordFile = recordFile;
+  m_recordYuvFormat = recordYuvFormat;
+  m_recordYuvOnGpu = recordYuvOnGpu;
+  m_traceFile = traceFile;
+  m_pipelineCacheFile = pipelineCacheFile;
+  m_resizeCycle = resizeCycle;
 }
 
 void DX12SharedResource::InitSharedData(HWND hWnd, UINT width, UINT height)
 {
   m_pSharedData->currentBufferIndex = 0;
-  m_pSharedData->numSharedBuffers = m_numSharedBuffers;
-  //m_pSharedData->verify = m_verify;
-  m_pSharedData->vsync = m_vsync;
-  m_pSharedData->forceDedicatedMemory = m_forceDedicatedMemory;
-  //m_pSharedData->captureFile = m_captureFile;
-  //m_pSharedData->captureFrame = m_captureFrame;
-  m_pSharedData->hWnd = hWnd;
-  m_pSharedData->width = width;
-  m_pSharedData->height = height;
-  m_pSharedData->startEvent = startEvent;
-  m_pSharedData->doneEvent = doneEvent;
+  m_pSharedData->BeginConfigWrite();
+  m_pSharedData->config.validate = m_validate;
+  m_pSharedData->config.validateTolerance = m_validateTolerance;
+  m_pSharedData->config.vsync = m_vsync;
+  m_pSharedData->config.forceDedicatedMemory = m_forceDedicatedMemory;
+  m_pSharedData->config.singleHeap = m_singleHeap;
+  m_pSharedData->config.timelineSemaphores = m_timelineSemaphores;
+  m_pSharedData->config.format = m_format;
+  m_pSharedData->config.mailbox = m_mode == MAILBOX;
+  m_pSharedData->config.renderBackend = m_renderBackend;
+  m_pSharedData->config.simulatedGpuLatency = m_gpuLatency;
+  m_pSharedData->config.refreshRate = m_refreshRate;
+  m_pSharedData->config.hashFrames = m_hashFrames;
+  for (UINT i = 0; i < m_numSharedBuffers; i++) {
+    m_pSharedData->Buffer(i).state.store(BUFFER_FREE);
+    m_pSharedData->Buffer(i).frameId = 0;
+  }
+  m_pSharedData->config.captureFile = m_captureFile;
+  m_pSharedData->config.recordFile = m_recordFile;
+  m_pSharedData->config.recordYuvFormat = m_recordYuvFormat;
+  m_pSharedData->config.recordYuvOnGpu = m_recordYuvOnGpu;
+  m_pSharedData->config.captureFrame = m_captureFrame;
+  m_pSharedData->config.captureCount = m_captureCount;
+  snprintf(m_pSharedData->config.traceFile, sizeof(m_pSharedData->config.traceFile), "%s", m_traceFile ? m_traceFile : "");
+  m_pSharedData->config.traceEpoch = trace::getEpoch();
+  snprintf(m_pSharedData->config.pipelineCacheFile, sizeof(m_pSharedData->config.pipelineCacheFile), "%s", m_pipelineCacheFile ? m_pipelineCacheFile : "");
+  m_pSharedData->config.hWnd = hWnd;
+  m_pSharedData->config.width = width;
+  m_pSharedData->config.height = height;
+  m_pSharedData->config.frameQueue = m_frameQueue;
+  m_pSharedData->EndConfigWrite();
   m_pSharedData->terminate = false;
   m_pSharedData->terminated = false;
 }
 
+// in process shared data, same layout as the CROSS_PROCESS file mapping
+static DX12SharedData* NewSharedData(UINT numSharedBuffers)
+{
+    const size_t size = DX12SharedData::SizeFor(numSharedBuffers);
+    void* memory = smode::alignedAlloc(size, DX12_SHARED_DATA_CACHE_LINE);
+    assert(memory);
+    memset(memory, 0, size);
+    return DX12SharedData::Construct(memory, numSharedBuffers);
+}
+
+static void DeleteSharedData(DX12SharedData* pSharedData)
+{
+    smode::alignedFree(pSharedData);
+}
+
 DX12SharedResource::~DX12SharedResource()
 {
     Cleanup();
 }
 
-static DWORD WINAPI PresentThread(void* param)
+// Producer side of MAILBOX mode: a free buffer if any, otherwise the oldest frame not taken by the presenter is overwritten.
+static UINT AcquireWritableBuffer(DX12SharedData* pSharedData)
 {
-    DX12SharedData* pSharedData = reinterpret_cast<DX12SharedData*>(param);
-    DWORD retVal = 1;
+    while (1) {
+        UINT oldest = pSharedData->numSharedBuffers;
+        for (UINT i = 0; i < pSharedData->numSharedBuffers; i++) {
+            UINT state = pSharedData->Buffer(i).state.load(std::memory_order_acquire);
+            if (state == BUFFER_FREE) {
+                pSharedData->Buffer(i).state.store(BUFFER_WRITING, std::memory_order_relaxed);
+                return i;
+            }
+            if ((state == BUFFER_READY) && ((oldest == pSharedData->numSharedBuffers) || (pSharedData->Buffer(i).frameId < pSharedData->Buffer(oldest).frameId))) {
+                oldest = i;
+            }
+        }
 
-    WaitForSingleObject(pSharedData->startEvent, INFINITE);
-    DX12Present* dxPresent = new DX12Present();
+        UINT expected = BUFFER_READY;
+        if ((oldest < pSharedData->numSharedBuffers) && pSharedData->Buffer(oldest).state.compare_exchange_strong(expected, BUFFER_WRITING, std::memory_order_acquire)) {
+            return oldest;
+        }
+    }
+}
 
-    if (dxPresent->Init(pSharedData)) {
-        SetEvent(pSharedData->doneEvent);
+// Presenter side of MAILBOX mode: takes the newest completed frame, false if the producer is overwriting all of them.
+static bool AcquireNewestBuffer(DX12SharedData* pSharedData, UINT& bufferIndex)
+{
+    while (1) {
+        UINT newest = pSharedData->numSharedBuffers;
+        for (UINT i = 0; i < pSharedData->numSharedBuffers; i++) {
+            if ((pSharedData->Buffer(i).state.load(std::memory_order_acquire) == BUFFER_READY) &&
+                ((newest == pSharedData->numSharedBuffers) || (pSharedData->Buffer(i).frameId > pSharedData->Buffer(newest).frameId))) {
+                newest = i;
+            }
+        }
+        if (newest == pSharedData->numSharedBuffers) {
+            return false;
+        }
 
-        while (1) {
-            WaitForSingleObject(pSharedData->startEvent, INFINITE);
+        UINT expected = BUFFER_READY;
+        if (pSharedData->Buffer(newest).state.compare_exchange_strong(expected, BUFFER_PRESENTING, std::memory_order_acquire)) {
+            bufferIndex = newest;
+            return true;
+        }
+    }
+}
 
-            if (pSharedData->terminate) {
-                //dxPresent->WaitForCompletion();
-                SetEvent(pSharedData->doneEvent);
-                WaitForSingleObject(pSharedData->startEvent, INFINITE);
-                retVal = 0;
-                break;
-            }
+// bufferIndex of a resize request travelling through the frame queue behind the frames to present
+#define FRAME_SLOT_RESIZE 0xffffffffu
 
-            if (!dxPresent->Render()) {
-                break;
-            }
+// Presenter side of a resize: every earlier frame is presented, the producer waits and the new size is in the config.
+static bool ResizeBuffers(AbstractPresent* dxPresent, DX12SharedData* pSharedData)
+{
+    TRACE_SCOPE("ResizeBuffers");
+    if (!dxPresent->Resize()) {
+        fprintf(stderr, "Cannot resize the shared buffers.\n");
+        return false;
+    }
+    // MAILBOX frames of the previous size are dropped
+    for (UINT i = 0; i < pSharedData->numSharedBuffers; i++) {
+        pSharedData->Buffer(i).state.store(BUFFER_FREE, std::memory_order_relaxed);
+    }
+    pSharedData->bufferGeneration.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+// distinct memory handles to hand over to the client, a single heap is sent once, the planar buffers follow
+static void AppendSharedMemHandles(const DX12SharedData* pSharedData, std::vector<smode::NativeHandle>& handles)
+{
+    const UINT numSharedMemHandles = pSharedData->sharedHeapSize ? 1 : pSharedData->numSharedBuffers;
+    for (UINT i = 0; i < numSharedMemHandles; i++) {
+        handles.push_back(pSharedData->Buffer(i).sharedMemHandle);
+    }
+    for (UINT i = 0; pSharedData->planarSize && (i < pSharedData->numSharedBuffers); i++) {
+        handles.push_back(pSharedData->Buffer(i).planarMemHandle);
+    }
+}
+
+// client side, received in AppendSharedMemHandles order
+static void SetSharedMemHandles(DX12SharedData* pSharedData, const smode::NativeHandle* handles)
+{
+    const UINT numSharedMemHandles = pSharedData->sharedHeapSize ? 1 : pSharedData->numSharedBuffers;
+    for (UINT i = 0; i < pSharedData->numSharedBuffers; i++) {
+        pSharedData->Buffer(i).sharedMemHandle = handles[pSharedData->sharedHeapSize ? 0 : i];
+        pSharedData->Buffer(i).planarMemHandle = pSharedData->planarSize ? handles[numSharedMemHandles + i] : SMODE_INVALID_NATIVE_HANDLE;
+    }
+}
+
+static bool PresentTraced(AbstractPresent* dxPresent)
+{
+    TRACE_SCOPE("Present");
+    return dxPresent->Render();
+}
+
+static bool WaitClient(smode::Event& doneEvent, smode::Process& clientProcess)
+{
+    TRACE_SCOPE("WaitClient");
+    return doneEvent.waitOrProcessExit(clientProcess);
+}
+
+static bool WaitFrame(FrameQueue* frameQueue, FrameSlot& slot)
+{
+    TRACE_SCOPE("WaitFrame");
+    return frameQueue->Pop(slot);
+}
 
-            SetEvent(pSharedData->doneEvent);
+static bool WaitPublished(FrameQueue* frameQueue, UINT64& published)
+{
+    TRACE_SCOPE("WaitFrame");
+    return frameQueue->WaitPublished(published);
+}
+
+static bool PresentFrames(AbstractPresent* dxPresent, DX12SharedData* pSharedData)
+{
+    FrameQueue* frameQueue = pSharedData->config.frameQueue;
+
+    if (pSharedData->config.mailbox) {
+        UINT64 published = 0;
+        while (WaitPublished(frameQueue, published)) {
+            // only resize requests travel through the ring in MAILBOX mode
+            FrameSlot request;
+            if (frameQueue->TryPop(request)) {
+                if (!ResizeBuffers(dxPresent, pSharedData)) {
+                    return false;
+                }
+                frameQueue->Release();
+                continue;
+            }
+            UINT bufferIndex;
+            if (!AcquireNewestBuffer(pSharedData, bufferIndex)) {
+                continue;
+            }
+            TRACE_SCOPE_VALUE("Present", "frame", pSharedData->Buffer(bufferIndex).frameId);
+            if (!dxPresent->Render(bufferIndex)) {
+                return false;
+            }
+            pSharedData->Buffer(bufferIndex).state.store(BUFFER_FREE, std::memory_order_release);
+        }
+    } else {
+        FrameSlot slot;
+        while (WaitFrame(frameQueue, slot)) {
+            if (slot.bufferIndex == FRAME_SLOT_RESIZE) {
+                if (!ResizeBuffers(dxPresent, pSharedData)) {
+                    return false;
+                }
+                frameQueue->Release();
+                continue;
+            }
+            TRACE_SCOPE_VALUE("Present", "frame", slot.frameId);
+            if (!dxPresent->Render(slot.bufferIndex)) {
+                return false;
+            }
+            frameQueue->Release();
         }
     }
 
-    dxPresent->Cleanup();
-    delete dxPresent;
+    return true;
+}
+
+static uint32_t PresentThread(void* param)
+{
+    DX12SharedData* pSharedData = reinterpret_cast<DX12SharedData*>(param);
+    FrameQueue* frameQueue = pSharedData->config.frameQueue;
+    uint32_t retVal = 1;
+
+    trace::setThreadName("present");
+
+    AbstractPresent* dxPresent = RenderBackends[pSharedData->config.renderBackend].newPresent();
+
+    if (dxPresent->Init(pSharedData)) {
+        frameQueue->Start();
+
+        if (PresentFrames(dxPresent, pSharedData) && pSharedData->terminate) {
+            //dxPresent->WaitForCompletion();
+            retVal = 0;
+        }
+    }
 
     if (retVal) {
         pSharedData->terminate = true;
-
-        SetEvent(pSharedData->doneEvent);
+        frameQueue->Close();
     }
 
+    // the producer must release its imports before the shared resources go away
+    frameQueue->WaitDetached();
+
+    dxPresent->Cleanup();
+    delete dxPresent;
+
     pSharedData->terminated = true;
 
     return retVal;
@@ -152,11 +487,11 @@ bool DX12SharedResource::Init(HWND hWnd, UINT width, UINT height)
     switch (m_mode) {
     case SINGLE_THREADED:
         {
-            m_pSharedData = new DX12SharedData;
+            m_pSharedData = NewSharedData(m_numSharedBuffers);
             InitSharedData(hWnd, width, height);
 
-            m_vkRender = NEW_RENDERER();
-            m_dxPresent = new DX12Present();
+            m_vkRender = RenderBackends[m_renderBackend].newRender();
+            m_dxPresent = RenderBackends[m_renderBackend].newPresent();
 
             if (!m_dxPresent->Init(m_pSharedData)) {
                 return false;
@@ -168,27 +503,24 @@ bool DX12SharedResource::Init(HWND hWnd, UINT width, UINT height)
         }
         break;
     case MULTI_THREADED:
+    case PIPELINED:
+    case MAILBOX:
         {
-            m_pSharedData = new DX12SharedData;
-
-            startEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-            assert(startEvent);
-
-            doneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-            assert(doneEvent);
+            m_pSharedData = NewSharedData(m_numSharedBuffers);
+            m_frameQueue = new FrameQueue(m_mode == PIPELINED ? m_pipelineDepth : 1);
 
             InitSharedData(hWnd, width, height);
 
-            m_hThread = CreateThread(NULL, NULL, PresentThread, (void*)m_pSharedData, NULL, NULL);
-
-            SetEvent(startEvent);
-            WaitForSingleObject(doneEvent, INFINITE);
+            if (!m_presentThread.start(PresentThread, m_pSharedData)) {
+                fprintf(stderr, "Cannot start the present thread.\n");
+                return false;
+            }
 
-            if (m_pSharedData->terminate) {
+            if (!m_frameQueue->WaitStarted()) {
                 return false;
             }
 
-            m_vkRender = NEW_RENDERER();
+            m_vkRender = RenderBackends[m_renderBackend].newRender();
 
             if (!m_vkRender->Init(m_pSharedData)) {
                 return false;
@@ -197,16 +529,18 @@ bool DX12SharedResource::Init(HWND hWnd, UINT width, UINT height)
         break;
     default: // CROSS_PROCESS
         {
-            m_hMapFile = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(DX12SharedData), VK_DX12_SHARED_RESOURCE);
-            m_pSharedData = reinterpret_cast<DX12SharedData*>(MapViewOfFile(m_hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(DX12SharedData)));
-
-            startEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-            assert(startEvent);
+            if (!m_sharedMemory.create(VK_DX12_SHARED_RESOURCE, DX12SharedData::SizeFor(m_numSharedBuffers))) {
+                fprintf(stderr, "Cannot create the shared memory.\n");
+                return false;
+            }
+            m_pSharedData = DX12SharedData::Construct(m_sharedMemory.getData(), m_numSharedBuffers); // fresh mapping, zeroed
 
-            doneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-            assert(doneEvent);
+            if (!m_startEvent.create() || !m_doneEvent.create()) {
+                fprintf(stderr, "Cannot create the client events.\n");
+                return false;
+            }
 
-            m_dxPresent = new DX12Present();
+            m_dxPresent = RenderBackends[m_renderBackend].newPresent();
 
             InitSharedData(hWnd, width, height);
 
@@ -214,26 +548,36 @@ bool DX12SharedResource::Init(HWND hWnd, UINT width, UINT height)
                 return false;
             }
 
-            char cmdLine[256];
-            sprintf_s(cmdLine, "%s %s", m_program, VK_DX12_SHARED_RESOURCE_CLIENT_ARG);
+            if (!m_clientChannel.create()) {
+                fprintf(stderr, "Cannot create the client handle channel.\n");
+                return false;
+            }
 
-            STARTUPINFOA si;
-            PROCESS_INFORMATION pi;
-            ZeroMemory(&si, sizeof(si));
-            si.cb = sizeof(si);
-            ZeroMemory(&pi, sizeof(pi));                        
-            CreateProcessA(NULL,   // No module name (use command line)
-                cmdLine,        // Command line
-                NULL,           // Process handle not inheritable
-                NULL,           // Thread handle not inheritable
-                TRUE,          // Set handle inheritance to FALSE
-                0,              // No creation flags
-                NULL,           // Use parent's environment block
-                NULL,           // Use parent's starting directory 
-                &si,            // Pointer to STARTUPINFO structure
-                &pi);           // Pointer to PROCESS_INFORMATION structure
+            const char* arguments[] = { VK_DX12_SHARED_RESOURCE_CLIENT_ARG, m_clientChannel.getChildArgument(), nullptr };
+            if (!m_clientProcess.spawn(m_program, arguments)) {
+                fprintf(stderr, "Cannot start the client process.\n");
+                return false;
+            }
+            m_clientChannel.closeChildEnd();
+
+            // events first, then the fence of each shared buffer and their memory
+            std::vector<smode::NativeHandle> handles;
+            handles.push_back(m_startEvent.getNativeHandle());
+            handles.push_back(m_doneEvent.getNativeHandle());
+            for (UINT i = 0; i < m_numSharedBuffers; i++) {
+                handles.push_back(m_pSharedData->Buffer(i).sharedFenceHandle);
+            }
+            AppendSharedMemHandles(m_pSharedData, handles);
+            if (!m_clientChannel.send(m_clientProcess, handles.data(), (uint32_t)handles.size())) {
+                fprintf(stderr, "Cannot send handles to the client process.\n");
+                return false;
+            }
 
-            WaitForSingleObject(doneEvent, INFINITE);
+            // a client dying before its handshake must not hang us
+            if (!m_doneEvent.waitOrProcessExit(m_clientProcess)) {
+                fprintf(stderr, "Client process exited during initialization.\n");
+                return false;
+            }
 
             if (m_pSharedData->terminate) {
                 return false;
@@ -241,56 +585,66 @@ bool DX12SharedResource::Init(HWND hWnd, UINT width, UINT height)
         }
     }
 
-    QueryPerformanceFrequency(&m_frequency);
-    QueryPerformanceCounter(&m_startTime);
+    m_frequency = smode::getTicksPerSecond();
+    m_startTime = smode::getTicks();
 
     m_numFrames = 0;
+    m_frameStats.reset();
+    m_lastFrameTime = 0;
+    m_windowWidth = m_width = width;
+    m_windowHeight = m_height = height;
+    m_resizeWidth = m_resizeHeight = 0;
+    m_initialized = true;
 
     return true;
 }
 
-void DX12SharedResource::Cleanup()
+// with vsync a frame is dropped when it missed its vertical blank, otherwise when it is a hitch against the median
+FrameStatsSummary DX12SharedResource::GetFrameStats()
 {
-    if (m_hThread) {
-        if (m_pSharedData->terminate) {
-            if (m_vkRender) {
-                m_vkRender->Cleanup();
-                delete m_vkRender;
-                m_vkRender = 0;
-            }
-        } else {
-            m_pSharedData->terminate = true;
-            SetEvent(startEvent);
+    double refreshPeriod = 0.0;
+    if (m_vsync) {
+        refreshPeriod = 1000.0 / (m_refreshRate ? m_refreshRate : 60);
+    }
+    return m_frameStats.summarize(refreshPeriod);
+}
 
-            WaitForSingleObject(doneEvent, INFINITE);
+void DX12SharedResource::Cleanup()
+{
+    m_initialized = false;
 
-            if (m_vkRender) {
-                m_vkRender->Cleanup();
-                delete m_vkRender;
-                m_vkRender = 0;
-            }
+    if (m_presentThread.isStarted()) {
+        if (!m_pSharedData->terminate) {
+            m_pSharedData->terminate = true;
+            m_frameQueue->Close();
+        }
 
-            SetEvent(startEvent);
+        if (m_vkRender) {
+            m_vkRender->Cleanup();
+            delete m_vkRender;
+            m_vkRender = 0;
         }
 
-        WaitForSingleObject(m_hThread, INFINITE);
+        m_frameQueue->Detach();
 
-        assert(m_pSharedData->terminated);
+        m_presentThread.join();
 
-        m_hThread = 0;
+        assert(m_pSharedData->terminated);
     } else if (m_mode == CROSS_PROCESS) {
         if (m_pSharedData) {
             if (!m_pSharedData->terminate) {
                 m_pSharedData->terminate = true;
-                SetEvent(startEvent);
+                if (m_startEvent.isValid()) {
+                    m_startEvent.set();
+                }
             }
 
-            volatile bool* pTerminated = &m_pSharedData->terminated;
-            while (!*pTerminated) {
-                Sleep(1);
-            }
         }
 
+        m_clientProcess.wait();
+        m_clientProcess.close();
+        m_clientChannel.close();
+
         if (m_dxPresent) {
             m_dxPresent->Cleanup();
             delete m_dxPresent;
@@ -310,26 +664,30 @@ void DX12SharedResource::Cleanup()
         }
     }
 
-    if (startEvent) {
-        CloseHandle(startEvent);
-        startEvent = 0;
+    // both queues are idle, the client process included
+    if (m_pSharedData) {
+        m_renderQueue = GpuTimeline::summarize(m_pSharedData->renderQueue);
+        m_presentQueue = GpuTimeline::summarize(m_pSharedData->presentQueue);
+        m_latency = m_pSharedData->latency.summarize();
+        m_validation = m_pSharedData->validation;
+        m_record = m_pSharedData->record;
+        if (m_validate && m_validation.failed) {
+            m_status = 1;
+        }
     }
 
-    if (doneEvent) {
-        CloseHandle(doneEvent);
-        doneEvent = 0;
+    m_startEvent.close();
+    m_doneEvent.close();
+
+    if (m_frameQueue) {
+        delete m_frameQueue;
+        m_frameQueue = nullptr;
     }
 
     if (m_mode == CROSS_PROCESS) {
-        if (m_pSharedData) {
-            UnmapViewOfFile(m_pSharedData);
-        }
-        if (m_hMapFile) {
-            CloseHandle(m_hMapFile);
-            m_hMapFile = 0;
-        }
-    } else {
-        delete m_pSharedData;
+        m_sharedMemory.close();
+    } else if (m_pSharedData) {
+        DeleteSharedData(m_pSharedData);
     }
 
     m_pSharedData = 0;
@@ -337,44 +695,144 @@ void DX12SharedResource::Cleanup()
     m_numSharedBuffers = 0;
 }
 
+// Between two frames: the presenter reallocates the shared buffers once the frames in flight are presented and the
+// producer re-imports them. Devices, pipelines, the present thread and the client process stay.
+bool DX12SharedResource::Resize(UINT width, UINT height)
+{
+    TRACE_SCOPE("Resize");
+    m_pSharedData->BeginConfigWrite();
+    m_pSharedData->config.width = width;
+    m_pSharedData->config.height = height;
+    m_pSharedData->EndConfigWrite();
+
+    switch (m_mode) {
+    case SINGLE_THREADED:
+        if (!ResizeBuffers(m_dxPresent, m_pSharedData) || !m_vkRender->Resize()) {
+            return false;
+        }
+        break;
+    case MULTI_THREADED:
+    case PIPELINED:
+    case MAILBOX:
+        {
+            // the present thread runs it after the frames already pushed
+            FrameSlot slot = { FRAME_SLOT_RESIZE, 0, 0, 0 };
+            if (!m_frameQueue->Push(slot) || !m_frameQueue->WaitIdle() || !m_vkRender->Resize()) {
+                return false;
+            }
+        }
+        break;
+    default: // CROSS_PROCESS
+        {
+            if (!ResizeBuffers(m_dxPresent, m_pSharedData)) {
+                return false;
+            }
+            // the client receives them when it sees the new generation, at its next frame
+            std::vector<smode::NativeHandle> handles;
+            AppendSharedMemHandles(m_pSharedData, handles);
+            if (!m_clientChannel.send(m_clientProcess, handles.data(), (uint32_t)handles.size())) {
+                fprintf(stderr, "Cannot send handles to the client process.\n");
+                return false;
+            }
+        }
+    }
+
+    m_width = width;
+    m_height = height;
+    return true;
+}
+
 void DX12SharedResource::Render()
 {
     bool terminate = false;
     bool initialized = false;
 
     if (m_mode == CROSS_PROCESS){
-        initialized = !m_pSharedData->terminate;
+        initialized = m_initialized && !m_pSharedData->terminate;
     } else {
         initialized = m_vkRender && m_vkRender->Initialized();
     }
 
     if (initialized) {
+        TRACE_SCOPE("Frame");
+        if (m_resizeWidth && ((m_resizeWidth != m_width) || (m_resizeHeight != m_height))) {
+            if (!Resize(m_resizeWidth, m_resizeHeight)) {
+                fprintf(stderr, "Resize to %ux%u failed\n", m_resizeWidth, m_resizeHeight);
+                m_status = 1;
+                smode::closeWindow(m_pSharedData->config.hWnd);
+                return;
+            }
+        }
+        m_resizeWidth = m_resizeHeight = 0;
+
         switch (m_mode) {
         case SINGLE_THREADED:
-            m_vkRender->Render();
-            if (!m_dxPresent->Render()) {
+            {
+                TRACE_SCOPE("Render");
+                const UINT bufferIndex = m_pSharedData->currentBufferIndex;
+                m_vkRender->Render();
+                m_pSharedData->Buffer(bufferIndex).StampFrame(m_frameId++, smode::getTicks());
+            }
+            if (!PresentTraced(m_dxPresent)) {
                 fprintf(stderr, "Incorrect Render Data\n");
                 m_status = 1;
                 terminate = true;
             }
             break;
         case MULTI_THREADED:
-            m_vkRender->Render();
-            SetEvent(startEvent);
-            WaitForSingleObject(doneEvent, INFINITE);
-            if (m_pSharedData->terminate) {
+        case PIPELINED:
+            {
+                TRACE_SCOPE_VALUE("Render", "frame", m_frameId);
+                m_vkRender->Render();
+            }
+            {
+                // the producer owns the buffer rotation, the presenter releases each buffer once its copy is queued
+                const UINT bufferIndex = m_pSharedData->currentBufferIndex;
+                const int64_t submitTicks = smode::getTicks();
+                m_pSharedData->Buffer(bufferIndex).StampFrame(m_frameId, submitTicks);
+                FrameSlot slot = { bufferIndex, m_pSharedData->Buffer(bufferIndex).sharedFenceValue, m_frameId++, submitTicks };
+                TRACE_SCOPE_VALUE("Handoff", "fence", slot.fenceValue);
+                if (!m_frameQueue->Push(slot) || ((m_mode == MULTI_THREADED) && !m_frameQueue->WaitIdle())) {
+                    terminate = true;
+                }
+                m_pSharedData->currentBufferIndex = (bufferIndex + 1) % m_pSharedData->numSharedBuffers;
+            }
+            if (terminate) {
+                fprintf(stderr, "Incorrect Render Data\n");
+                m_status = 1;
+            }
+            break;
+        case MAILBOX:
+            {
+                // never waits for the presenter, a frame it did not pick up yet is simply replaced
+                const UINT bufferIndex = AcquireWritableBuffer(m_pSharedData);
+                m_pSharedData->currentBufferIndex = bufferIndex;
+                {
+                    TRACE_SCOPE_VALUE("Render", "frame", m_frameId);
+                    m_vkRender->Render();
+                }
+                m_pSharedData->Buffer(bufferIndex).StampFrame(m_frameId, smode::getTicks());
+                m_pSharedData->Buffer(bufferIndex).state.store(BUFFER_READY, std::memory_order_release);
+                m_frameQueue->Publish(m_frameId++);
+                if (m_frameQueue->Closed()) {
+                    terminate = true;
+                }
+            }
+            if (terminate) {
                 fprintf(stderr, "Incorrect Render Data\n");
                 m_status = 1;
-                terminate = true;
             }
             break;
         default: // CROSS_PROCESS
-            SetEvent(startEvent);
-            WaitForSingleObject(doneEvent, INFINITE);
-            if (m_pSharedData->terminate) {
+            m_startEvent.set();
+            if (!WaitClient(m_doneEvent, m_clientProcess)) {
+                fprintf(stderr, "Client process exited.\n");
+                m_status = 1;
+                terminate = true;
+            } else if (m_pSharedData->terminate) {
                 terminate = true;
             } else {
-                if (!m_dxPresent->Render()) {
+                if (!PresentTraced(m_dxPresent)) {
                     fprintf(stderr, "Incorrect Render Data\n");
                     m_status = 1;
                     terminate = true;
@@ -383,24 +841,38 @@ void DX12SharedResource::Render()
         }
 
         m_numFrames++;
+
+        const int64_t frameTime = smode::getTicks();
+        if (m_lastFrameTime) {
+            m_frameStats.record((uint64_t)((double)(frameTime - m_lastFrameTime) * 1e9 / (double)m_frequency));
+        }
+        m_lastFrameTime = frameTime;
+
 /*        if (m_pSharedData->captureFile) {
             if (m_pSharedData->captureFrame == m_numFrames - 1) {
                 terminate = true;
             }
         } else*/ {
-            QueryPerformanceCounter(&m_stopTime);
-            DWORD ms = (DWORD)((m_stopTime.QuadPart - m_startTime.QuadPart) * 1000 / m_frequency.QuadPart);
+            m_stopTime = smode::getTicks();
+            DWORD ms = (DWORD)((m_stopTime - m_startTime) * 1000 / m_frequency);
             if (ms > 1000) {
-                TCHAR header[128];
+                char header[128];
                 m_fps = (double)m_numFrames / (double)ms * 1000.;
+                TRACE_COUNTER("fps", (uint64_t)m_fps);
                 m_numFrames = 0;
-                swprintf_s(header, L"DX12SharedResource - %5u fps (%u shared buffer(s)/%s)", 
-                    (DWORD)m_fps, m_pSharedData->numSharedBuffers, 
-                    m_mode == MULTI_THREADED ? L"multi-threaded" : (m_mode == SINGLE_THREADED ? L"single-threaded" : L"cross-process"));
-                SetWindowText(m_pSharedData->hWnd, header);
-                QueryPerformanceCounter(&m_startTime);
+                snprintf(header, sizeof(header), "DX12SharedResource - %5u fps (%s/%u shared buffer(s)/%s)", 
+                    (DWORD)m_fps, RenderBackends[m_renderBackend].name, m_pSharedData->numSharedBuffers, RuntimeModeName[m_mode]);
+                smode::setWindowTitle(m_pSharedData->config.hWnd, header);
+                m_startTime = smode::getTicks();
                 m_elapsed++;
 
+                if (m_resizeCycle) {
+                    // every other second at half size, exercises the resize path without a window
+                    const bool full = m_width != m_windowWidth;
+                    m_resizeWidth = full ? m_windowWidth : m_windowWidth / 2;
+                    m_resizeHeight = full ? m_windowHeight : m_windowHeight / 2;
+                }
+
                 if (m_duration && (m_elapsed >= m_duration)) {
                     terminate = true;
                 }
@@ -412,178 +884,272 @@ void DX12SharedResource::Render()
     }
 
     if (terminate) {
-        SendMessage(m_pSharedData->hWnd, WM_CLOSE, 0, 0);
-    }
-}
-
-LRESULT CALLBACK
-WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
-{
-    switch (uMsg) {
-    case WM_CREATE:
-        {
-            LPCREATESTRUCT pCreateStruct = reinterpret_cast<LPCREATESTRUCT>(lParam);
-            DX12SharedResource* pSharedResource = reinterpret_cast<DX12SharedResource*>(pCreateStruct->lpCreateParams);
-            SetWindowLongPtr(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(pSharedResource));
-            RECT rc;
-            GetClientRect(hWnd, &rc);
-            if (!pSharedResource->Init(hWnd, rc.right - rc.left, rc.bottom - rc.top)) {
-                return FALSE;
-            }
-            return TRUE;
-        }
-    case WM_CLOSE:
-        {
-            DX12SharedResource* pSharedResource = reinterpret_cast<DX12SharedResource*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
-            pSharedResource->Cleanup();
-            DestroyWindow(hWnd);
-            PostQuitMessage(0);
-            return TRUE;
-        }
-    case WM_DESTROY:
-        return TRUE;
-    case WM_ERASEBKGND:
-        break;
-    case WM_PAINT:
-        {
-            DX12SharedResource* pSharedResource = reinterpret_cast<DX12SharedResource*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
-            PAINTSTRUCT ps;
-            BeginPaint(hWnd, &ps);
-            pSharedResource->Render();
-            EndPaint(hWnd, &ps);
-            return TRUE;
-        }
+        smode::closeWindow(m_pSharedData ? m_pSharedData->config.hWnd : nullptr);
     }
-
-    return DefWindowProc(hWnd, uMsg, wParam, lParam);
-}
-
-static void IdleProc(HWND hWnd)
-{
-    DX12SharedResource* pSharedResource = reinterpret_cast<DX12SharedResource*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
-    pSharedResource->Render();
-    ValidateRect(hWnd, NULL);
 }
 
 typedef struct _Config {
     UINT windowWidth = 1024;
     UINT windowHeight = 768;
     RuntimeMode mode = SINGLE_THREADED;
+    UINT renderBackend = 0;
+    UINT pipelineDepth = 0;
     UINT numBuffers = 3;
     UINT duration = 0;
     bool vsync = false;
-  /*  bool validate = false;*/
+    bool headless = false;
+    bool validate = false;
+    UINT validateTolerance = 0;
     bool dedicated = false;
-    //UINT captureFrame = 0;
-    //LPCSTR captureFile = NULL;
+    bool singleHeap = false;
+    bool timelineSemaphores = false;
+    UINT format = SHARED_FORMAT_RGBA8;
+    UINT gpuLatency = 0;
+    UINT refreshRate = 0;
+    bool hashFrames = false;
+    UINT captureFrame = 0;
+    UINT captureCount = 1;
+    LPCSTR captureFile = NULL;
+    LPCSTR recordFile = NULL;
+    UINT recordYuvFormat = 0; // colorconvert::Format
+    bool recordYuvOnGpu = false;
+    LPCSTR statsFile = NULL;
+    LPCSTR traceFile = NULL;
+    LPCSTR pipelineCacheFile = "VkRender.pipelinecache"; // NULL with -pipelinecache none
+    bool resizeCycle = false;
 } Config;
 
-static HWND InitWindow(HINSTANCE hInstance, Config* pConfig, DX12SharedResource* pSharedResource)
+typedef struct _BenchmarkResult {
+    UINT renderBackend;
+    RuntimeMode mode;
+    UINT numBuffers;
+    UINT pipelineDepth;
+    bool vsync;
+    double fps;
+    FrameStatsSummary frameTime;
+    GpuQueueSummary renderQueue;  // empty without GPU timestamps
+    GpuQueueSummary presentQueue;
+    FrameLatencySummary latency;  // producer submission to present
+    FrameRecordStats record;      // zero without -record
+} BenchmarkResult;
+
+static bool EndsWith(const char* str, const char* suffix)
 {
-    DWORD dwExStyle = WS_EX_APPWINDOW | WS_EX_WINDOWEDGE;
-    DWORD dwStyle = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
-
-    RECT windowRect;
-    windowRect.left = 0;
-    windowRect.right = pConfig->windowWidth;
-    windowRect.top = 0;
-    windowRect.bottom = pConfig->windowHeight;
+    const size_t length = strlen(str);
+    const size_t suffixLength = strlen(suffix);
+    return (length >= suffixLength) && (_stricmp(str + length - suffixLength, suffix) == 0);
+}
 
-    AdjustWindowRectEx(&windowRect, dwStyle, FALSE, dwExStyle);
+static void WriteQueueStats(FILE* file, const char* name, const GpuQueueSummary& queue)
+{
+    fprintf(file, "\"%s\": {\"submissions\": %llu, \"queued_p50_ms\": %.4f, \"queued_p99_ms\": %.4f, \"queued_max_ms\": %.4f, "
+        "\"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}",
+        name, (unsigned long long)queue.execution.count, queue.queued.p50, queue.queued.p99, queue.queued.max,
+        queue.execution.p50, queue.execution.p99, queue.execution.max);
+}
 
-    HWND hWnd = CreateWindowEx(dwExStyle,
-                               VK_DX12_SHARED_RESOURCE,
-                               VK_DX12_SHARED_RESOURCE,
-                               dwStyle | WS_CLIPSIBLINGS | WS_CLIPCHILDREN,
-                               CW_USEDEFAULT,
-                               CW_USEDEFAULT,
-                               windowRect.right - windowRect.left,
-                               windowRect.bottom - windowRect.top,
-                               NULL,
-                               NULL,
-                               hInstance,
-                               pSharedResource);
+static void WriteLatencyStats(FILE* file, const FrameLatencySummary& latency)
+{
+    fprintf(file, "\"latency\": {\"frames\": %llu, \"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, "
+        "\"handoff_p50_ms\": %.4f, \"handoff_p99_ms\": %.4f, \"render_p50_ms\": %.4f, \"render_p99_ms\": %.4f, "
+        "\"copy_p50_ms\": %.4f, \"copy_p99_ms\": %.4f, \"present_p50_ms\": %.4f, \"present_p99_ms\": %.4f}",
+        (unsigned long long)latency.total.count, latency.total.p50, latency.total.p99, latency.total.max,
+        latency.handoff.p50, latency.handoff.p99, latency.render.p50, latency.render.p99,
+        latency.copy.p50, latency.copy.p99, latency.present.p50, latency.present.p99);
+}
 
-    if (!hWnd) {
-        return NULL;
+// CSV when the file name ends with .csv, JSON otherwise
+static bool WriteStats(const char* fileName, const std::vector<BenchmarkResult>& results)
+{
+    FILE* file = fopen(fileName, "w");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s.\n", fileName);
+        return false;
     }
 
-    ShowWindow(hWnd, SW_SHOW);
-    SetForegroundWindow(hWnd);
-    SetFocus(hWnd);
+    const bool csv = EndsWith(fileName, ".csv");
+    if (csv) {
+        fprintf(file, "renderer,mode,buffers,pipeline_depth,vsync,fps,frames,mean_ms,min_ms,max_ms,p50_ms,p90_ms,p99_ms,p99_9_ms,dropped,"
+            "gpu_render_queued_p50_ms,gpu_render_queued_p99_ms,gpu_render_p50_ms,gpu_render_p99_ms,"
+            "gpu_present_queued_p50_ms,gpu_present_queued_p99_ms,gpu_present_p50_ms,gpu_present_p99_ms,"
+            "latency_p50_ms,latency_p99_ms,latency_handoff_p50_ms,latency_handoff_p99_ms,latency_render_p50_ms,latency_render_p99_ms,"
+            "latency_copy_p50_ms,latency_copy_p99_ms,latency_present_p50_ms,latency_present_p99_ms,"
+            "recorded,record_dropped,record_mismatched,record_bytes\n");
+    } else {
+        fprintf(file, "[\n");
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        const FrameStatsSummary& frameTime = result.frameTime;
+        if (csv) {
+            fprintf(file, "%s,%s,%u,%u,%d,%.1f,%llu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%llu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,",
+
+                RenderBackends[result.renderBackend].name, RuntimeModeName[result.mode], result.numBuffers, result.pipelineDepth,
+                result.vsync ? 1 : 0, result.fps, (unsigned long long)frameTime.count, frameTime.mean, frameTime.min, frameTime.max,
+                frameTime.p50, frameTime.p90, frameTime.p99, frameTime.p999, (unsigned long long)frameTime.dropped,
+                result.renderQueue.queued.p50, result.renderQueue.queued.p99, result.renderQueue.execution.p50, result.renderQueue.execution.p99,
+                result.presentQueue.queued.p50, result.presentQueue.queued.p99, result.presentQueue.execution.p50, result.presentQueue.execution.p99);
+            const FrameLatencySummary& latency = result.latency;
+            fprintf(file, "%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,",
+                latency.total.p50, latency.total.p99, latency.handoff.p50, latency.handoff.p99, latency.render.p50, latency.render.p99,
+                latency.copy.p50, latency.copy.p99, latency.present.p50, latency.present.p99);
+            fprintf(file, "%llu,%llu,%llu,%llu\n", (unsigned long long)result.record.recorded, (unsigned long long)result.record.dropped,
+                (unsigned long long)result.record.mismatched, (unsigned long long)result.record.bytes);
+        } else {
+            fprintf(file, "  {\"renderer\": \"%s\", \"mode\": \"%s\", \"buffers\": %u, \"pipeline_depth\": %u, \"vsync\": %s, \"fps\": %.1f, "
+                "\"frames\": %llu, \"mean_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f, "
+                "\"p50_ms\": %.4f, \"p90_ms\": %.4f, \"p99_ms\": %.4f, \"p99_9_ms\": %.4f, \"dropped\": %llu, ",
+                RenderBackends[result.renderBackend].name, RuntimeModeName[result.mode], result.numBuffers, result.pipelineDepth,
+                result.vsync ? "true" : "false", result.fps, (unsigned long long)frameTime.count, frameTime.mean, frameTime.min, frameTime.max,
+                frameTime.p50, frameTime.p90, frameTime.p99, frameTime.p999, (unsigned long long)frameTime.dropped);
+            WriteQueueStats(file, "gpu_render", result.renderQueue);
+            fprintf(file, ", ");
+            WriteQueueStats(file, "gpu_present", result.presentQueue);
+            fprintf(file, ", ");
+            WriteLatencyStats(file, result.latency);
+            fprintf(file, ", \"record\": {\"frames\": %llu, \"dropped\": %llu, \"mismatched\": %llu, \"bytes\": %llu}",
+                (unsigned long long)result.record.recorded, (unsigned long long)result.record.dropped,
+                (unsigned long long)result.record.mismatched, (unsigned long long)result.record.bytes);
+            fprintf(file, "}%s\n", (i + 1 < results.size()) ? "," : "");
+        }
+    }
+    if (!csv) {
+        fprintf(file, "]\n");
+    }
 
-    return hWnd;
+    const bool res = !ferror(file);
+    fclose(file);
+    if (!res) {
+        fprintf(stderr, "Cannot write %s.\n", fileName);
+    }
+    return res;
 }
 
-static int render()
+static int render(const char* channelArgument)
 {
-    HANDLE hMapFile = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, VK_DX12_SHARED_RESOURCE);
+    smode::SharedMemory sharedMemory;
+
+    // the whole object, its size depends on the buffer count chosen by the presenter
+    if (!sharedMemory.open(VK_DX12_SHARED_RESOURCE)) {
+        fprintf(stderr, "Client: cannot open the shared memory.\n");
+        return 1;
+    }
+    DX12SharedData* pSharedData = reinterpret_cast<DX12SharedData*>(sharedMemory.getData());
+    if ((sharedMemory.getSize() < sizeof(DX12SharedData)) || !pSharedData->ValidHeader() || (sharedMemory.getSize() < pSharedData->size)) {
+        fprintf(stderr, "Client: shared data layout mismatch, presenter and client binaries differ.\n");
+        return 1;
+    }
 
-    DX12SharedData* pSharedData = reinterpret_cast<DX12SharedData*>(MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(DX12SharedData)));
+    // same order as sent by DX12SharedResource::Init
+    smode::HandleChannel channel;
+    std::vector<smode::NativeHandle> handles(2 + pSharedData->numSharedBuffers + pSharedData->NumSharedMemHandles(), SMODE_INVALID_NATIVE_HANDLE);
+    if (!channel.attach(channelArgument) || !channel.receive(handles.data(), (uint32_t)handles.size())) {
+        fprintf(stderr, "Client: cannot receive handles from the presenter.\n");
+        pSharedData->terminated = true;
+        return 1;
+    }
+    // kept open, the presenter sends the memory handles again on each resize
 
-    DWORD pid;
-    GetWindowThreadProcessId(pSharedData->hWnd, &pid);
-    HANDLE remoteProcess = OpenProcess(PROCESS_ALL_ACCESS, TRUE, pid);
-    HANDLE startEvent = 0;
-    HANDLE doneEvent  = 0;
-    DuplicateHandle(remoteProcess, pSharedData->startEvent, GetCurrentProcess(), &startEvent, 0, TRUE, DUPLICATE_SAME_ACCESS);
-    DuplicateHandle(remoteProcess, pSharedData->doneEvent, GetCurrentProcess(), &doneEvent, 0, TRUE, DUPLICATE_SAME_ACCESS);
+    smode::Event startEvent;
+    smode::Event doneEvent;
+    startEvent.adopt(handles[0]);
+    doneEvent.adopt(handles[1]);
 
     for (UINT i = 0; i < pSharedData->numSharedBuffers; i++) {
-        HANDLE hRemoteSharedMemHandle = pSharedData->sharedMemHandle[i];
-        pSharedData->sharedMemHandle[i] = 0;
-        DuplicateHandle(remoteProcess, hRemoteSharedMemHandle, GetCurrentProcess(), &pSharedData->sharedMemHandle[i], 0, TRUE, DUPLICATE_SAME_ACCESS);
-        assert(pSharedData->sharedMemHandle[i]);
+        pSharedData->Buffer(i).sharedFenceHandle = handles[2 + i];
+    }
+    SetSharedMemHandles(pSharedData, &handles[2 + pSharedData->numSharedBuffers]);
 
-        HANDLE hRemoteSharedFenceHandle = pSharedData->sharedFenceHandle[i];
-        pSharedData->sharedFenceHandle[i] = 0;
-        DuplicateHandle(remoteProcess, hRemoteSharedFenceHandle, GetCurrentProcess(), &pSharedData->sharedFenceHandle[i], 0, TRUE, DUPLICATE_SAME_ACCESS);
-        assert(pSharedData->sharedFenceHandle[i]);
+    const DX12SharedConfig config = pSharedData->ReadConfig();
+    if (config.traceFile[0]) {
+        trace::start(config.traceEpoch, 2, "client");
+        trace::setThreadName("client");
     }
 
-    auto* vkRender = NEW_RENDERER();
+    const UINT renderBackend = config.renderBackend;
+    auto* vkRender = renderBackend < NUM_RENDER_BACKENDS ? RenderBackends[renderBackend].newRender() : nullptr;
 
-    if (vkRender->Init(pSharedData)) {
-        SetEvent(doneEvent);
+    if (vkRender && vkRender->Init(pSharedData)) {
+        UINT64 frameId = 0;
+        UINT bufferGeneration = pSharedData->bufferGeneration.load(std::memory_order_acquire);
+        doneEvent.set();
 
         while (1) {
-            WaitForSingleObject(startEvent, INFINITE);
+            {
+                TRACE_SCOPE("WaitStart");
+                startEvent.wait();
+            }
 
             if (pSharedData->terminate) {
                 break;
             }
 
-            vkRender->Render();
+            // the presenter reallocated the shared buffers since our last frame
+            if (pSharedData->bufferGeneration.load(std::memory_order_acquire) != bufferGeneration) {
+                TRACE_SCOPE("Resize");
+                std::vector<smode::NativeHandle> memHandles(pSharedData->NumSharedMemHandles(), SMODE_INVALID_NATIVE_HANDLE);
+                std::vector<smode::NativeHandle> oldMemHandles;
+                if (channel.receive(memHandles.data(), (uint32_t)memHandles.size())) {
+                    AppendSharedMemHandles(pSharedData, oldMemHandles);
+                    SetSharedMemHandles(pSharedData, memHandles.data());
+                }
+                if (oldMemHandles.empty() || !vkRender->Resize()) {
+                    fprintf(stderr, "Client: cannot import the resized shared buffers.\n");
+                    pSharedData->terminate = true;
+                    doneEvent.set();
+                    break;
+                }
+                for (smode::NativeHandle handle : oldMemHandles) {
+                    smode::closeNativeHandle(handle);
+                }
+                bufferGeneration = pSharedData->bufferGeneration.load(std::memory_order_acquire);
+            }
 
-            SetEvent(doneEvent);
+            {
+                TRACE_SCOPE("Render");
+                const UINT bufferIndex = pSharedData->currentBufferIndex;
+                vkRender->Render();
+                pSharedData->Buffer(bufferIndex).StampFrame(frameId++, smode::getTicks());
+            }
+
+            doneEvent.set();
         }
     } else {
+        if (!vkRender) {
+            fprintf(stderr, "Client: unknown renderer backend %u.\n", renderBackend);
+        }
         pSharedData->terminate = true;
-        SetEvent(doneEvent);
+        doneEvent.set();
     }
 
-    vkRender->Cleanup();
-    delete vkRender;
+    if (vkRender) {
+        vkRender->Cleanup();
+        delete vkRender;
+    }
 
+    std::vector<smode::NativeHandle> memHandles;
+    AppendSharedMemHandles(pSharedData, memHandles);
+    for (smode::NativeHandle handle : memHandles) {
+        smode::closeNativeHandle(handle);
+    }
     for (UINT i = 0; i < pSharedData->numSharedBuffers; i++) {
-        if (pSharedData->sharedMemHandle[i]) {
-            CloseHandle(pSharedData->sharedMemHandle[i]);
-            pSharedData->sharedMemHandle[i] = 0;
-        }
-        if (pSharedData->sharedFenceHandle[i]) {
-            CloseHandle(pSharedData->sharedFenceHandle[i]);
-            pSharedData->sharedFenceHandle[i] = 0;
-        }
+        pSharedData->Buffer(i).sharedMemHandle = SMODE_INVALID_NATIVE_HANDLE;
+        pSharedData->Buffer(i).planarMemHandle = SMODE_INVALID_NATIVE_HANDLE;
+        smode::closeNativeHandle(pSharedData->Buffer(i).sharedFenceHandle);
+        pSharedData->Buffer(i).sharedFenceHandle = SMODE_INVALID_NATIVE_HANDLE;
     }
 
-    if (startEvent) {
-        CloseHandle(startEvent);
-        startEvent = 0;
-    }
+    startEvent.close();
+    doneEvent.close();
+    channel.close();
 
-    if (doneEvent) {
-        CloseHandle(doneEvent);
-        doneEvent = 0;
+    if (trace::isEnabled()) {
+        trace::stop();
+        char fragmentFile[sizeof(config.traceFile) + sizeof(TRACE_CLIENT_SUFFIX)];
+        snprintf(fragmentFile, sizeof(fragmentFile), "%s" TRACE_CLIENT_SUFFIX, config.traceFile);
+        if (!trace::appendTo(fragmentFile)) {
+            fprintf(stderr, "Client: cannot write %s.\n", fragmentFile);
+        }
     }
 
     pSharedData->terminated = true;
@@ -591,65 +1157,686 @@ static int render()
     return 0;
 }
 
-static int test(const char* program, HINSTANCE hInstance, Config* pConfig)
+static void StartTrace(const Config* pConfig)
 {
-    DX12SharedResource* pSharedResource = new DX12SharedResource(hInstance, 
-                                                                     program, 
+    if (!pConfig->traceFile) {
+        return;
+    }
+    std::string fragmentFile = std::string(pConfig->traceFile) + TRACE_CLIENT_SUFFIX;
+    remove(fragmentFile.c_str()); // left over by an earlier run
+    trace::start(smode::getTicks(), 1, "presenter");
+    trace::setThreadName("main");
+}
+
+// client processes appended their events to the fragment file, merged on the presenter timeline
+static bool WriteTrace(const Config* pConfig)
+{
+    if (!pConfig->traceFile) {
+        return true;
+    }
+    trace::stop();
+    std::string fragmentFile = std::string(pConfig->traceFile) + TRACE_CLIENT_SUFFIX;
+    bool res = trace::write(pConfig->traceFile, fragmentFile.c_str());
+    remove(fragmentFile.c_str());
+    return res;
+}
+
+static int test(const char* program, Config* pConfig, std::vector<BenchmarkResult>* pResults)
+{
+    DX12SharedResource* pSharedResource = new DX12SharedResource(program, 
+                                                                     pConfig->renderBackend, 
                                                                      pConfig->numBuffers, 
                                                                      pConfig->duration, 
                                                                      pConfig->mode, 
+                                                                     pConfig->pipelineDepth, 
                                                                      pConfig->vsync, 
-                                                                     //pConfig->validate, 
-                                                                     pConfig->dedicated /*,
+                                                                     pConfig->validate,
+                                                                     pConfig->validateTolerance,
+                                                                     pConfig->dedicated,
+                                                                     pConfig->singleHeap,
+                                                                     pConfig->timelineSemaphores,
+                                                                     pConfig->format,
+                                                                     pConfig->gpuLatency,
+                                                                     pConfig->refreshRate,
+                                                                     pConfig->hashFrames,
                                                                      pConfig->captureFile ? pConfig->captureFrame : 0,
-                                                                     pConfig->captureFile */
+                                                                     pConfig->captureCount,
+                                                                     pConfig->captureFile,
+                                                                     pConfig->recordFile,
+                                                                     pConfig->recordYuvFormat,
+                                                                     pConfig->recordYuvOnGpu,
+                                                                     pConfig->traceFile,
+                                                                     pConfig->pipelineCacheFile,
+                                                                     pConfig->resizeCycle
                                                                     );
     if (!pSharedResource) {
         return 0;
     }
 
-    HWND hWnd = InitWindow(hInstance, pConfig, pSharedResource);
-    if (!hWnd) {
-        return 0;
+    // headless runs without window nor message pump, the presenter draws offscreen
+    const bool run = pConfig->headless ?
+        smode::runHeadless(pConfig->windowWidth, pConfig->windowHeight, pSharedResource) :
+        smode::runWindow(VK_DX12_SHARED_RESOURCE, pConfig->windowWidth, pConfig->windowHeight, pSharedResource);
+    // Init failed, the destructor cleans up what it created
+    if (!run) {
+        delete pSharedResource;
+        return 1;
+    }
+
+    UINT status = pSharedResource->GetStatus();
+
+    const FrameValidationStats validation = pSharedResource->GetValidationStats();
+    if (pConfig->validate && validation.failed) {
+        printf("%-4s / %u shared buffer(s) / %-15s / VSync %-3s : validation failed, %llu of %llu frame(s) differ from their reference, first %llu\n",
+            RenderBackends[pConfig->renderBackend].name,
+            pConfig->numBuffers,
+            RuntimeModeName[pConfig->mode],
+            pConfig->vsync ? "On" : "Off",
+            (unsigned long long)validation.failed,
+            (unsigned long long)(validation.failed + validation.validated),
+            (unsigned long long)validation.firstFailedFrame);
+    } else if (!status) {
+        BenchmarkResult result = { pConfig->renderBackend, pConfig->mode, pConfig->numBuffers, pConfig->pipelineDepth, pConfig->vsync,
+                                   pSharedResource->GetFPS(), pSharedResource->GetFrameStats(),
+                                   pSharedResource->GetRenderQueueStats(), pSharedResource->GetPresentQueueStats(),
+                                   pSharedResource->GetLatencyStats(), pSharedResource->GetRecordStats() };
+        printf("%-4s / %u shared buffer(s) / %-15s / VSync %-3s : %1.0f fps, p99 %.2f ms, %llu dropped", 
+            RenderBackends[pConfig->renderBackend].name,
+            pConfig->numBuffers, 
+            RuntimeModeName[pConfig->mode],
+            pConfig->vsync ? "On" : "Off",
+            result.fps,
+            result.frameTime.p99,
+            (unsigned long long)result.frameTime.dropped);
+        if (result.latency.total.count) {
+            printf(", latency p50 %.2f ms p99 %.2f ms", result.latency.total.p50, result.latency.total.p99);
+        }
+        if (pConfig->validate) {
+            printf(", %llu frame(s) validated", (unsigned long long)validation.validated);
+        }
+        if (pConfig->recordFile) {
+            printf(", %llu frame(s) recorded (%llu dropped, %llu mismatched)", (unsigned long long)result.record.recorded,
+                (unsigned long long)result.record.dropped, (unsigned long long)result.record.mismatched);
+            if (pConfig->recordYuvFormat) {
+                printf(" in %s converted by the %s", colorconvert::getFormatName(pConfig->recordYuvFormat), pConfig->recordYuvOnGpu ? "producer GPU" : "presenter CPU");
+            }
+        }
+        // queued is mostly the wait on the shared fence, execution the work itself
+        if (result.renderQueue.execution.count || result.presentQueue.execution.count) {
+            printf(", GPU p99 render %.2f ms (queued %.2f), present %.2f ms (queued %.2f)",
+                result.renderQueue.execution.p99, result.renderQueue.queued.p99,
+                result.presentQueue.execution.p99, result.presentQueue.queued.p99);
+        }
+        printf("\n");
+        pResults->push_back(result);
+    }
+
+    delete pSharedResource;
+
+    return (int)status;
+}
+
+typedef struct _HandoffBenchmark {
+    smode::Event startEvent;
+    smode::Event doneEvent;
+    FrameQueue* frameQueue = nullptr;
+    UINT iterations = 0;
+} HandoffBenchmark;
+
+static uint32_t EventHandoffThread(void* param)
+{
+    HandoffBenchmark* pBench = reinterpret_cast<HandoffBenchmark*>(param);
+    for (UINT i = 0; i < pBench->iterations; i++) {
+        pBench->startEvent.wait();
+        pBench->doneEvent.set();
+    }
+    return 0;
+}
+
+static uint32_t QueueHandoffThread(void* param)
+{
+    HandoffBenchmark* pBench = reinterpret_cast<HandoffBenchmark*>(param);
+    pBench->frameQueue->Start();
+    FrameSlot slot;
+    while (pBench->frameQueue->Pop(slot)) {
+        pBench->frameQueue->Release();
+    }
+    pBench->frameQueue->WaitDetached();
+    return 0;
+}
+
+// Measures the per-frame cost of the MULTI_THREADED producer/presenter handoff without any GPU work.
+static int benchHandoff(UINT iterations)
+{
+    const int64_t frequency = smode::getTicksPerSecond();
+    int64_t start, stop;
+
+    HandoffBenchmark bench;
+    bench.iterations = iterations;
+
+    // startEvent/doneEvent ping-pong
+    if (!bench.startEvent.create() || !bench.doneEvent.create()) {
+        fprintf(stderr, "Cannot create events.\n");
+        return 1;
+    }
+    smode::Thread thread;
+    if (!thread.start(EventHandoffThread, &bench)) {
+        fprintf(stderr, "Cannot start the handoff thread.\n");
+        return 1;
+    }
+    start = smode::getTicks();
+    for (UINT i = 0; i < iterations; i++) {
+        bench.startEvent.set();
+        bench.doneEvent.wait();
+    }
+    stop = smode::getTicks();
+    thread.join();
+    bench.startEvent.close();
+    bench.doneEvent.close();
+    double eventNs = (double)(stop - start) * 1e9 / (double)frequency / (double)iterations;
+
+    // lock-free frame queue, same lockstep as Render() in MULTI_THREADED mode
+    bench.frameQueue = new FrameQueue(1);
+    if (!thread.start(QueueHandoffThread, &bench)) {
+        fprintf(stderr, "Cannot start the handoff thread.\n");
+        delete bench.frameQueue;
+        return 1;
+    }
+    bench.frameQueue->WaitStarted();
+    start = smode::getTicks();
+    for (UINT i = 0; i < iterations; i++) {
+        FrameSlot slot = { 0, 0, i, 0 };
+        bench.frameQueue->Push(slot);
+        bench.frameQueue->WaitIdle();
+    }
+    stop = smode::getTicks();
+    bench.frameQueue->Close();
+    bench.frameQueue->Detach();
+    thread.join();
+    delete bench.frameQueue;
+    double queueNs = (double)(stop - start) * 1e9 / (double)frequency / (double)iterations;
+
+    printf("Handoff round-trip over %u frames\n", iterations);
+    printf("    start/done events : %8.0f ns/frame\n", eventNs);
+    printf("    frame queue       : %8.0f ns/frame\n", queueNs);
+    return 0;
+}
+
+typedef struct _QueueOrderTest {
+    FrameQueue* frameQueue = nullptr;
+    UINT frames = 0;
+    std::atomic<UINT> released{0}; // counted before each Release, never behind the queue
+} QueueOrderTest;
+
+// consumer of the ordering check, the number of errors
+static uint32_t QueueOrderThread(void* param)
+{
+    QueueOrderTest* pTest = reinterpret_cast<QueueOrderTest*>(param);
+    pTest->frameQueue->Start();
+    uint32_t errors = 0;
+    UINT64 expected = 0;
+    FrameSlot slot;
+    while (pTest->frameQueue->Pop(slot)) {
+        if ((slot.frameId != expected) || (slot.bufferIndex != expected % DX12_MAX_SHARED_BUFFERS) ||
+            (slot.fenceValue != 2 * expected + 1) || (slot.submitTicks != (int64_t)expected)) {
+            if (!errors++) {
+                fprintf(stderr, "depth %u: frame %llu popped as %llu\n", pTest->frameQueue->Depth(), (unsigned long long)expected, (unsigned long long)slot.frameId);
+            }
+        }
+        // a slow frame now and then, the producer fills the queue
+        if (expected % 61 == 0) {
+            smode::sleepUntil(smode::getTicks() + smode::getTicksPerSecond() / 10000);
+        }
+        expected++;
+        pTest->released.fetch_add(1, std::memory_order_release);
+        pTest->frameQueue->Release();
+    }
+    if (expected != pTest->frames) {
+        fprintf(stderr, "depth %u: %llu of %u frames popped\n", pTest->frameQueue->Depth(), (unsigned long long)expected, pTest->frames);
+        errors++;
     }
+    pTest->frameQueue->WaitDetached();
+    return errors;
+}
+
+static bool CheckQueueOrder(UINT depth, UINT frames)
+{
+    FrameQueue frameQueue(depth);
+    QueueOrderTest test;
+    test.frameQueue = &frameQueue;
+    test.frames = frames;
+    smode::Thread thread;
+    if (!thread.start(QueueOrderThread, &test)) {
+        fprintf(stderr, "Cannot start the consumer thread.\n");
+        return false;
+    }
+    bool res = frameQueue.WaitStarted();
+    for (UINT i = 0; res && (i < frames); i++) {
+        FrameSlot slot = { i % DX12_MAX_SHARED_BUFFERS, 2 * (UINT64)i + 1, i, (int64_t)i };
+        res = frameQueue.Push(slot);
+        // never more than depth frames ahead of the releases
+        const UINT released = test.released.load(std::memory_order_acquire);
+        if (i + 1 > released + depth) {
+            fprintf(stderr, "depth %u: %u frames pushed, %u released\n", depth, i + 1, released);
+            res = false;
+        }
+    }
+    res = frameQueue.WaitIdle() && res;
+    frameQueue.Close();
+    frameQueue.Detach();
+    return (thread.join() == 0) && res;
+}
+
+typedef struct _QueueBlockedCall {
+    FrameQueue* frameQueue = nullptr;
+    bool (*call)(FrameQueue*) = nullptr;
+    bool result = false;
+    std::atomic<bool> returned{false};
+} QueueBlockedCall;
+
+static uint32_t QueueBlockedCallThread(void* param)
+{
+    QueueBlockedCall* pCall = reinterpret_cast<QueueBlockedCall*>(param);
+    pCall->result = pCall->call(pCall->frameQueue);
+    pCall->returned.store(true, std::memory_order_release);
+    return 0;
+}
 
-    bool running = true;
-    MSG msg;
-    while (running)
+// call blocks past its spin and yield phases until trigger, then returns expected within a second
+static bool CheckQueueWakeUp(const char* name, FrameQueue& frameQueue, bool (*call)(FrameQueue*), void (*trigger)(FrameQueue*), bool expected)
+{
+    const int64_t frequency = smode::getTicksPerSecond();
+    QueueBlockedCall blocked;
+    blocked.frameQueue = &frameQueue;
+    blocked.call = call;
+    smode::Thread thread;
+    if (!thread.start(QueueBlockedCallThread, &blocked)) {
+        fprintf(stderr, "Cannot start the %s thread.\n", name);
+        return false;
+    }
+    smode::sleepUntil(smode::getTicks() + frequency / 20);
+    if (blocked.returned.load(std::memory_order_acquire)) {
+        thread.join();
+        fprintf(stderr, "%s returned without waiting\n", name);
+        return false;
+    }
+    trigger(&frameQueue);
+    const int64_t deadline = smode::getTicks() + frequency;
+    while (!blocked.returned.load(std::memory_order_acquire)) {
+        if (smode::getTicks() > deadline) {
+            // the thread stays parked in the queue, it cannot be joined
+            fprintf(stderr, "%s is not woken up\n", name);
+            exit(1);
+        }
+        smode::sleepUntil(smode::getTicks() + frequency / 1000);
+    }
+    thread.join();
+    if (blocked.result != expected) {
+        fprintf(stderr, "%s returned %s\n", name, blocked.result ? "true" : "false");
+        return false;
+    }
+    return true;
+}
+
+static void PushFrameSlot(FrameQueue* pFrameQueue)
+{
+    FrameSlot slot = { 1, 2, 42, 0 };
+    pFrameQueue->Push(slot);
+}
+
+static void ReleaseFrameSlot(FrameQueue* pFrameQueue)
+{
+    FrameSlot slot;
+    pFrameQueue->TryPop(slot);
+    pFrameQueue->Release();
+}
+
+// FrameQueue self-check: frames arrive whole and in order at every depth, the producer never runs more than
+// depth frames ahead, and every wait parks and is woken by the matching call or by each state transition
+static int testQueue(UINT frames)
+{
+    bool res = true;
+    static const UINT depths[] = { 1, 2, 3, DX12_MAX_SHARED_BUFFERS };
+    for (UINT depth : depths) {
+        res = CheckQueueOrder(depth, frames) && res;
+    }
+
+    auto waitStarted = [](FrameQueue* q) { return q->WaitStarted(); };
+    auto push = [](FrameQueue* q) { FrameSlot slot = { 0, 0, 0, 0 }; return q->Push(slot); };
+    auto pop = [](FrameQueue* q) { FrameSlot slot; return q->Pop(slot) && (slot.frameId == 42) && (slot.fenceValue == 2); };
+    auto waitIdle = [](FrameQueue* q) { return q->WaitIdle(); };
+    auto waitPublished = [](FrameQueue* q) { UINT64 published = 0; return q->WaitPublished(published) && (published == 8); };
+    auto waitNewerPublished = [](FrameQueue* q) { UINT64 published = 8; return q->WaitPublished(published); };
+    auto waitDetached = [](FrameQueue* q) { return q->WaitDetached(); };
+    auto start = [](FrameQueue* q) { q->Start(); };
+    auto close = [](FrameQueue* q) { q->Close(); };
+    auto detach = [](FrameQueue* q) { q->Detach(); };
+    auto publish = [](FrameQueue* q) { q->Publish(7); };
+
+    // STARTING to RUNNING and to CLOSED
     {
-        if (PeekMessage(&msg, 0, 0, 0, PM_NOREMOVE)) {
-            if (GetMessage(&msg, 0, 0, 0)) {
-                TranslateMessage(&msg);
-                DispatchMessage(&msg);
+        FrameQueue frameQueue(1);
+        res = CheckQueueWakeUp("WaitStarted on Start", frameQueue, waitStarted, start, true) && res;
+    }
+    {
+        FrameQueue frameQueue(1);
+        res = CheckQueueWakeUp("WaitStarted on Close", frameQueue, waitStarted, close, false) && res;
+    }
+
+    // full queue: the push past depth waits for a release, then for Close
+    {
+        FrameQueue frameQueue(3);
+        frameQueue.Start();
+        for (UINT i = 0; i < 3; i++) {
+            push(&frameQueue);
+        }
+        if (!frameQueue.Full()) {
+            fprintf(stderr, "depth 3: not full after 3 frames\n");
+            res = false;
+        }
+        res = CheckQueueWakeUp("Push on Release", frameQueue, push, ReleaseFrameSlot, true) && res;
+        res = CheckQueueWakeUp("Push on Close", frameQueue, push, close, false) && res;
+    }
+    {
+        FrameQueue frameQueue(2);
+        frameQueue.Start();
+        push(&frameQueue);
+        res = CheckQueueWakeUp("WaitIdle on Release", frameQueue, waitIdle, ReleaseFrameSlot, true) && res;
+        push(&frameQueue);
+        res = CheckQueueWakeUp("WaitIdle on Close", frameQueue, waitIdle, close, false) && res;
+    }
+
+    // empty queue: the consumer waits for a push, then for Close, then for Detach
+    {
+        FrameQueue frameQueue(1);
+        frameQueue.Start();
+        res = CheckQueueWakeUp("Pop on Push", frameQueue, pop, PushFrameSlot, true) && res;
+        frameQueue.Release();
+        res = CheckQueueWakeUp("Pop on Close", frameQueue, pop, close, false) && res;
+        res = CheckQueueWakeUp("WaitDetached on Detach", frameQueue, waitDetached, detach, true) && res;
+    }
+    {
+        FrameQueue frameQueue(1);
+        frameQueue.Start();
+        res = CheckQueueWakeUp("WaitPublished on Publish", frameQueue, waitPublished, publish, true) && res;
+        res = CheckQueueWakeUp("WaitPublished on Close", frameQueue, waitNewerPublished, close, false) && res;
+    }
+
+    printf("FrameQueue over %u frames at depth 1, 2, 3 and %u, wake-ups on every transition: %s\n", frames, DX12_MAX_SHARED_BUFFERS, res ? "ok" : "FAILED");
+    return res ? 0 : 1;
+}
+
+// the SIMD kernels of the validation first match the scalar ones on odd sizes, then run on a 1080p frame
+static int benchValidate(UINT iterations)
+{
+    const UINT width = 1920;
+    const UINT height = 1080;
+    const UINT rowSize = width * 4;
+    const UINT rowPitch = rowSize + 256; // padded like a readback footprint
+    std::vector<uint8_t> reference((size_t)rowPitch * height);
+    uint32_t seed = 0x12345678;
+    for (uint8_t& byte : reference) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        byte = (uint8_t)seed;
+    }
+    std::vector<uint8_t> frame = reference;
+    for (size_t i = 0; i < frame.size(); i += 4099) {
+        frame[i] = (uint8_t)(frame[i] + i % 7);
+    }
+
+    bool res = true;
+    static const UINT rowSizes[] = { 1, 15, 33, 127, 129, rowSize - 3, rowSize };
+    for (UINT isa = framecompare::ISA_SCALAR + 1; isa < framecompare::NUM_ISAS; isa++) {
+        if (!framecompare::isSupported(isa)) {
+            continue;
+        }
+        for (UINT size : rowSizes) {
+            for (UINT rows = 1; rows <= height; rows += height - 1) {
+                const uint64_t expectedHash = framecompare::hash(frame.data(), size, rows, rowPitch, framecompare::ISA_SCALAR);
+                if (framecompare::hash(frame.data(), size, rows, rowPitch, isa) != expectedHash) {
+                    fprintf(stderr, "%s hash differs from scalar, %u bytes x %u rows\n", framecompare::getIsaName(isa), size, rows);
+                    res = false;
+                }
+                for (UINT tolerance = 0; tolerance <= 4; tolerance += 4) {
+                    const framecompare::Difference expected = framecompare::compare(frame.data(), rowPitch, reference.data(), rowPitch, size, rows, tolerance, framecompare::ISA_SCALAR);
+                    const framecompare::Difference difference = framecompare::compare(frame.data(), rowPitch, reference.data(), rowPitch, size, rows, tolerance, isa);
+                    if ((difference.differentBytes != expected.differentBytes) || (difference.maxDifference != expected.maxDifference)) {
+                        fprintf(stderr, "%s compare differs from scalar, %u bytes x %u rows, tolerance %u\n", framecompare::getIsaName(isa), size, rows, tolerance);
+                        res = false;
+                    }
+                }
             }
-            else {
-                running = false;
+        }
+    }
+
+    const double frequency = (double)smode::getTicksPerSecond();
+    const double bytes = (double)rowSize * height * iterations;
+    printf("Validation kernels over %u %ux%u rgba8 frames, best %s\n", iterations, width, height, framecompare::getIsaName(framecompare::getBestIsa()));
+    // the results feed the output so the timed work stays, and every ISA has to land on the scalar ones
+    uint64_t scalarHashes = 0;
+    uint64_t scalarDifferentBytes = 0;
+    for (UINT isa = 0; isa < framecompare::NUM_ISAS; isa++) {
+        if (!framecompare::isSupported(isa)) {
+            continue;
+        }
+        uint64_t hashes = 0;
+        int64_t start = smode::getTicks();
+        for (UINT i = 0; i < iterations; i++) {
+            hashes = hashes * 31 + framecompare::hash(frame.data(), rowSize, height, rowPitch, isa);
+        }
+        const double hashSeconds = (double)(smode::getTicks() - start) / frequency;
+        uint64_t differentBytes = 0;
+        start = smode::getTicks();
+        for (UINT i = 0; i < iterations; i++) {
+            differentBytes += framecompare::compare(frame.data(), rowPitch, reference.data(), rowPitch, rowSize, height, 2, isa).differentBytes;
+        }
+        const double compareSeconds = (double)(smode::getTicks() - start) / frequency;
+        printf("    %-7s hash %6.2f GB/s (%016llx), compare %6.2f GB/s (%llu bytes differ)\n", framecompare::getIsaName(isa),
+            bytes / hashSeconds * 1e-9, (unsigned long long)hashes, 2.0 * bytes / compareSeconds * 1e-9, (unsigned long long)differentBytes);
+        if (isa == framecompare::ISA_SCALAR) {
+            scalarHashes = hashes;
+            scalarDifferentBytes = differentBytes;
+        } else if ((hashes != scalarHashes) || (differentBytes != scalarDifferentBytes)) {
+            fprintf(stderr, "%s 1080p results differ from scalar\n", framecompare::getIsaName(isa));
+            res = false;
+        }
+    }
+    return res ? 0 : 1;
+}
+
+// the SIMD conversion kernels first match the scalar ones on odd sizes, then convert 1080p frames
+static int benchConvert(UINT iterations)
+{
+    const UINT width = 1920;
+    const UINT height = 1080;
+    const UINT rowPitch = width * 4 + 256; // padded like a readback footprint
+    std::vector<uint8_t> frame((size_t)rowPitch * height);
+    uint32_t seed = 0x9e3779b9;
+    for (uint8_t& byte : frame) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        byte = (uint8_t)seed;
+    }
+    std::vector<uint8_t> expected(colorconvert::getSize(width, height, colorconvert::FORMAT_P010));
+    std::vector<uint8_t> converted(expected.size());
+
+    bool res = true;
+    static const UINT widths[] = { 1, 2, 15, 17, 33, width - 3, width };
+    static const UINT heights[] = { 1, 2, 3, 31, height - 1 };
+    for (UINT isa = framecompare::ISA_SCALAR + 1; isa < framecompare::NUM_ISAS; isa++) {
+        if (!framecompare::isSupported(isa)) {
+            continue;
+        }
+        for (UINT format = colorconvert::FORMAT_NV12; format < colorconvert::NUM_FORMATS; format++) {
+            for (UINT bgra = 0; bgra < 2; bgra++) {
+                for (UINT w : widths) {
+                    for (UINT h : heights) {
+                        const size_t size = colorconvert::getSize(w, h, format);
+                        memset(expected.data(), 0, size);
+                        memset(converted.data(), 0, size);
+                        colorconvert::convert(frame.data(), rowPitch, bgra != 0, w, h, format, expected.data(), framecompare::ISA_SCALAR);
+                        colorconvert::convert(frame.data(), rowPitch, bgra != 0, w, h, format, converted.data(), isa);
+                        if (memcmp(expected.data(), converted.data(), size)) {
+                            fprintf(stderr, "%s %s conversion differs from scalar, %ux%u %s\n", framecompare::getIsaName(isa),
+                                colorconvert::getFormatName(format), w, h, bgra ? "bgra8" : "rgba8");
+                            res = false;
+                        }
+                    }
+                }
             }
         }
-        else {
-            IdleProc(hWnd);
+    }
+
+    const double frequency = (double)smode::getTicksPerSecond();
+    const double bytes = (double)width * 4 * height * iterations;
+    printf("Conversion kernels over %u %ux%u rgba8 frames, best %s\n", iterations, width, height, framecompare::getIsaName(framecompare::getBestIsa()));
+    for (UINT isa = 0; isa < framecompare::NUM_ISAS; isa++) {
+        if (!framecompare::isSupported(isa)) {
+            continue;
+        }
+        printf("    %-7s", framecompare::getIsaName(isa));
+        for (UINT format = colorconvert::FORMAT_NV12; format < colorconvert::NUM_FORMATS; format++) {
+            const int64_t start = smode::getTicks();
+            for (UINT i = 0; i < iterations; i++) {
+                colorconvert::convert(frame.data(), rowPitch, false, width, height, format, converted.data(), isa);
+            }
+            const double seconds = (double)(smode::getTicks() - start) / frequency;
+            printf(" %s %6.2f GB/s (%.2f ms)", colorconvert::getFormatName(format), bytes / seconds * 1e-9, seconds * 1e3 / iterations);
         }
+        printf("\n");
     }
+    return res ? 0 : 1;
+}
 
-    UINT status = pSharedResource->GetStatus();
+// GPU clock running at frequency * (1 + drift) from gpuOrigin at cpuOrigin, sampled at the scripted CPU time now
+class ScriptedGpuClock : public GpuClock
+{
+public:
+    uint64_t frequency = 0; // nominal, what GpuTimeline scales by
+    double drift = 0.0;
+    uint64_t gpuOrigin = 0;
+    int64_t cpuOrigin = 0;
+    int64_t now = 0;
+    UINT calibrations = 0;
+
+    uint64_t getTimestampFrequency() override { return frequency; }
+    bool getCalibration(uint64_t& gpuTimestamp, int64_t& cpuTicks) override
+    {
+        cpuTicks = now;
+        gpuTimestamp = GpuTimestamp(now);
+        calibrations++;
+        return true;
+    }
+    uint64_t GpuTimestamp(int64_t cpuTicks) const
+    {
+        const double seconds = (double)(cpuTicks - cpuOrigin) / (double)smode::getTicksPerSecond();
+        return gpuOrigin + (uint64_t)(int64_t)(seconds * (double)frequency * (1.0 + drift));
+    }
+};
 
-  /*  if (pConfig->validate) {
-        printf("%u shared buffer(s) / %s / VSync %-3s : %s\n", 
-            pConfig->numBuffers, 
-            pConfig->mode   == MULTI_THREADED ? "multi-threaded " : (pConfig->mode == SINGLE_THREADED ? "single-threaded" : "cross-process  "),
-            pConfig->vsync ? "On" : "Off",
-            status ? "Failed" : "Passed");
-    } else */ if (!status) {
-        printf("%u shared buffer(s) / %s / VSync %-3s : %1.0f fps\n", 
-            pConfig->numBuffers, 
-            pConfig->mode   == MULTI_THREADED ? "multi-threaded " : (pConfig->mode == SINGLE_THREADED ? "single-threaded" : "cross-process  "),
-            pConfig->vsync ? "On" : "Off",
-            pSharedResource->GetFPS());
+static bool CheckDuration(const char* clockName, const char* name, double milliseconds, double expected, double tolerance)
+{
+    if (fabs(milliseconds - expected) <= tolerance) {
+        return true;
     }
+    fprintf(stderr, "%s: %s %.4f ms, expected %.4f ms\n", clockName, name, milliseconds, expected);
+    return false;
+}
 
-    delete pSharedResource;
+// GpuTimeline against scripted clocks: offset, frequency and drift, timestamps before the calibration,
+// the recalibration every second and the queue histograms over <frames> frames of 1 ms, then its cost
+static int benchTimeline(UINT frames)
+{
+    struct Script {
+        const char* name;
+        uint64_t frequency;
+        double drift;      // 20 ppm, a typical crystal
+        uint64_t gpuOrigin;
+    };
+    static const Script scripts[] = {
+        { "19.2 MHz +20 ppm", 19200000, 2e-5, 0x0000123456789abcull },
+        { "1 GHz -20 ppm", 1000000000, -2e-5, 0x7000000000000000ull },
+        { "cpu rate", 0, 0.0, 0 },
+    };
+    const int64_t cpuFrequency = smode::getTicksPerSecond();
+    const int64_t millisecond = cpuFrequency / 1000;
+    frames = frames < 3000 ? 3000 : frames;
+
+    bool res = true;
+    double reportNs = 0.0;
+    for (const Script& script : scripts) {
+        ScriptedGpuClock clock;
+        clock.frequency = script.frequency ? script.frequency : (uint64_t)cpuFrequency;
+        clock.drift = script.drift;
+        clock.gpuOrigin = script.gpuOrigin;
+        clock.cpuOrigin = cpuFrequency * 1000; // CPU and GPU counters far apart
+        clock.now = clock.cpuOrigin;
+
+        GpuQueueStats stats;
+        GpuTimeline timeline;
+        if (!timeline.init(&clock, &stats, NULL)) {
+            fprintf(stderr, "%s: init failed\n", script.name);
+            res = false;
+            continue;
+        }
 
-    return (int)status;
+        // a second of drift at most, plus a GPU tick of rounding
+        const double driftTicks = fabs(script.drift) * (double)cpuFrequency + (double)cpuFrequency / (double)clock.frequency + 2.0;
+        const int64_t before = clock.now - cpuFrequency / 2;
+        if (fabs((double)(timeline.toCpuTicks(clock.GpuTimestamp(before)) - before)) > driftTicks) {
+            fprintf(stderr, "%s: timestamp before the calibration off by %lld ticks\n", script.name,
+                (long long)(timeline.toCpuTicks(clock.GpuTimestamp(before)) - before));
+            res = false;
+        }
+
+        // queued alternates 0.1 and 0.4 ms, execution 1 and 3 ms, one frame submitted per ms
+        int64_t worstError = 0;
+        const int64_t start = smode::getTicks();
+        for (UINT i = 0; i < frames; i++) {
+            const int64_t submit = clock.now;
+            const int64_t begin = submit + (i & 1 ? 4 : 1) * millisecond / 10;
+            const int64_t end = begin + (i & 1 ? 3 : 1) * millisecond;
+            const int64_t error = timeline.toCpuTicks(clock.GpuTimestamp(begin)) - begin;
+            if ((error > worstError) || (-error > worstError)) {
+                worstError = error < 0 ? -error : error;
+            }
+            timeline.report(i, submit, clock.GpuTimestamp(begin), clock.GpuTimestamp(end));
+            clock.now += millisecond;
+        }
+        reportNs += (double)(smode::getTicks() - start) * 1e9 / (double)cpuFrequency / (double)frames;
+
+        if ((double)worstError > driftTicks) {
+            fprintf(stderr, "%s: converted timestamps off by %lld ticks, recalibration missing\n", script.name, (long long)worstError);
+            res = false;
+        }
+        const UINT seconds = frames / 1000;
+        if ((clock.calibrations < seconds) || (clock.calibrations > seconds + 1)) {
+            fprintf(stderr, "%s: %u calibrations over %u s\n", script.name, clock.calibrations, seconds);
+            res = false;
+        }
+
+        // min and max are exact, percentiles within a 1/32 bucket
+        const GpuQueueSummary summary = GpuTimeline::summarize(stats);
+        const double toleranceMs = driftTicks * 1e3 / (double)cpuFrequency;
+        if ((summary.queued.count != frames) || (summary.execution.count != frames)) {
+            fprintf(stderr, "%s: %llu queued and %llu executions for %u frames\n", script.name,
+                (unsigned long long)summary.queued.count, (unsigned long long)summary.execution.count, frames);
+            res = false;
+        }
+        res = CheckDuration(script.name, "queued min", summary.queued.min, 0.1, 2.0 * toleranceMs) && res;
+        res = CheckDuration(script.name, "queued max", summary.queued.max, 0.4, 2.0 * toleranceMs) && res;
+        res = CheckDuration(script.name, "queued p90", summary.queued.p90, 0.4, 0.4 / 32.0 + 2.0 * toleranceMs) && res;
+        res = CheckDuration(script.name, "execution min", summary.execution.min, 1.0, 2.0 * toleranceMs) && res;
+        res = CheckDuration(script.name, "execution max", summary.execution.max, 3.0, 2.0 * toleranceMs) && res;
+        res = CheckDuration(script.name, "execution mean", summary.execution.mean, 2.0, 2.0 * toleranceMs) && res;
+        res = CheckDuration(script.name, "execution p90", summary.execution.p90, 3.0, 3.0 / 32.0 + 2.0 * toleranceMs) && res;
+        printf("    %-17s worst error %6.2f us, %u calibrations\n", script.name, (double)worstError * 1e6 / (double)cpuFrequency, clock.calibrations);
+    }
+    printf("GpuTimeline over %u scripted frames: %.0f ns/frame, %s\n", frames, reportNs / (sizeof(scripts) / sizeof(scripts[0])), res ? "ok" : "FAILED");
+    return res ? 0 : 1;
 }
 
 static void usage()
@@ -657,15 +1844,44 @@ static void usage()
     fprintf(stdout, "\nDX12SharedResource [options]\n");
     fprintf(stdout, "\n");
     fprintf(stdout, "Options:\n");
+    fprintf(stdout, "    -renderer <name>   Renderer backend:");
+    for (UINT i = 0; i < NUM_RENDER_BACKENDS; i++) {
+        fprintf(stdout, " %s%s", RenderBackends[i].name, i ? "" : " (default)");
+    }
+    fprintf(stdout, "\n");
+    fprintf(stdout, "    -format <name>     Shared buffer format, falls back to rgba8 when the presenter lacks it:");
+    for (UINT i = 0; i < NUM_SHARED_FORMATS; i++) {
+        fprintf(stdout, " %s", SharedFormatName(i));
+    }
+    fprintf(stdout, "\n");
     fprintf(stdout, "    -mt                Run multi-threaded\n");
     fprintf(stdout, "    -p                 Run cross-process\n");
-    //fprintf(stdout, "    -validate          Validate results\n");
+    fprintf(stdout, "    -pipeline <k>      Run pipelined, producer up to <k> frames ahead (<k> < shared buffers)\n");
+    fprintf(stdout, "    -mailbox           Run multi-threaded, presenter always takes the newest frame\n");
+    fprintf(stdout, "    -validate [tol]    Check every presented frame against the first one of its phase, per channel tolerance <tol> (default 0)\n");
     fprintf(stdout, "    -vsync             Present after vertical blank\n");
     fprintf(stdout, "    -dedicated         Use dedicated memory (if supported)\n");
-    fprintf(stdout, "    -n <n>             Use <n> shared buffers (2 <= <n> <= 4)\n");
+    fprintf(stdout, "    -singleheap        Place every shared buffer in one shared heap, one handle for all\n");
+    fprintf(stdout, "    -timeline          Import the shared fences as Vulkan timeline semaphores, CPU waits on them instead of a VkFence\n");
+    fprintf(stdout, "    -pipelinecache <fn> Vulkan pipeline cache file, kept across runs (default VkRender.pipelinecache, none to disable)\n");
+    fprintf(stdout, "    -resizecycle       Resize the shared buffers every second, alternating the window size and half of it\n");
+    fprintf(stdout, "    -headless          Run without window nor message pump, present offscreen (no vsync pacing on DX12)\n");
+    fprintf(stdout, "    -n <n>             Use <n> shared buffers (2 <= <n> <= 16)\n");
     fprintf(stdout, "    -d <n>             Duration in seconds\n");
-    // fprintf(stdout, "    -capture <n> <fn>  Capture frame <n> to BMP file <fn>\n");
-    fprintf(stdout, "    -fulltest          Run full QA test\n");
+    fprintf(stdout, "    -gpulatency <us>   Simulated GPU latency of the CPU renderer in microseconds\n");
+    fprintf(stdout, "    -refresh <hz>      Virtual refresh rate of the software presenter with -vsync (default 60)\n");
+    fprintf(stdout, "    -hash              Print a hash of every frame shown by the software presenter\n");
+    fprintf(stdout, "    -capture <r> <fn>  Capture frames <r> to <fn> (.bmp, .png, raw otherwise): <n>, <first>-<last> or <first>-\n");
+    fprintf(stdout, "    -record <fn>       Record every presented frame to <fn>, Y4M 4:4:4 if it ends with .y4m, raw otherwise\n");
+    fprintf(stdout, "    -yuv <f> [cpu|gpu] Record in <f> 4:2:0 (nv12, p010), converted by the presenter CPU (default) or the producer GPU\n");
+    fprintf(stdout, "    -stats <fn>        Write frame time percentiles of every run to <fn>, CSV if it ends with .csv, JSON otherwise\n");
+    fprintf(stdout, "    -trace <fn>        Write a Chrome trace (chrome://tracing, ui.perfetto.dev) of the last frames to <fn>\n");
+    fprintf(stdout, "    -fulltest          Run full QA test, on every renderer unless -renderer is given\n");
+    fprintf(stdout, "    -benchhandoff [n]  Measure producer/presenter handoff latency over <n> frames\n");
+    fprintf(stdout, "    -testqueue [n]     Check frame order, back-pressure and wake-ups of the frame queue over <n> frames\n");
+    fprintf(stdout, "    -benchvalidate [n] Check the SIMD validation kernels against scalar and measure them over <n> frames\n");
+    fprintf(stdout, "    -benchconvert [n]  Check the SIMD NV12 and P010 conversion kernels against scalar and measure them over <n> frames\n");
+    fprintf(stdout, "    -benchtimeline [n] Check GpuTimeline against scripted GPU clocks over <n> frames and measure it\n");
     fprintf(stdout, "    -h                 Show this help\n");
     exit(0);
 }
@@ -674,8 +1890,8 @@ int main(int argc, char* argv[])
 {
     Config cfg;
 
-    if ((argc == 2) && (_stricmp(argv[1], VK_DX12_SHARED_RESOURCE_CLIENT_ARG) == 0)) {
-        return render();
+    if ((argc == 3) && (_stricmp(argv[1], VK_DX12_SHARED_RESOURCE_CLIENT_ARG) == 0)) {
+        return render(argv[2]);
     }
 
     printf("DX12SharedResource \n\n");
@@ -688,35 +1904,37 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    WNDCLASSEX wndClass;
-    HINSTANCE hInstance = GetModuleHandle(NULL);
-        
-    wndClass.cbSize = sizeof(WNDCLASSEX);
-    wndClass.style = CS_HREDRAW | CS_VREDRAW;
-    wndClass.lpfnWndProc = WindowProc;
-    wndClass.cbClsExtra = 0;
-    wndClass.cbWndExtra = 0;
-    wndClass.hInstance = hInstance;
-    wndClass.hIcon = LoadIcon(NULL, IDI_APPLICATION);
-    wndClass.hCursor = LoadCursor(NULL, IDC_ARROW);
-    wndClass.hbrBackground = (HBRUSH)GetStockObject(BLACK_BRUSH);
-    wndClass.lpszMenuName = NULL;
-    wndClass.lpszClassName = VK_DX12_SHARED_RESOURCE;
-    wndClass.hIconSm = LoadIcon(NULL, IDI_WINLOGO);
-
-    if (!RegisterClassEx(&wndClass)) {
-        return 1;
+    if ((argc >= 2) && (_stricmp(argv[1], "-benchhandoff") == 0)) {
+        return benchHandoff(argc > 2 ? atoi(argv[2]) : 100000);
+    }
+
+    if ((argc >= 2) && (_stricmp(argv[1], "-testqueue") == 0)) {
+        return testQueue(argc > 2 ? atoi(argv[2]) : 100000);
+    }
+
+    if ((argc >= 2) && (_stricmp(argv[1], "-benchvalidate") == 0)) {
+        return benchValidate(argc > 2 ? atoi(argv[2]) : 200);
+    }
+
+    if ((argc >= 2) && (_stricmp(argv[1], "-benchconvert") == 0)) {
+        return benchConvert(argc > 2 ? atoi(argv[2]) : 100);
+    }
+
+    if ((argc >= 2) && (_stricmp(argv[1], "-benchtimeline") == 0)) {
+        return benchTimeline(argc > 2 ? atoi(argv[2]) : 10000);
     }
 
+    std::vector<BenchmarkResult> results;
     bool fulltest = false;
     for (int i = 1; i < argc; i++) {
-        if (_stricmp(argv[1], "-fulltest") == 0) {
+        if (_stricmp(argv[i], "-fulltest") == 0) {
             fulltest = true;
             break;
         }
     }
 
     if (fulltest) {
+        int onlyRenderBackend = -1; // every backend
         cfg.duration = 5;
 
         for (int i = 1; i < argc; i++) {
@@ -727,15 +1945,68 @@ int main(int argc, char* argv[])
                 cfg.dedicated = true;
                 continue;
             }
+            if (_stricmp(argv[i], "-singleheap") == 0) {
+                cfg.singleHeap = true;
+                continue;
+            }
+            if (_stricmp(argv[i], "-timeline") == 0) {
+                cfg.timelineSemaphores = true;
+                continue;
+            }
+            if (_stricmp(argv[i], "-headless") == 0) {
+                cfg.headless = true;
+                continue;
+            }
+            if (_stricmp(argv[i], "-resizecycle") == 0) {
+                cfg.resizeCycle = true;
+                continue;
+            }
             if ((_stricmp(argv[i], "-d") == 0) && (i < argc - 1)) {
                 cfg.duration = atoi(argv[++i]);
                 continue;
             }
+            if ((_stricmp(argv[i], "-gpulatency") == 0) && (i < argc - 1)) {
+                cfg.gpuLatency = atoi(argv[++i]);
+                continue;
+            }
+            if ((_stricmp(argv[i], "-stats") == 0) && (i < argc - 1)) {
+                cfg.statsFile = argv[++i];
+                continue;
+            }
+            if ((_stricmp(argv[i], "-trace") == 0) && (i < argc - 1)) {
+                cfg.traceFile = argv[++i];
+                continue;
+            }
+            if ((_stricmp(argv[i], "-pipelinecache") == 0) && (i < argc - 1)) {
+                cfg.pipelineCacheFile = _stricmp(argv[++i], "none") ? argv[i] : NULL;
+                continue;
+            }
+            if ((_stricmp(argv[i], "-renderer") == 0) && (i < argc - 1)) {
+                const int renderBackend = FindRenderBackend(argv[++i]);
+                if (renderBackend < 0) {
+                    fprintf(stderr, "\nUnknown renderer: %s\n", argv[i]);
+                    fprintf(stderr, "\nFor help: DX12SharedResource -h\n");
+                    exit(1);
+                }
+                onlyRenderBackend = renderBackend;
+                continue;
+            }
+            if ((_stricmp(argv[i], "-format") == 0) && (i < argc - 1)) {
+                const int format = FindSharedFormat(argv[++i]);
+                if (format < 0) {
+                    fprintf(stderr, "\nUnknown format: %s\n", argv[i]);
+                    fprintf(stderr, "\nFor help: DX12SharedResource -h\n");
+                    exit(1);
+                }
+                cfg.format = format;
+                continue;
+            }
             fprintf(stderr, "\nInvalid option: %s\n", argv[i]);
             fprintf(stderr, "\nFor help: DX12SharedResource -h\n");
             exit(1);
         }
-        for (int i = 0; i < 3; i++) {
+        StartTrace(&cfg);
+        for (int i = 0; i < 5; i++) {
             switch (i) {
             case 0:
                 cfg.mode = SINGLE_THREADED;
@@ -743,27 +2014,70 @@ int main(int argc, char* argv[])
             case 1:
                 cfg.mode = MULTI_THREADED;
                 break;
-            default:
+            case 2:
                 cfg.mode = CROSS_PROCESS;
                 break;
+            case 3:
+                cfg.mode = PIPELINED;
+                break;
+            default:
+                cfg.mode = MAILBOX;
+                break;
             }
-            for (cfg.numBuffers = MIN_SHARED_BUFFERS; cfg.numBuffers <= MAX_SHARED_BUFFERS; cfg.numBuffers++) {
+            for (cfg.numBuffers = DX12_MIN_SHARED_BUFFERS; cfg.numBuffers <= FULLTEST_MAX_SHARED_BUFFERS; cfg.numBuffers++) {
+                cfg.pipelineDepth = cfg.numBuffers - 1;
                 for (int vsync = 0; vsync < 2; vsync++) {
                     cfg.vsync = vsync != 0;
                     for (int validate = 0; validate < 2; validate++) {
-                        //cfg.validate = validate != 0;
-                        int status = test(argv[0], hInstance, &cfg);
-                        if (status) {
-                            return status;
+                        cfg.validate = validate != 0;
+                        // backends side by side for each configuration
+                        for (cfg.renderBackend = 0; cfg.renderBackend < NUM_RENDER_BACKENDS; cfg.renderBackend++) {
+                            if ((onlyRenderBackend >= 0) && (cfg.renderBackend != (UINT)onlyRenderBackend)) {
+                                continue;
+                            }
+                            int status = test(argv[0], &cfg, &results);
+                            if (status) {
+                                if (cfg.statsFile) {
+                                    WriteStats(cfg.statsFile, results);
+                                }
+                                WriteTrace(&cfg);
+                                return status;
+                            }
                         }
                     }
                 }
             }
         }
+        if (cfg.statsFile && !WriteStats(cfg.statsFile, results)) {
+            return 1;
+        }
+        if (!WriteTrace(&cfg)) {
+            return 1;
+        }
         return 0;
     }
 
     for (int i = 1; i < argc; i++) {
+        if ((_stricmp(argv[i], "-renderer") == 0) && (i < argc - 1)) {
+            const int renderBackend = FindRenderBackend(argv[++i]);
+            if (renderBackend < 0) {
+                fprintf(stderr, "\nUnknown renderer: %s\n", argv[i]);
+                fprintf(stderr, "\nFor help: DX12SharedResource -h\n");
+                exit(1);
+            }
+            cfg.renderBackend = renderBackend;
+            continue;
+        }
+        if ((_stricmp(argv[i], "-format") == 0) && (i < argc - 1)) {
+            const int format = FindSharedFormat(argv[++i]);
+            if (format < 0) {
+                fprintf(stderr, "\nUnknown format: %s\n", argv[i]);
+                fprintf(stderr, "\nFor help: DX12SharedResource -h\n");
+                exit(1);
+            }
+            cfg.format = format;
+            continue;
+        }
         if (_stricmp(argv[i], "-mt") == 0) {
             cfg.mode = MULTI_THREADED;
             continue;
@@ -772,10 +2086,22 @@ int main(int argc, char* argv[])
             cfg.mode = CROSS_PROCESS;
             continue;
         }
-        //if (_stricmp(argv[i], "-validate") == 0) {
-        //    cfg.validate = true;
-        //    continue;
-        //}
+        if (_stricmp(argv[i], "-mailbox") == 0) {
+            cfg.mode = MAILBOX;
+            continue;
+        }
+        if ((_stricmp(argv[i], "-pipeline") == 0) && (i < argc - 1)) {
+            cfg.mode = PIPELINED;
+            cfg.pipelineDepth = atoi(argv[++i]);
+            continue;
+        }
+        if (_stricmp(argv[i], "-validate") == 0) {
+            cfg.validate = true;
+            if ((i < argc - 1) && IsNumber(argv[i + 1])) {
+                cfg.validateTolerance = atoi(argv[++i]);
+            }
+            continue;
+        }
         if (_stricmp(argv[i], "-vsync") == 0) {
             cfg.vsync = true;
             continue;
@@ -784,14 +2110,30 @@ int main(int argc, char* argv[])
             cfg.dedicated = true;
             continue;
         }
+        if (_stricmp(argv[i], "-singleheap") == 0) {
+            cfg.singleHeap = true;
+            continue;
+        }
+        if (_stricmp(argv[i], "-timeline") == 0) {
+            cfg.timelineSemaphores = true;
+            continue;
+        }
+        if (_stricmp(argv[i], "-headless") == 0) {
+            cfg.headless = true;
+            continue;
+        }
+        if (_stricmp(argv[i], "-resizecycle") == 0) {
+            cfg.resizeCycle = true;
+            continue;
+        }
         if ((_stricmp(argv[i], "-n") == 0) && (i < argc - 1)) {
             cfg.numBuffers = atoi(argv[++i]);
-            if (cfg.numBuffers < MIN_SHARED_BUFFERS) {
-                fprintf(stderr, "\nMininum number of buffers is %d\n", MIN_SHARED_BUFFERS);
+            if (cfg.numBuffers < DX12_MIN_SHARED_BUFFERS) {
+                fprintf(stderr, "\nMininum number of buffers is %d\n", DX12_MIN_SHARED_BUFFERS);
                 exit(1);
             }
-            if (cfg.numBuffers > MAX_SHARED_BUFFERS) {
-                fprintf(stderr, "\nMaximum number of buffers is %d\n", MAX_SHARED_BUFFERS);
+            if (cfg.numBuffers > DX12_MAX_SHARED_BUFFERS) {
+                fprintf(stderr, "\nMaximum number of buffers is %d\n", DX12_MAX_SHARED_BUFFERS);
                 exit(1);
             }
             continue;
@@ -800,15 +2142,78 @@ int main(int argc, char* argv[])
             cfg.duration = atoi(argv[++i]);
             continue;
         }
-        //if ((_stricmp(argv[i], "-capture") == 0) && (i < argc - 2)) {
-        //    cfg.captureFrame = atoi(argv[++i]);
-        //    cfg.captureFile = argv[++i];
-        //    continue;
-        //}
+        if ((_stricmp(argv[i], "-gpulatency") == 0) && (i < argc - 1)) {
+            cfg.gpuLatency = atoi(argv[++i]);
+            continue;
+        }
+        if ((_stricmp(argv[i], "-stats") == 0) && (i < argc - 1)) {
+            cfg.statsFile = argv[++i];
+            continue;
+        }
+        if ((_stricmp(argv[i], "-trace") == 0) && (i < argc - 1)) {
+            cfg.traceFile = argv[++i];
+            continue;
+        }
+        if ((_stricmp(argv[i], "-pipelinecache") == 0) && (i < argc - 1)) {
+            cfg.pipelineCacheFile = _stricmp(argv[++i], "none") ? argv[i] : NULL;
+            continue;
+        }
+        if ((_stricmp(argv[i], "-refresh") == 0) && (i < argc - 1)) {
+            cfg.refreshRate = atoi(argv[++i]);
+            continue;
+        }
+        if (_stricmp(argv[i], "-hash") == 0) {
+            cfg.hashFrames = true;
+            continue;
+        }
+        if ((_stricmp(argv[i], "-capture") == 0) && (i < argc - 2)) {
+            if (!ParseCaptureRange(argv[++i], &cfg.captureFrame, &cfg.captureCount)) {
+                fprintf(stderr, "\nInvalid capture range: %s\n", argv[i]);
+                fprintf(stderr, "\nFor help: DX12SharedResource -h\n");
+                exit(1);
+            }
+            cfg.captureFile = argv[++i];
+            continue;
+        }
+        if ((_stricmp(argv[i], "-record") == 0) && (i < argc - 1)) {
+            cfg.recordFile = argv[++i];
+            continue;
+        }
+        if ((_stricmp(argv[i], "-yuv") == 0) && (i < argc - 1)) {
+            cfg.recordYuvFormat = colorconvert::findFormat(argv[++i]);
+            if ((cfg.recordYuvFormat == colorconvert::FORMAT_NONE) || (cfg.recordYuvFormat >= colorconvert::NUM_FORMATS)) {
+                fprintf(stderr, "\nInvalid YUV format: %s\n", argv[i]);
+                fprintf(stderr, "\nFor help: DX12SharedResource -h\n");
+                exit(1);
+            }
+            if ((i < argc - 1) && ((_stricmp(argv[i + 1], "cpu") == 0) || (_stricmp(argv[i + 1], "gpu") == 0))) {
+                cfg.recordYuvOnGpu = _stricmp(argv[++i], "gpu") == 0;
+            }
+            continue;
+        }
         fprintf(stderr, "\nInvalid option: %s\n", argv[i]);
         fprintf(stderr, "\nFor help: DX12SharedResource -h\n");
         exit(1);
     }
 
-    return test(argv[0], hInstance, &cfg);
+    if (cfg.mode == PIPELINED) {
+        if ((cfg.pipelineDepth < 1) || (cfg.pipelineDepth >= cfg.numBuffers)) {
+            fprintf(stderr, "\nPipeline depth must be between 1 and %u\n", cfg.numBuffers - 1);
+            exit(1);
+        }
+    }
+    if (cfg.recordYuvFormat && !cfg.recordFile) {
+        fprintf(stderr, "\n-yuv converts the recorded frames, it requires -record\n");
+        exit(1);
+    }
+
+    StartTrace(&cfg);
+    int status = test(argv[0], &cfg, &results);
+    if (cfg.statsFile && !WriteStats(cfg.statsFile, results) && !status) {
+        status = 1;
+    }
+    if (!WriteTrace(&cfg) && !status) {
+        status = 1;
+    }
+    return status;
 }
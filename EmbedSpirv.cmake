@@ -0,0 +1,47 @@
+#\-------------------------------------- . -----------------------------------/#
+# Filename : EmbedSpirv.cmake            | SPIR-V binary to constexpr          #
+# Author   : Alexandre Buge              | uint32_t array header               #
+# Started  : 17/10/2026 09:20            |                                     #
+#/-------------------------------------- . -----------------------------------\#
+
+# cmake -DSPIRV_FILE=<in.spv> -DHEADER_FILE=<out.h> -DVARIABLE=<name> -P EmbedSpirv.cmake
+# SPIR-V is a stream of little endian 32 bits words, emitted as such so the array is the module
+cmake_minimum_required(VERSION 3.18)
+
+file(READ ${SPIRV_FILE} spirv HEX)
+string(LENGTH "${spirv}" length)
+math(EXPR remainder "${length} % 8")
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1;" words "${spirv}")
+list(GET words 0 magic)
+if (NOT remainder EQUAL 0 OR NOT magic STREQUAL "0x07230203")
+  message(FATAL_ERROR "${SPIRV_FILE} is not a SPIR-V module")
+endif ()
+
+# 8 words per line
+set(lines "")
+set(line "")
+set(count 0)
+foreach (word ${words})
+  string(APPEND line "${word}, ")
+  math(EXPR count "${count} + 1")
+  if (count EQUAL 8)
+    string(STRIP "${line}" line)
+    string(APPEND lines "  ${line}\n")
+    set(line "")
+    set(count 0)
+  endif ()
+endforeach ()
+if (NOT count EQUAL 0)
+  string(STRIP "${line}" line)
+  string(APPEND lines "  ${line}\n")
+endif ()
+get_filename_component(source ${SPIRV_FILE} NAME)
+
+file(WRITE ${HEADER_FILE}
+  "// generated by EmbedSpirv.cmake from ${source}, do not edit\n"
+  "#pragma once\n"
+  "#include <stdint.h>\n"
+  "\n"
+  "static constexpr uint32_t ${VARIABLE}[] = {\n"
+  "${lines}"
+  "};\n")
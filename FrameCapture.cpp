@@ -0,0 +1,406 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameCapture.cpp             | Asynchronous capture of presented  |
+| Author   : Alexandre Buge               | frames to disk                     |
+| Started  : 16/10/2026 23:50             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "FrameCapture.h"
+#include "DX12SharedData.h" // for SharedBufferFormat
+#include "Trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h> // for ldexpf
+#include <ctype.h> // for tolower
+#include <algorithm>
+
+bool FrameCapture::isNeeded(const DX12SharedConfig& config)
+  {return config.captureFile || config.validate || config.recordFile;}
+
+bool FrameCapture::start(DX12SharedData* pSharedData, Readback* readback)
+{
+  stop();
+  const DX12SharedConfig config = pSharedData->ReadConfig();
+  fileName = config.captureFile ? config.captureFile : "";
+  first = config.captureFrame;
+  count = config.captureCount;
+  this->readback = readback;
+  validating = config.validate;
+  if (validating)
+    validator.start(&pSharedData->validation, config.validateTolerance);
+  recordStats = nullptr;
+  memset(&pSharedData->record, 0, sizeof(pSharedData->record));
+  if (config.recordFile)
+  {
+    if (!recorder.open(config.recordFile, config.recordYuvFormat, config.refreshRate ? config.refreshRate : 60, &pSharedData->record))
+      return false;
+    recordStats = &pSharedData->record;
+  }
+  submitted = 0;
+  dropped = 0;
+  written = 0;
+  failed = 0;
+
+  queue = new FrameQueue(FRAME_CAPTURE_RING_SIZE);
+  queue->Start();
+  if (!writerThread.start(writerThreadEntryPoint, this))
+  {
+    fprintf(stderr, "FrameCapture: cannot start the writer thread.\n");
+    delete queue;
+    queue = nullptr;
+    recorder.close();
+    return false;
+  }
+  return true;
+}
+
+void FrameCapture::stop()
+{
+  if (!queue)
+    return;
+  queue->WaitIdle();
+  queue->Close();
+  writerThread.join();
+  delete queue;
+  queue = nullptr;
+  recorder.close();
+  if (!fileName.empty() && (submitted || dropped))
+    printf("FrameCapture: %llu frame(s) written, %llu dropped, %llu failed\n",
+           (unsigned long long)written.load(), (unsigned long long)dropped, (unsigned long long)failed.load());
+}
+
+bool FrameCapture::isCaptured(uint64_t frame) const
+  {return !fileName.empty() && frame >= first && (!count || frame - first < count);}
+
+int FrameCapture::acquire(uint64_t frame)
+{
+  if (!queue || (!validating && !recordStats && !isCaptured(frame)))
+    return -1;
+  if (queue->Full())
+  {
+    if (recordStats)
+    {
+      ++recordStats->dropped;
+      TRACE_COUNTER("record dropped", recordStats->dropped);
+    }
+    if (!isCaptured(frame))
+      return -1; // validation skips it
+    ++dropped;
+    TRACE_COUNTER("capture dropped", dropped);
+    return -1;
+  }
+  return (int)(submitted % FRAME_CAPTURE_RING_SIZE);
+}
+
+void FrameCapture::submit(uint32_t slot, uint64_t frame, uint64_t frameId, uint64_t copyToken, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t format,
+                          uint32_t planarOffset)
+{
+  layouts[slot] = Layout{ width, height, rowPitch, format, planarOffset, frameId };
+  ++submitted;
+  queue->Push(FrameSlot{ slot, copyToken, frame, 0 }); // acquire() checked a slot is free, never blocks
+}
+
+bool FrameCapture::waitIdle()
+  {return !queue || queue->WaitIdle();}
+
+uint32_t FrameCapture::writerThreadEntryPoint(void* parameter)
+{
+  FrameCapture* self = reinterpret_cast<FrameCapture*>(parameter);
+  trace::setThreadName("capture");
+  FrameSlot slot;
+  while (self->queue->Pop(slot))
+  {
+    bool res;
+    {
+      TRACE_SCOPE_VALUE("CaptureWait", "frame", slot.frameId);
+      res = self->readback->waitCopy(slot.bufferIndex, slot.fenceValue);
+    }
+    const Layout& layout = self->layouts[slot.bufferIndex];
+    if (res && self->validating)
+    {
+      TRACE_SCOPE_VALUE("Validate", "frame", layout.frameId);
+      self->validator.check(layout.frameId, self->readback->getPixels(slot.bufferIndex), layout.width, layout.height, layout.rowPitch, layout.format);
+    }
+    if (res && self->recorder.isOpen())
+    {
+      TRACE_SCOPE_VALUE("Record", "frame", slot.frameId);
+      const uint8_t* pixels = self->readback->getPixels(slot.bufferIndex);
+      self->recorder.append(pixels, layout.width, layout.height, layout.rowPitch, layout.format, layout.planarOffset ? pixels + layout.planarOffset : nullptr);
+    }
+    if (self->isCaptured(slot.frameId))
+    {
+      if (res)
+      {
+        TRACE_SCOPE_VALUE("CaptureWrite", "frame", slot.frameId);
+        const std::string fileName = self->getFileName(slot.frameId);
+        res = self->write(fileName.c_str(), self->readback->getPixels(slot.bufferIndex), layout);
+      }
+      if (res)
+        self->written.fetch_add(1, std::memory_order_relaxed);
+      else
+        self->failed.fetch_add(1, std::memory_order_relaxed);
+    }
+    self->queue->Release();
+  }
+  return 0;
+}
+
+std::string FrameCapture::getFileName(uint64_t frame) const
+{
+  char res[1024];
+  if (count == 1)
+    return fileName;
+  else
+  {
+    const size_t slash = fileName.find_last_of("/\\");
+    size_t dot = fileName.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+      dot = fileName.size();
+    snprintf(res, sizeof(res), "%s_%05llu%s", fileName.substr(0, dot).c_str(), (unsigned long long)frame, fileName.c_str() + dot);
+  }
+  return res;
+}
+
+/* ---------------------------------------- */
+
+static uint8_t halfToUnorm8(uint16_t half)
+{
+  if (half & 0x8000)
+    return 0;
+  const int exponent = (half >> 10) & 0x1f;
+  const float mantissa = (float)(half & 0x3ff);
+  const float value = exponent ? ldexpf(1.f + mantissa / 1024.f, exponent - 15) : ldexpf(mantissa, -24);
+  return (exponent == 0x1f || value > 1.f) ? 255 : (uint8_t)(value * 255.f + 0.5f);
+}
+
+// one pixel to BGRA8, float values are clamped without tone mapping
+static void pixelToBGRA8(uint32_t format, const uint8_t* src, uint8_t* dst)
+{
+  switch (format)
+  {
+    case SHARED_FORMAT_BGRA8:
+    case SHARED_FORMAT_BGRA8_SRGB:
+      memcpy(dst, src, 4);
+      break;
+    case SHARED_FORMAT_RGB10A2:
+    {
+      uint32_t pixel;
+      memcpy(&pixel, src, sizeof(pixel));
+      dst[0] = (uint8_t)((pixel >> 22) & 0xff);
+      dst[1] = (uint8_t)((pixel >> 12) & 0xff);
+      dst[2] = (uint8_t)((pixel >> 2) & 0xff);
+      dst[3] = (uint8_t)((pixel >> 30) * 85);
+      break;
+    }
+    case SHARED_FORMAT_RGBA16F:
+    {
+      uint16_t pixel[4];
+      memcpy(pixel, src, sizeof(pixel));
+      dst[0] = halfToUnorm8(pixel[2]);
+      dst[1] = halfToUnorm8(pixel[1]);
+      dst[2] = halfToUnorm8(pixel[0]);
+      dst[3] = halfToUnorm8(pixel[3]);
+      break;
+    }
+    default: // RGBA8
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+      dst[3] = src[3];
+  }
+}
+
+void FrameCapture::toBGRA8(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t format)
+{
+  const uint32_t bytesPerPixel = SharedFormatBytesPerPixel(format);
+  for (uint32_t x = 0; x < width; ++x)
+    pixelToBGRA8(format, src + x * bytesPerPixel, dst + x * 4);
+}
+
+// top-down 32 bits BMP
+static bool writeBMP(FILE* file, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t format)
+{
+#pragma pack(push, 1)
+  struct
+  {
+    uint16_t type;
+    uint32_t fileSize;
+    uint32_t reserved;
+    uint32_t pixelsOffset;
+    uint32_t headerSize;
+    int32_t width;
+    int32_t height;
+    uint16_t planes;
+    uint16_t bitCount;
+    uint32_t compression;
+    uint32_t imageSize;
+    int32_t xPixelsPerMeter;
+    int32_t yPixelsPerMeter;
+    uint32_t colorsUsed;
+    uint32_t colorsImportant;
+  } header;
+#pragma pack(pop)
+  const uint32_t imageSize = width * 4 * height;
+  memset(&header, 0, sizeof(header));
+  header.type = 0x4d42; // "BM"
+  header.fileSize = (uint32_t)(sizeof(header) + imageSize);
+  header.pixelsOffset = sizeof(header);
+  header.headerSize = 40;
+  header.width = (int32_t)width;
+  header.height = -(int32_t)height;
+  header.planes = 1;
+  header.bitCount = 32;
+  header.imageSize = imageSize;
+
+  bool res = fwrite(&header, sizeof(header), 1, file) == 1;
+  std::vector<uint8_t> row((size_t)width * 4);
+  for (uint32_t y = 0; res && y < height; ++y)
+  {
+    FrameCapture::toBGRA8(pixels + (size_t)y * rowPitch, row.data(), width, format);
+    res = fwrite(row.data(), row.size(), 1, file) == 1;
+  }
+  return res;
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+  static uint32_t table[256];
+  static bool initialized = false; // writer thread only
+  if (!initialized)
+  {
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t value = i;
+      for (int bit = 0; bit < 8; ++bit)
+        value = (value & 1) ? 0xedb88320 ^ (value >> 1) : value >> 1;
+      table[i] = value;
+    }
+    initialized = true;
+  }
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void appendBigEndian(std::vector<uint8_t>& data, uint32_t value)
+{
+  const uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+  data.insert(data.end(), bytes, bytes + 4);
+}
+
+static bool writePNGChunk(FILE* file, const char* type, const std::vector<uint8_t>& data)
+{
+  std::vector<uint8_t> chunk;
+  chunk.reserve(data.size() + 12);
+  appendBigEndian(chunk, (uint32_t)data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  appendBigEndian(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+  return fwrite(chunk.data(), chunk.size(), 1, file) == 1;
+}
+
+// RGBA8 PNG, stored deflate blocks: large files written at memcpy speed, no zlib dependency
+static bool writePNG(FILE* file, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t format)
+{
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  if (fwrite(signature, sizeof(signature), 1, file) != 1)
+    return false;
+
+  std::vector<uint8_t> header;
+  appendBigEndian(header, width);
+  appendBigEndian(header, height);
+  const uint8_t headerEnd[5] = { 8, 6, 0, 0, 0 }; // 8 bits, RGBA, deflate, no filter, no interlace
+  header.insert(header.end(), headerEnd, headerEnd + sizeof(headerEnd));
+  if (!writePNGChunk(file, "IHDR", header))
+    return false;
+
+  // scanlines with the None filter byte
+  const size_t scanlineSize = (size_t)width * 4 + 1;
+  std::vector<uint8_t> scanlines(scanlineSize * height);
+  for (uint32_t y = 0; y < height; ++y)
+  {
+    uint8_t* scanline = &scanlines[y * scanlineSize];
+    scanline[0] = 0;
+    FrameCapture::toBGRA8(pixels + (size_t)y * rowPitch, scanline + 1, width, format);
+    for (uint32_t x = 0; x < width; ++x)
+    {
+      uint8_t* pixel = scanline + 1 + x * 4;
+      const uint8_t blue = pixel[0];
+      pixel[0] = pixel[2];
+      pixel[2] = blue;
+    }
+  }
+
+  // zlib stream of stored blocks, at most 65535 bytes each
+  std::vector<uint8_t> stream;
+  stream.reserve(scanlines.size() + scanlines.size() / 65535 * 5 + 16);
+  stream.push_back(0x78);
+  stream.push_back(0x01);
+  uint32_t adlerA = 1, adlerB = 0;
+  for (size_t offset = 0; offset < scanlines.size() || offset == 0; )
+  {
+    const size_t size = std::min<size_t>(scanlines.size() - offset, 65535);
+    const bool last = offset + size == scanlines.size();
+    stream.push_back(last ? 1 : 0);
+    stream.push_back((uint8_t)size);
+    stream.push_back((uint8_t)(size >> 8));
+    stream.push_back((uint8_t)~size);
+    stream.push_back((uint8_t)(~size >> 8));
+    stream.insert(stream.end(), scanlines.begin() + offset, scanlines.begin() + offset + size);
+    for (size_t i = offset; i < offset + size; ++i)
+    {
+      adlerA = (adlerA + scanlines[i]) % 65521;
+      adlerB = (adlerB + adlerA) % 65521;
+    }
+    offset += size;
+    if (last)
+      break;
+  }
+  appendBigEndian(stream, (adlerB << 16) | adlerA);
+
+  return writePNGChunk(file, "IDAT", stream) && writePNGChunk(file, "IEND", std::vector<uint8_t>());
+}
+
+// rows in the shared buffer format, tightly packed
+static bool writeRaw(FILE* file, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t format)
+{
+  const size_t rowSize = (size_t)width * SharedFormatBytesPerPixel(format);
+  bool res = true;
+  for (uint32_t y = 0; res && y < height; ++y)
+    res = fwrite(pixels + (size_t)y * rowPitch, rowSize, 1, file) == 1;
+  return res;
+}
+
+static bool endsWith(const char* str, const char* suffix)
+{
+  const size_t length = strlen(str);
+  const size_t suffixLength = strlen(suffix);
+  if (suffixLength > length)
+    return false;
+  for (size_t i = 0; i < suffixLength; ++i)
+    if (tolower((unsigned char)str[length - suffixLength + i]) != suffix[i])
+      return false;
+  return true;
+}
+
+bool FrameCapture::write(const char* fileName, const uint8_t* pixels, const Layout& layout)
+{
+  FILE* file = fopen(fileName, "wb");
+  if (!file)
+  {
+    fprintf(stderr, "FrameCapture: cannot open %s.\n", fileName);
+    return false;
+  }
+  bool res;
+  if (endsWith(fileName, ".bmp"))
+    res = writeBMP(file, pixels, layout.width, layout.height, layout.rowPitch, layout.format);
+  else if (endsWith(fileName, ".png"))
+    res = writePNG(file, pixels, layout.width, layout.height, layout.rowPitch, layout.format);
+  else
+    res = writeRaw(file, pixels, layout.width, layout.height, layout.rowPitch, layout.format);
+  res = (fclose(file) == 0) && res;
+  if (!res)
+    fprintf(stderr, "FrameCapture: cannot write %s.\n", fileName);
+  return res;
+}
@@ -0,0 +1,94 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameCapture.h               | Asynchronous capture of presented  |
+| Author   : Alexandre Buge               | frames to disk                     |
+| Started  : 16/10/2026 23:50             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _FRAME_CAPTURE_H_
+#define _FRAME_CAPTURE_H_
+
+#include "FrameQueue.h"
+#include "FrameRecorder.h"
+#include "FrameValidator.h"
+#include "SmodePlatform.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+#define FRAME_CAPTURE_RING_SIZE 4
+
+/*
+** Writes presented frames to disk, validates or records them, without stalling the present
+** thread. The present backend copies a frame into one of its readback slots and submits it, a
+** writer thread waits for that copy, checks it with a FrameValidator, appends it to the
+** FrameRecorder stream, encodes the pixels by file extension (.bmp, .png, anything else raw
+** rows in the shared buffer format) and frees the slot. A frame finding every slot busy is
+** dropped and counted, the present thread never waits for the disk.
+** Frames [first, first + count) are captured, count 0 captures every frame from first on.
+** More than one frame needs a numbered file name, _<frame> is inserted before the extension.
+*/
+class FrameCapture
+{
+public:
+  // readback memory of the present backend, one buffer per slot
+  class Readback
+  {
+  public:
+    virtual ~Readback() {}
+    virtual bool waitCopy(uint32_t slot, uint64_t copyToken) = 0; // writer thread, false if the copy failed
+    virtual const uint8_t* getPixels(uint32_t slot) = 0;
+  };
+
+  ~FrameCapture()
+    {stop();}
+
+  static bool isNeeded(const struct DX12SharedConfig& config); // capture, validation or recording
+
+  bool start(struct DX12SharedData* pSharedData, Readback* readback); // from its config, reports into its stats
+  static void toBGRA8(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t format); // one row, for the encoders
+  void stop(); // writes the submitted frames first
+
+  // present thread
+  int acquire(uint64_t frame); // slot to copy the frame into, -1 when it is not captured or dropped
+  // frameId is the producer stamp of the buffer, the one the validation follows; planarOffset locates the
+  // frame the producer converted to config.recordYuvFormat after the pixels in the slot, 0 when it did not
+  void submit(uint32_t slot, uint64_t frame, uint64_t frameId, uint64_t copyToken, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t format,
+              uint32_t planarOffset = 0);
+  bool waitIdle(); // every submitted frame written, before freeing readback memory
+  bool isStarted() const
+    {return queue != nullptr;}
+
+private:
+  struct Layout
+  {
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowPitch; // bytes, at least width pixels
+    uint32_t format;   // SharedBufferFormat
+    uint32_t planarOffset;
+    uint64_t frameId;
+  };
+
+  static uint32_t writerThreadEntryPoint(void* parameter);
+  bool isCaptured(uint64_t frame) const;
+  std::string getFileName(uint64_t frame) const;
+  bool write(const char* fileName, const uint8_t* pixels, const Layout& layout);
+
+  std::string fileName;
+  uint64_t first = 0;
+  uint64_t count = 0;
+  bool validating = false;
+  FrameValidator validator; // writer thread
+  FrameRecorder recorder;   // writer thread, open when recording
+  FrameRecordStats* recordStats = nullptr;
+  Readback* readback = nullptr;
+  FrameQueue* queue = nullptr;
+  smode::Thread writerThread;
+  Layout layouts[FRAME_CAPTURE_RING_SIZE]; // written before the slot is pushed
+  uint64_t submitted = 0;                  // present thread
+  uint64_t dropped = 0;                    // present thread
+  std::atomic<uint64_t> written{0};
+  std::atomic<uint64_t> failed{0};
+};
+
+#endif // _FRAME_CAPTURE_H_
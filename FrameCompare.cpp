@@ -0,0 +1,270 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameCompare.cpp             | SIMD image hash and per channel    |
+| Author   : Alexandre Buge               | compare                            |
+| Started  : 17/10/2026 00:40             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "FrameCompare.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+# define FRAME_COMPARE_X86
+# include <immintrin.h>
+# ifdef _MSC_VER
+#  include <intrin.h> // for __cpuid
+#  define FRAME_COMPARE_TARGET(isa) // every intrinsic is available
+# else
+#  define FRAME_COMPARE_TARGET(isa) __attribute__((target(isa)))
+# endif
+#endif
+
+#define FRAME_COMPARE_NUM_LANES   32
+#define FRAME_COMPARE_BLOCK_SIZE  (FRAME_COMPARE_NUM_LANES * 4)
+#define FRAME_COMPARE_LANE_PRIME  0x9e3779b1u
+
+namespace framecompare
+{
+
+static const char* isaNames[NUM_ISAS] = { "scalar", "sse4.1", "avx2", "neon" };
+
+const char* getIsaName(uint32_t isa)
+  {return isa < NUM_ISAS ? isaNames[isa] : "unknown";}
+
+static uint32_t detectBestIsa()
+{
+#ifdef FRAME_COMPARE_X86
+# ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  const int maxLeaf = info[0];
+  __cpuid(info, 1);
+  const bool sse41 = (info[2] & (1 << 19)) != 0;
+  // AVX2 also needs the OS to save the YMM registers
+  const bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+  bool avx2 = false;
+  if (osAvx && maxLeaf >= 7)
+  {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+# else
+  __builtin_cpu_init();
+  const bool sse41 = __builtin_cpu_supports("sse4.1");
+  const bool avx2 = __builtin_cpu_supports("avx2");
+# endif
+  if (avx2)
+    return ISA_AVX2;
+  if (sse41)
+    return ISA_SSE41;
+#elif defined(_M_ARM64) || defined(__aarch64__)
+  return ISA_NEON;
+#endif
+  return ISA_SCALAR;
+}
+
+uint32_t getBestIsa()
+{
+  static const uint32_t res = detectBestIsa();
+  return res;
+}
+
+// the x86 levels include each other, NEON is alone
+bool isSupported(uint32_t isa)
+{
+  const uint32_t best = getBestIsa();
+  if (isa == ISA_SCALAR || isa == best)
+    return true;
+  return best != ISA_NEON && isa < best;
+}
+
+// SWAR, POPCNT is not implied by SSE4.1
+static uint32_t bitCount(uint32_t value)
+{
+  value = value - ((value >> 1) & 0x55555555);
+  value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+  return (((value + (value >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+/* ---------------------------------------- */
+
+typedef void (*HashBlocks)(uint32_t* lanes, const uint8_t* blocks, uint32_t numBlocks);
+
+static void hashBlocksScalar(uint32_t* lanes, const uint8_t* blocks, uint32_t numBlocks)
+{
+  for (uint32_t block = 0; block < numBlocks; ++block, blocks += FRAME_COMPARE_BLOCK_SIZE)
+    for (uint32_t lane = 0; lane < FRAME_COMPARE_NUM_LANES; ++lane)
+    {
+      uint32_t word;
+      memcpy(&word, blocks + lane * 4, sizeof(word));
+      lanes[lane] = (lanes[lane] ^ word) * FRAME_COMPARE_LANE_PRIME;
+    }
+}
+
+#ifdef FRAME_COMPARE_X86
+FRAME_COMPARE_TARGET("sse4.1")
+static void hashBlocksSSE41(uint32_t* lanes, const uint8_t* blocks, uint32_t numBlocks)
+{
+  const __m128i prime = _mm_set1_epi32((int)FRAME_COMPARE_LANE_PRIME);
+  __m128i acc[8];
+  for (int i = 0; i < 8; ++i)
+    acc[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes) + i);
+  for (uint32_t block = 0; block < numBlocks; ++block, blocks += FRAME_COMPARE_BLOCK_SIZE)
+    for (int i = 0; i < 8; ++i)
+    {
+      const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks) + i);
+      acc[i] = _mm_mullo_epi32(_mm_xor_si128(acc[i], words), prime);
+    }
+  for (int i = 0; i < 8; ++i)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes) + i, acc[i]);
+}
+
+FRAME_COMPARE_TARGET("avx2")
+static void hashBlocksAVX2(uint32_t* lanes, const uint8_t* blocks, uint32_t numBlocks)
+{
+  const __m256i prime = _mm256_set1_epi32((int)FRAME_COMPARE_LANE_PRIME);
+  __m256i acc[4];
+  for (int i = 0; i < 4; ++i)
+    acc[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes) + i);
+  for (uint32_t block = 0; block < numBlocks; ++block, blocks += FRAME_COMPARE_BLOCK_SIZE)
+    for (int i = 0; i < 4; ++i)
+    {
+      const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks) + i);
+      acc[i] = _mm256_mullo_epi32(_mm256_xor_si256(acc[i], words), prime);
+    }
+  for (int i = 0; i < 4; ++i)
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes) + i, acc[i]);
+}
+#endif // FRAME_COMPARE_X86
+
+uint64_t hash(const uint8_t* pixels, uint32_t rowSize, uint32_t height, uint32_t rowPitch, uint32_t isa)
+{
+  HashBlocks hashBlocks = hashBlocksScalar;
+#ifdef FRAME_COMPARE_X86
+  if (isa == ISA_AVX2 && isSupported(ISA_AVX2))
+    hashBlocks = hashBlocksAVX2;
+  else if (isa == ISA_SSE41 && isSupported(ISA_SSE41))
+    hashBlocks = hashBlocksSSE41;
+#endif
+
+  uint32_t lanes[FRAME_COMPARE_NUM_LANES];
+  for (uint32_t lane = 0; lane < FRAME_COMPARE_NUM_LANES; ++lane)
+    lanes[lane] = 0x811c9dc5u + lane * 0x01000193u;
+
+  const uint32_t numBlocks = rowSize / FRAME_COMPARE_BLOCK_SIZE;
+  const uint32_t tailSize = rowSize % FRAME_COMPARE_BLOCK_SIZE;
+  uint8_t tail[FRAME_COMPARE_BLOCK_SIZE];
+  memset(tail, 0, sizeof(tail));
+  for (uint32_t y = 0; y < height; ++y, pixels += rowPitch)
+  {
+    hashBlocks(lanes, pixels, numBlocks);
+    if (tailSize)
+    {
+      memcpy(tail, pixels + numBlocks * FRAME_COMPARE_BLOCK_SIZE, tailSize);
+      hashBlocks(lanes, tail, 1);
+    }
+  }
+
+  uint64_t res = 0xcbf29ce484222325ULL;
+  for (uint32_t lane = 0; lane < FRAME_COMPARE_NUM_LANES; ++lane)
+    res = (res ^ lanes[lane]) * 0x100000001b3ULL;
+  res = (res ^ (((uint64_t)rowSize << 32) | height)) * 0x100000001b3ULL;
+  // final avalanche, every lane reaches every bit
+  res ^= res >> 33;
+  res *= 0xff51afd7ed558ccdULL;
+  res ^= res >> 33;
+  return res;
+}
+
+/* ---------------------------------------- */
+
+// from byte x of a row on, the SIMD versions leave their tail to it
+static void compareRowScalar(const uint8_t* a, const uint8_t* b, uint32_t x, uint32_t rowSize, uint32_t tolerance, Difference& res)
+{
+  for (; x < rowSize; ++x)
+  {
+    const uint32_t difference = a[x] > b[x] ? a[x] - b[x] : b[x] - a[x];
+    if (difference > res.maxDifference)
+      res.maxDifference = difference;
+    if (difference > tolerance)
+      ++res.differentBytes;
+  }
+}
+
+#ifdef FRAME_COMPARE_X86
+FRAME_COMPARE_TARGET("sse4.1")
+static void compareSSE41(const uint8_t* a, uint32_t rowPitchA, const uint8_t* b, uint32_t rowPitchB, uint32_t rowSize, uint32_t height,
+                         uint32_t tolerance, Difference& res)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i maxAllowed = _mm_set1_epi8((char)tolerance);
+  __m128i maxDifference = zero;
+  for (uint32_t y = 0; y < height; ++y, a += rowPitchA, b += rowPitchB)
+  {
+    uint32_t x = 0;
+    for (; x + 16 <= rowSize; x += 16)
+    {
+      const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+      const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+      const __m128i difference = _mm_sub_epi8(_mm_max_epu8(va, vb), _mm_min_epu8(va, vb));
+      maxDifference = _mm_max_epu8(maxDifference, difference);
+      const uint32_t within = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(difference, maxAllowed), zero));
+      res.differentBytes += 16 - bitCount(within);
+    }
+    compareRowScalar(a, b, x, rowSize, tolerance, res);
+  }
+  uint8_t bytes[16];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), maxDifference);
+  for (uint8_t byte : bytes)
+    if (byte > res.maxDifference)
+      res.maxDifference = byte;
+}
+
+FRAME_COMPARE_TARGET("avx2")
+static void compareAVX2(const uint8_t* a, uint32_t rowPitchA, const uint8_t* b, uint32_t rowPitchB, uint32_t rowSize, uint32_t height,
+                        uint32_t tolerance, Difference& res)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i maxAllowed = _mm256_set1_epi8((char)tolerance);
+  __m256i maxDifference = zero;
+  for (uint32_t y = 0; y < height; ++y, a += rowPitchA, b += rowPitchB)
+  {
+    uint32_t x = 0;
+    for (; x + 32 <= rowSize; x += 32)
+    {
+      const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + x));
+      const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x));
+      const __m256i difference = _mm256_sub_epi8(_mm256_max_epu8(va, vb), _mm256_min_epu8(va, vb));
+      maxDifference = _mm256_max_epu8(maxDifference, difference);
+      const uint32_t within = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(difference, maxAllowed), zero));
+      res.differentBytes += 32 - bitCount(within);
+    }
+    compareRowScalar(a, b, x, rowSize, tolerance, res);
+  }
+  uint8_t bytes[32];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes), maxDifference);
+  for (uint8_t byte : bytes)
+    if (byte > res.maxDifference)
+      res.maxDifference = byte;
+}
+#endif // FRAME_COMPARE_X86
+
+Difference compare(const uint8_t* a, uint32_t rowPitchA, const uint8_t* b, uint32_t rowPitchB, uint32_t rowSize, uint32_t height,
+                   uint32_t tolerance, uint32_t isa)
+{
+  Difference res = { 0, 0 };
+  if (tolerance > 255)
+    tolerance = 255;
+#ifdef FRAME_COMPARE_X86
+  if (isa == ISA_AVX2 && isSupported(ISA_AVX2))
+    compareAVX2(a, rowPitchA, b, rowPitchB, rowSize, height, tolerance, res);
+  else if (isa == ISA_SSE41 && isSupported(ISA_SSE41))
+    compareSSE41(a, rowPitchA, b, rowPitchB, rowSize, height, tolerance, res);
+  else
+#endif
+  for (uint32_t y = 0; y < height; ++y, a += rowPitchA, b += rowPitchB)
+    compareRowScalar(a, b, 0, rowSize, tolerance, res);
+  return res;
+}
+
+}; /* namespace framecompare */
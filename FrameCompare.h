@@ -0,0 +1,49 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameCompare.h               | SIMD image hash and per channel    |
+| Author   : Alexandre Buge               | compare                            |
+| Started  : 17/10/2026 00:40             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _FRAME_COMPARE_H_
+#define _FRAME_COMPARE_H_
+
+#include <stdint.h>
+
+/*
+** Kernels over rows of pixels: rowSize bytes of content every rowPitch bytes. Each one has a
+** scalar, an SSE4.1 and an AVX2 version selected at run time, they return the same results so
+** a hash taken on one machine matches another. ISA_NEON is only known to the colorconvert
+** kernels, the hash and the compare run scalar on ARM.
+** The hash runs 32 lanes of 32 bits multiply-xor over 128 bytes blocks, the row tail padded with
+** zeros, then folds the lanes and the size: fast rather than cryptographic.
+** The compare works per byte, which is per channel for the 8 bits formats.
+*/
+namespace framecompare
+{
+
+enum Isa
+{
+  ISA_SCALAR,
+  ISA_SSE41,
+  ISA_AVX2,
+  ISA_NEON, // ARM64, where it is always available
+  NUM_ISAS
+};
+
+const char* getIsaName(uint32_t isa);
+bool isSupported(uint32_t isa);
+uint32_t getBestIsa(); // detected once, shared by the colorconvert kernels
+
+struct Difference
+{
+  uint64_t differentBytes; // more than the tolerance apart
+  uint32_t maxDifference;
+};
+
+uint64_t hash(const uint8_t* pixels, uint32_t rowSize, uint32_t height, uint32_t rowPitch, uint32_t isa = getBestIsa());
+Difference compare(const uint8_t* a, uint32_t rowPitchA, const uint8_t* b, uint32_t rowPitchB, uint32_t rowSize, uint32_t height,
+                   uint32_t tolerance, uint32_t isa = getBestIsa());
+
+}; /* namespace framecompare */
+
+#endif // _FRAME_COMPARE_H_
@@ -0,0 +1,35 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameLatency.cpp             | Producer submission to present     |
+| Author   : Alexandre Buge               | latency                            |
+| Started  : 16/10/2026 22:40             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "FrameLatency.h"
+#include "SmodePlatform.h" // for getTicksPerSecond
+#include "Trace.h"
+
+static void recordStage(FrameStats& stats, int64_t begin, int64_t end)
+{
+  static const double nanosecondsPerTick = 1e9 / (double)smode::getTicksPerSecond();
+  if (begin && end)
+    stats.record(end > begin ? (uint64_t)((double)(end - begin) * nanosecondsPerTick) : 0);
+}
+
+void FrameLatencyStats::record(const FrameLatencySample& sample)
+{
+  if (!sample.submitTicks || !sample.presentedTicks)
+    return;
+  recordStage(total, sample.submitTicks, sample.presentedTicks);
+  recordStage(handoff, sample.submitTicks, sample.acquireTicks);
+  recordStage(render, sample.acquireTicks, sample.renderedTicks);
+  recordStage(copy, sample.renderedTicks, sample.copiedTicks);
+  recordStage(present, sample.copiedTicks, sample.presentedTicks);
+  if (sample.presentedTicks > sample.submitTicks)
+    TRACE_COUNTER("latency us", (uint64_t)((sample.presentedTicks - sample.submitTicks) * 1000000 / smode::getTicksPerSecond()));
+}
+
+FrameLatencySummary FrameLatencyStats::summarize() const
+{
+  return FrameLatencySummary{ total.summarize(0.0), handoff.summarize(0.0), render.summarize(0.0),
+                              copy.summarize(0.0), present.summarize(0.0) };
+}
@@ -0,0 +1,51 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameLatency.h               | Producer submission to present     |
+| Author   : Alexandre Buge               | latency                            |
+| Started  : 16/10/2026 22:40             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _FRAME_LATENCY_H_
+#define _FRAME_LATENCY_H_
+
+#include "FrameStats.h"
+
+/*
+** Age of a frame when it reaches the screen, from the producer submission stamped in its
+** shared buffer. The stages follow each other: the presenter takes the buffer (handoff), its
+** wait on the shared fence completes (render, the producer GPU work still running then),
+** the copy ends and the present returns, or the flip happens when the backend knows it.
+** Every time is smode::getTicks(), 0 when unknown: a stage is only recorded when both of its
+** ends are known.
+*/
+struct FrameLatencySample
+{
+  int64_t submitTicks;
+  int64_t acquireTicks;
+  int64_t renderedTicks;
+  int64_t copiedTicks;
+  int64_t presentedTicks;
+};
+
+struct FrameLatencySummary
+{
+  FrameStatsSummary total;
+  FrameStatsSummary handoff;
+  FrameStatsSummary render;
+  FrameStatsSummary copy;
+  FrameStatsSummary present;
+};
+
+// lives in DX12SharedData, written by the present backend, read once the run is over
+struct FrameLatencyStats
+{
+  FrameStats total;
+  FrameStats handoff;
+  FrameStats render;
+  FrameStats copy;
+  FrameStats present;
+
+  void record(const FrameLatencySample& sample);
+  FrameLatencySummary summarize() const;
+};
+
+#endif // _FRAME_LATENCY_H_
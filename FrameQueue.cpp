@@ -0,0 +1,144 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameQueue.cpp               | Lock-free single producer / single |
+| Author   : Alexandre Buge               | consumer frame handoff ring        |
+| Started  : 16/10/2026 10:12             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "FrameQueue.h"
+#include "SmodePlatform.h" // for waitOnAddress
+
+#include <thread> // for yield
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h> // for _mm_pause
+#endif
+
+bool AdaptiveWaiter::spinningHelps()
+{
+  static const bool res = std::thread::hardware_concurrency() != 1;
+  return res;
+}
+
+void AdaptiveWaiter::cpuRelax()
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+void AdaptiveWaiter::yieldThread()
+  {std::this_thread::yield();}
+
+void AdaptiveWaiter::park(uint32_t epoch)
+  {smode::waitOnAddress(&m_epoch, epoch);}
+
+void AdaptiveWaiter::unpark()
+  {smode::wakeOneOnAddress(&m_epoch);}
+
+/* ---------------------------------------- */
+
+FrameQueue::FrameQueue(uint32_t depth)
+  : m_depth(depth)
+{
+  if (m_depth < 1)
+    m_depth = 1;
+  if (m_depth > capacity)
+    m_depth = capacity;
+}
+
+void FrameQueue::setState(State state)
+{
+  uint32_t current = m_state.load(std::memory_order_relaxed);
+  while (current < uint32_t(state) && !m_state.compare_exchange_weak(current, state, std::memory_order_acq_rel))
+    ;
+  m_producerWaiter.Notify();
+  m_consumerWaiter.Notify();
+}
+
+void FrameQueue::Start()
+  {setState(RUNNING);}
+
+void FrameQueue::Close()
+  {setState(CLOSED);}
+
+void FrameQueue::Detach()
+  {setState(DETACHED);}
+
+bool FrameQueue::WaitStarted()
+{
+  m_producerWaiter.Wait([this] { return m_state.load(std::memory_order_acquire) != STARTING; });
+  return m_state.load(std::memory_order_acquire) == RUNNING;
+}
+
+bool FrameQueue::WaitDetached()
+{
+  m_consumerWaiter.Wait([this] { return m_state.load(std::memory_order_acquire) == DETACHED; });
+  return true;
+}
+
+bool FrameQueue::Push(const FrameSlot& slot)
+{
+  const uint64_t head = m_head.load(std::memory_order_relaxed);
+  m_producerWaiter.Wait([this, head] { return head - m_released.load(std::memory_order_acquire) < m_depth || Closed(); });
+  if (Closed())
+    return false;
+  m_slots[head & (capacity - 1)] = slot;
+  m_head.store(head + 1, std::memory_order_release);
+  m_consumerWaiter.Notify();
+  return true;
+}
+
+bool FrameQueue::Full() const
+  {return m_head.load(std::memory_order_relaxed) - m_released.load(std::memory_order_acquire) >= m_depth;}
+
+bool FrameQueue::WaitIdle()
+{
+  const uint64_t head = m_head.load(std::memory_order_relaxed);
+  m_producerWaiter.Wait([this, head] { return m_released.load(std::memory_order_acquire) == head || Closed(); });
+  return !Closed();
+}
+
+bool FrameQueue::Pop(FrameSlot& slot)
+{
+  const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+  m_consumerWaiter.Wait([this, tail] { return m_head.load(std::memory_order_acquire) != tail || Closed(); });
+  if (Closed())
+    return false;
+  slot = m_slots[tail & (capacity - 1)];
+  m_tail.store(tail + 1, std::memory_order_relaxed);
+  return true;
+}
+
+bool FrameQueue::TryPop(FrameSlot& slot)
+{
+  const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+  if (m_head.load(std::memory_order_acquire) == tail || Closed())
+    return false;
+  slot = m_slots[tail & (capacity - 1)];
+  m_tail.store(tail + 1, std::memory_order_relaxed);
+  return true;
+}
+
+void FrameQueue::Publish(uint64_t frameId)
+{
+  m_published.store(frameId + 1, std::memory_order_release);
+  m_consumerWaiter.Notify();
+}
+
+bool FrameQueue::WaitPublished(uint64_t& published)
+{
+  const uint64_t seen = published;
+  const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+  m_consumerWaiter.Wait([this, seen, tail] {
+    return m_published.load(std::memory_order_acquire) > seen || m_head.load(std::memory_order_acquire) != tail || Closed();
+  });
+  published = m_published.load(std::memory_order_acquire);
+  return !Closed();
+}
+
+void FrameQueue::Release()
+{
+  m_released.fetch_add(1, std::memory_order_release);
+  m_producerWaiter.Notify();
+}
@@ -0,0 +1,150 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameQueue.h                 | Lock-free single producer / single |
+| Author   : Alexandre Buge               | consumer frame handoff ring        |
+| Started  : 16/10/2026 10:12             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _FRAME_QUEUE_H_
+#define _FRAME_QUEUE_H_
+
+#include <atomic>
+#include <cstdint>
+
+#define FRAME_QUEUE_CACHE_LINE_SIZE 64
+
+struct FrameSlot
+{
+  uint32_t bufferIndex;
+  uint64_t fenceValue;
+  uint64_t frameId;
+  int64_t submitTicks; // smode::getTicks() at submission, 0 when not measured
+};
+
+// Spin, then yield, then park on a futex/WaitOnAddress. Only one thread waits on a given
+// waiter, so the spin budget adapts to how quickly the other side usually answers.
+class AdaptiveWaiter
+{
+public:
+  AdaptiveWaiter()
+    : m_spinLimit(spinningHelps() ? 1024 : 0) {}
+
+  template<typename Predicate>
+  void Wait(Predicate ready)
+  {
+    for (uint32_t i = 0; i < m_spinLimit; ++i)
+    {
+      if (ready())
+      {
+        if (m_spinLimit < maxSpin)
+          m_spinLimit *= 2;
+        return;
+      }
+      cpuRelax();
+    }
+    for (uint32_t i = 0; i < yieldCount; ++i)
+    {
+      if (ready())
+        return;
+      yieldThread();
+    }
+    if (m_spinLimit > minSpin)
+      m_spinLimit /= 2;
+
+    while (1)
+    {
+      // a Notify after this load changes the epoch, so park() returns at once
+      const uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+      m_parked.store(true, std::memory_order_seq_cst);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready())
+        break;
+      park(epoch);
+    }
+    m_parked.store(false, std::memory_order_relaxed);
+  }
+
+  // call after publishing the state the waiter is looking for
+  void Notify()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_parked.load(std::memory_order_seq_cst))
+    {
+      m_epoch.fetch_add(1, std::memory_order_release);
+      unpark();
+    }
+  }
+
+private:
+  static const uint32_t minSpin = 64;
+  static const uint32_t maxSpin = 16384;
+  static const uint32_t yieldCount = 16;
+
+  static bool spinningHelps(); // false on a single hardware thread, the other side cannot run while we spin
+  static void cpuRelax();
+  static void yieldThread();
+  void park(uint32_t epoch);
+  void unpark();
+
+  uint32_t m_spinLimit;
+  std::atomic<bool> m_parked{false};
+  std::atomic<uint32_t> m_epoch{0};
+};
+
+// Frames travel from the producer (AbstractRender side) to the consumer (present side).
+// The producer may have at most 'depth' frames pushed and not yet released.
+class FrameQueue
+{
+public:
+  enum State : uint32_t
+  {
+    STARTING, // consumer is initializing
+    RUNNING,  // consumer accepts frames
+    CLOSED,   // either side requested termination
+    DETACHED, // producer has released every shared resource
+  };
+
+  explicit FrameQueue(uint32_t depth);
+
+  // consumer side
+  void Start();
+  bool Pop(FrameSlot& slot); // blocks while empty, false once closed
+  bool TryPop(FrameSlot& slot); // false while empty
+  void Release();            // the oldest popped frame is done
+  bool WaitDetached();
+
+  // producer side
+  bool WaitStarted();        // false if the consumer failed to start
+  bool Push(const FrameSlot& slot); // blocks while 'depth' frames are in flight, false once closed
+  bool Full() const;         // Push would block, stays false until the next Push once false
+  bool WaitIdle();           // blocks until every pushed frame has been released, false once closed
+  void Detach();
+
+  // mailbox handoff: the producer never blocks, the consumer only waits for something newer
+  void Publish(uint64_t frameId);          // producer
+  bool WaitPublished(uint64_t& published); // consumer, in: last seen, out: newest, false once closed
+                                           // also returns when a slot is pushed, see TryPop
+
+  // both sides
+  void Close();
+  bool Closed() const
+    {return m_state.load(std::memory_order_acquire) >= CLOSED;}
+  uint32_t Depth() const
+    {return m_depth;}
+
+private:
+  static const uint32_t capacity = 16; // power of two, ring size
+
+  void setState(State state);
+
+  alignas(FRAME_QUEUE_CACHE_LINE_SIZE) std::atomic<uint64_t> m_head{0};     // written by producer
+  alignas(FRAME_QUEUE_CACHE_LINE_SIZE) std::atomic<uint64_t> m_tail{0};     // written by consumer (popped)
+  std::atomic<uint64_t> m_released{0};                                      // written by consumer
+  alignas(FRAME_QUEUE_CACHE_LINE_SIZE) std::atomic<uint64_t> m_published{0}; // written by producer, newest frame id + 1
+  alignas(FRAME_QUEUE_CACHE_LINE_SIZE) std::atomic<uint32_t> m_state{STARTING};
+  uint32_t m_depth;
+  FrameSlot m_slots[capacity];
+  AdaptiveWaiter m_producerWaiter;
+  AdaptiveWaiter m_consumerWaiter;
+};
+
+#endif // _FRAME_QUEUE_H_
@@ -0,0 +1,226 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameRecorder.cpp            | Streaming Y4M or raw recording of  |
+| Author   : Alexandre Buge               | presented frames                   |
+| Started  : 17/10/2026 02:00             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "FrameRecorder.h"
+#include "ColorConvert.h"
+#include "FrameCapture.h" // for toBGRA8
+#include "DX12SharedData.h" // for SharedFormatBytesPerPixel
+#include "Trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h> // for tolower
+
+static bool isY4MFileName(const char* fileName)
+{
+  const size_t length = strlen(fileName);
+  if (length < 4)
+    return false;
+  const char* extension = fileName + length - 4;
+  for (int i = 0; i < 4; ++i)
+    if (tolower((unsigned char)extension[i]) != ".y4m"[i])
+      return false;
+  return true;
+}
+
+bool FrameRecorder::open(const char* fileName, uint32_t yuvFormat, uint32_t frameRate, FrameRecordStats* stats)
+{
+  close();
+  if (!file.open(fileName, FRAME_RECORDER_SEGMENT_SIZE))
+  {
+    fprintf(stderr, "FrameRecorder: cannot open %s.\n", fileName);
+    return false;
+  }
+  this->fileName = fileName;
+  this->stats = stats;
+  this->frameRate = frameRate;
+  memset(stats, 0, sizeof(*stats));
+  y4m = isY4MFileName(fileName);
+  this->yuvFormat = yuvFormat;
+  width = height = format = 0;
+  return true;
+}
+
+void FrameRecorder::close()
+{
+  if (!file.isOpen())
+    return;
+  const bool res = file.close();
+  if (!res)
+    fprintf(stderr, "FrameRecorder: cannot write %s.\n", fileName.c_str());
+  if (width)
+    printf("FrameRecorder: %llu frame(s) of %ux%u %s to %s, %llu dropped, %llu mismatched\n", (unsigned long long)stats->recorded, width, height,
+           getStreamFormatName(), fileName.c_str(), (unsigned long long)stats->dropped, (unsigned long long)stats->mismatched);
+  planes.clear();
+  row.clear();
+  converted.clear();
+  scratch.clear();
+}
+
+const char* FrameRecorder::getStreamFormatName() const
+{
+  switch (yuvFormat)
+  {
+    case colorconvert::FORMAT_NV12:
+      return y4m ? "yuv420p" : "nv12";
+    case colorconvert::FORMAT_P010:
+      return y4m ? "yuv420p10" : "p010";
+    default:
+      return y4m ? "yuv444p" : SharedFormatName(format);
+  }
+}
+
+bool FrameRecorder::writeHeader()
+{
+  if (!y4m)
+    return true;
+  const char* colorSpace = "C444";
+  if (yuvFormat == colorconvert::FORMAT_NV12)
+    colorSpace = "C420jpeg"; // chroma centered in its 2x2 block
+  else if (yuvFormat == colorconvert::FORMAT_P010)
+    colorSpace = "C420p10 XYSCSS=420P10";
+  char header[128];
+  const int size = snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 %s XCOLORRANGE=LIMITED\n", width, height, frameRate, colorSpace);
+  return file.write(header, (size_t)size);
+}
+
+bool FrameRecorder::append(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t format, const uint8_t* planar)
+{
+  if (!this->width)
+  {
+    this->width = width;
+    this->height = height;
+    this->format = format;
+    if (!writeHeader())
+    {
+      fprintf(stderr, "FrameRecorder: cannot write %s, recording stopped.\n", fileName.c_str());
+      close();
+      return false;
+    }
+  }
+  else if (width != this->width || height != this->height || format != this->format)
+  {
+    ++stats->mismatched;
+    return true;
+  }
+
+  const uint64_t start = file.getSize();
+  bool res;
+  if (yuvFormat != colorconvert::FORMAT_NONE)
+  {
+    if (!planar)
+    {
+      TRACE_SCOPE("ColorConvert");
+      converted.resize(colorconvert::getSize(width, height, yuvFormat));
+      colorconvert::convertShared(pixels, rowPitch, format, width, height, yuvFormat, converted.data(), scratch);
+      planar = converted.data();
+    }
+    res = writePlanarFrame(planar);
+  }
+  else if (y4m)
+    res = writeY4MFrame(pixels, rowPitch);
+  else
+  {
+    const size_t rowSize = (size_t)width * SharedFormatBytesPerPixel(format);
+    res = true;
+    for (uint32_t y = 0; res && y < height; ++y)
+      res = file.write(pixels + (size_t)y * rowPitch, rowSize);
+  }
+  if (!res)
+  {
+    fprintf(stderr, "FrameRecorder: cannot write %s, recording stopped.\n", fileName.c_str());
+    close();
+    return false;
+  }
+  ++stats->recorded;
+  stats->bytes += file.getSize() - start;
+  return true;
+}
+
+// BT.709 limited range, 8 bits fixed point, each chroma row sums to 0 so gray stays neutral
+bool FrameRecorder::writeY4MFrame(const uint8_t* pixels, uint32_t rowPitch)
+{
+  const size_t planeSize = (size_t)width * height;
+  planes.resize(planeSize * 3);
+  row.resize((size_t)width * 4);
+  uint8_t* luma = planes.data();
+  uint8_t* blueChroma = luma + planeSize;
+  uint8_t* redChroma = blueChroma + planeSize;
+  for (uint32_t y = 0; y < height; ++y)
+  {
+    FrameCapture::toBGRA8(pixels + (size_t)y * rowPitch, row.data(), width, format);
+    const uint8_t* bgra = row.data();
+    for (uint32_t x = 0; x < width; ++x, bgra += 4)
+    {
+      const int b = bgra[0], g = bgra[1], r = bgra[2];
+      *luma++ = (uint8_t)((47 * r + 157 * g + 16 * b + 128 + (16 << 8)) >> 8);
+      *blueChroma++ = (uint8_t)((-26 * r - 86 * g + 112 * b + 128 + (128 << 8)) >> 8);
+      *redChroma++ = (uint8_t)((112 * r - 102 * g - 10 * b + 128 + (128 << 8)) >> 8);
+    }
+  }
+  static const char frameHeader[] = "FRAME\n";
+  return file.write(frameHeader, sizeof(frameHeader) - 1) && file.write(planes.data(), planes.size());
+}
+
+// colorconvert layout, rows trimmed to the width; Y4M splits the chroma pairs in two planes of low bits samples
+bool FrameRecorder::writePlanarFrame(const uint8_t* planar)
+{
+  const uint32_t bytesPerSample = colorconvert::getBytesPerSample(yuvFormat);
+  const uint32_t pitch = colorconvert::getPitch(width, yuvFormat);
+  const uint32_t chromaWidth = (width + 1) / 2;
+  const uint32_t chromaHeight = (height + 1) / 2;
+  const uint8_t* chroma = planar + colorconvert::getChromaOffset(width, height, yuvFormat);
+  if (!y4m)
+  {
+    bool res = true;
+    for (uint32_t y = 0; res && y < height; ++y)
+      res = file.write(planar + (size_t)y * pitch, (size_t)width * bytesPerSample);
+    for (uint32_t y = 0; res && y < chromaHeight; ++y)
+      res = file.write(chroma + (size_t)y * pitch, (size_t)chromaWidth * 2 * bytesPerSample);
+    return res;
+  }
+
+  const size_t lumaSize = (size_t)width * height * bytesPerSample;
+  const size_t chromaSize = (size_t)chromaWidth * chromaHeight * bytesPerSample;
+  planes.resize(lumaSize + 2 * chromaSize);
+  for (uint32_t y = 0; y < height; ++y)
+    memcpy(planes.data() + (size_t)y * width * bytesPerSample, planar + (size_t)y * pitch, (size_t)width * bytesPerSample);
+  if (bytesPerSample == 1)
+  {
+    uint8_t* blueChroma = planes.data() + lumaSize;
+    uint8_t* redChroma = blueChroma + chromaSize;
+    for (uint32_t y = 0; y < chromaHeight; ++y)
+    {
+      const uint8_t* pairs = chroma + (size_t)y * pitch;
+      for (uint32_t x = 0; x < chromaWidth; ++x, pairs += 2)
+      {
+        *blueChroma++ = pairs[0];
+        *redChroma++ = pairs[1];
+      }
+    }
+  }
+  else
+  {
+    uint16_t* luma = reinterpret_cast<uint16_t*>(planes.data());
+    for (size_t i = 0; i < (size_t)width * height; ++i)
+      luma[i] >>= 6;
+    uint16_t* blueChroma = reinterpret_cast<uint16_t*>(planes.data() + lumaSize);
+    uint16_t* redChroma = blueChroma + (size_t)chromaWidth * chromaHeight;
+    for (uint32_t y = 0; y < chromaHeight; ++y)
+    {
+      const uint8_t* pairs = chroma + (size_t)y * pitch;
+      for (uint32_t x = 0; x < chromaWidth; ++x, pairs += 4)
+      {
+        uint16_t samples[2];
+        memcpy(samples, pairs, sizeof(samples));
+        *blueChroma++ = (uint16_t)(samples[0] >> 6);
+        *redChroma++ = (uint16_t)(samples[1] >> 6);
+      }
+    }
+  }
+  static const char frameHeader[] = "FRAME\n";
+  return file.write(frameHeader, sizeof(frameHeader) - 1) && file.write(planes.data(), planes.size());
+}
@@ -0,0 +1,66 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameRecorder.h              | Streaming Y4M or raw recording of  |
+| Author   : Alexandre Buge               | presented frames                   |
+| Started  : 17/10/2026 02:00             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _FRAME_RECORDER_H_
+#define _FRAME_RECORDER_H_
+
+#include "SmodePlatform.h"
+#include <string>
+#include <vector>
+
+#define FRAME_RECORDER_SEGMENT_SIZE (64 << 20) // pre-allocated and mapped at once, about 20 1080p rgba8 frames
+
+// lives in DX12SharedData, dropped is written by the present thread, the others by the writer thread
+struct FrameRecordStats
+{
+  uint64_t recorded;
+  uint64_t dropped;    // every readback slot busy, the present thread never waits for the recorder
+  uint64_t mismatched; // another size or format than the first frame
+  uint64_t bytes;
+};
+
+/*
+** Appends every frame it is given to one file through smode::MappedFileWriter. A .y4m name
+** gets a YUV4MPEG2 stream, anything else raw rows tightly packed. Without a yuvFormat the
+** stream is 8 bits 4:4:4 BT.709 limited range in Y4M and the shared buffer format in raw.
+** With one it is 4:2:0 from colorconvert: planar 8 or 10 bits in Y4M, NV12 or P010 in raw.
+** The frame is converted on the writer thread unless the producer already did it.
+** The first frame fixes the size and format of the stream, frames not matching it are dropped.
+*/
+class FrameRecorder
+{
+public:
+  bool open(const char* fileName, uint32_t yuvFormat, uint32_t frameRate, FrameRecordStats* stats); // colorconvert::Format
+  void close();
+
+  // writer thread, a write error closes the file; planar is the frame in yuvFormat when the producer converted it
+  bool append(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t format, const uint8_t* planar = nullptr);
+
+  bool isOpen() const
+    {return file.isOpen();}
+
+private:
+  bool writeHeader();
+  bool writeY4MFrame(const uint8_t* pixels, uint32_t rowPitch);
+  bool writePlanarFrame(const uint8_t* planar);
+  const char* getStreamFormatName() const;
+
+  smode::MappedFileWriter file;
+  std::string fileName;
+  FrameRecordStats* stats = nullptr;
+  uint32_t frameRate = 0;
+  bool y4m = false;
+  uint32_t yuvFormat = 0;
+  uint32_t width = 0; // 0 until the first frame
+  uint32_t height = 0;
+  uint32_t format = 0;
+  std::vector<uint8_t> planes;    // Y4M frame, Y then Cb then Cr
+  std::vector<uint8_t> row;       // BGRA8
+  std::vector<uint8_t> converted; // yuvFormat frame converted here
+  std::vector<uint8_t> scratch;   // for colorconvert::convertShared
+};
+
+#endif // _FRAME_RECORDER_H_
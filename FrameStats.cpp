@@ -0,0 +1,118 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameStats.cpp               | Frame time histogram and           |
+| Author   : Alexandre Buge               | percentiles                        |
+| Started  : 16/10/2026 19:40             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "FrameStats.h"
+
+#include <string.h>
+#ifdef _MSC_VER
+# include <intrin.h> // for _BitScanReverse64
+#endif // _MSC_VER
+
+static uint32_t highestBit(uint64_t value) // value != 0
+{
+#ifdef _MSC_VER
+  unsigned long res;
+  _BitScanReverse64(&res, value);
+  return (uint32_t)res;
+#else // _MSC_VER
+  return 63 - (uint32_t)__builtin_clzll(value);
+#endif // _MSC_VER
+}
+
+void FrameStats::reset()
+{
+  memset(buckets, 0, sizeof(buckets));
+  count = 0;
+  sum = 0;
+  minimum = UINT64_MAX;
+  maximum = 0;
+}
+
+// values below subBuckets map one to one, range r >= 1 splits [2^(r + subBucketBits - 1), 2^(r + subBucketBits))
+uint32_t FrameStats::bucketIndex(uint64_t value)
+{
+  if (value < subBuckets)
+    return (uint32_t)value;
+  const uint32_t shift = highestBit(value) - subBucketBits;
+  return (shift + 1) * subBuckets + (uint32_t)(value >> shift) - subBuckets;
+}
+
+uint64_t FrameStats::bucketLowerBound(uint32_t index)
+{
+  const uint32_t range = index / subBuckets;
+  const uint64_t subBucket = index % subBuckets;
+  if (!range)
+    return subBucket;
+  return (subBuckets + subBucket) << (range - 1);
+}
+
+uint64_t FrameStats::bucketUpperBound(uint32_t index)
+{
+  const uint32_t range = index / subBuckets;
+  return bucketLowerBound(index) + (range ? (uint64_t)1 << (range - 1) : 1) - 1;
+}
+
+void FrameStats::record(uint64_t nanoseconds)
+{
+  ++buckets[bucketIndex(nanoseconds)];
+  ++count;
+  sum += nanoseconds;
+  if (nanoseconds < minimum)
+    minimum = nanoseconds;
+  if (nanoseconds > maximum)
+    maximum = nanoseconds;
+}
+
+double FrameStats::getPercentile(double percentile) const
+{
+  if (!count)
+    return 0.0;
+  uint64_t rank = (uint64_t)(percentile / 100.0 * (double)count + 0.5);
+  if (rank < 1)
+    rank = 1;
+  if (rank > count)
+    rank = count;
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < numBuckets; ++i)
+  {
+    seen += buckets[i];
+    if (seen >= rank)
+    {
+      // middle of the bucket, clamped to what was actually recorded
+      uint64_t res = (bucketLowerBound(i) + bucketUpperBound(i)) / 2;
+      if (res < minimum)
+        res = minimum;
+      if (res > maximum)
+        res = maximum;
+      return (double)res * 1e-6;
+    }
+  }
+  return (double)maximum * 1e-6;
+}
+
+FrameStatsSummary FrameStats::summarize(double referenceFrameTime) const
+{
+  FrameStatsSummary res;
+  memset(&res, 0, sizeof(res));
+  res.count = count;
+  if (!count)
+    return res;
+  res.mean = (double)sum / (double)count * 1e-6;
+  res.min = (double)minimum * 1e-6;
+  res.max = (double)maximum * 1e-6;
+  res.p50 = getPercentile(50.0);
+  res.p90 = getPercentile(90.0);
+  res.p99 = getPercentile(99.0);
+  res.p999 = getPercentile(99.9);
+
+  // a bucket is counted as dropped when it lies entirely above the threshold
+  const double reference = referenceFrameTime > 0.0 ? referenceFrameTime : res.p50;
+  const uint64_t threshold = (uint64_t)(reference * 1.5 * 1e6);
+  for (uint32_t i = 0; i < numBuckets; ++i)
+    if (bucketLowerBound(i) > threshold)
+      res.dropped += buckets[i];
+  return res;
+}
@@ -0,0 +1,63 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameStats.h                 | Frame time histogram and           |
+| Author   : Alexandre Buge               | percentiles                        |
+| Started  : 16/10/2026 19:40             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _FRAME_STATS_H_
+#define _FRAME_STATS_H_
+
+#include <stdint.h>
+
+struct FrameStatsSummary
+{
+  uint64_t count;
+  double mean;   // all durations in milliseconds
+  double min;
+  double max;
+  double p50;
+  double p90;
+  double p99;
+  double p999;
+  uint64_t dropped; // frames longer than 1.5 times the reference frame time
+};
+
+/*
+** Log-linear histogram of durations in nanoseconds: every power of two range is split in
+** subBuckets linear buckets, so a percentile is within 1/subBuckets of the true value.
+** record() is a few instructions and never allocates, it can run every frame.
+*/
+class FrameStats
+{
+public:
+  FrameStats()
+    {reset();}
+
+  void reset();
+  void record(uint64_t nanoseconds);
+
+  uint64_t getCount() const
+    {return count;}
+  double getPercentile(double percentile) const; // milliseconds, 0 < percentile <= 100
+
+  // referenceFrameTime in milliseconds, 0 for the median (no vsync)
+  FrameStatsSummary summarize(double referenceFrameTime) const;
+
+private:
+  static const uint32_t subBucketBits = 5;
+  static const uint32_t subBuckets = 1 << subBucketBits;
+  static const uint32_t ranges = 64 - subBucketBits + 1;
+  static const uint32_t numBuckets = ranges * subBuckets;
+
+  static uint32_t bucketIndex(uint64_t value);
+  static uint64_t bucketLowerBound(uint32_t index);
+  static uint64_t bucketUpperBound(uint32_t index);
+
+  uint32_t buckets[numBuckets];
+  uint64_t count;
+  uint64_t sum;
+  uint64_t minimum;
+  uint64_t maximum;
+};
+
+#endif // _FRAME_STATS_H_
@@ -0,0 +1,84 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameValidator.cpp           | Presented frames checked against   |
+| Author   : Alexandre Buge               | reference frames                   |
+| Started  : 17/10/2026 01:10             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "FrameValidator.h"
+#include "DX12SharedData.h" // for SharedFormatBytesPerPixel
+#include "FrameCompare.h"
+#include "Trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// later failures are only counted
+#define FRAME_VALIDATE_MAX_REPORTS 8
+
+void FrameValidator::start(FrameValidationStats* stats, uint32_t tolerance)
+{
+  this->stats = stats;
+  this->tolerance = tolerance;
+  memset(stats, 0, sizeof(*stats));
+  width = height = format = 0;
+  references.clear();
+}
+
+bool FrameValidator::check(uint64_t frameId, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t format)
+{
+  const uint32_t rowSize = width * SharedFormatBytesPerPixel(format);
+  if (width != this->width || height != this->height || format != this->format)
+  {
+    this->width = width;
+    this->height = height;
+    this->format = format;
+    references.assign(FRAME_VALIDATE_PERIOD, Reference());
+  }
+
+  Reference& reference = references[frameId % FRAME_VALIDATE_PERIOD];
+  const uint64_t hash = framecompare::hash(pixels, rowSize, height, rowPitch);
+  if (!reference.known)
+  {
+    reference.known = true;
+    reference.hash = hash;
+    if (tolerance)
+    {
+      reference.pixels.resize((size_t)rowSize * height);
+      for (uint32_t y = 0; y < height; ++y)
+        memcpy(&reference.pixels[(size_t)y * rowSize], pixels + (size_t)y * rowPitch, rowSize);
+    }
+    ++stats->references;
+    return true;
+  }
+
+  if (hash == reference.hash)
+  {
+    ++stats->validated;
+    return true;
+  }
+
+  framecompare::Difference difference = { 0, 0 };
+  if (tolerance)
+  {
+    TRACE_SCOPE_VALUE("ValidateCompare", "frame", frameId);
+    difference = framecompare::compare(pixels, rowPitch, reference.pixels.data(), rowSize, rowSize, height, tolerance);
+    if (!difference.differentBytes)
+    {
+      ++stats->validated;
+      return true;
+    }
+  }
+
+  if (!stats->failed++)
+    stats->firstFailedFrame = frameId;
+  if (stats->failed <= FRAME_VALIDATE_MAX_REPORTS)
+  {
+    if (tolerance)
+      fprintf(stderr, "FrameValidator: frame %llu differs from its reference, %llu byte(s) off by up to %u.\n",
+              (unsigned long long)frameId, (unsigned long long)difference.differentBytes, difference.maxDifference);
+    else
+      fprintf(stderr, "FrameValidator: frame %llu differs from its reference, hash %016llx instead of %016llx.\n",
+              (unsigned long long)frameId, (unsigned long long)hash, (unsigned long long)reference.hash);
+  }
+  return false;
+}
@@ -0,0 +1,56 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : FrameValidator.h             | Presented frames checked against   |
+| Author   : Alexandre Buge               | reference frames                   |
+| Started  : 17/10/2026 01:10             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _FRAME_VALIDATOR_H_
+#define _FRAME_VALIDATOR_H_
+
+#include <stdint.h>
+#include <vector>
+
+// with config.validate the renderers draw frame id i like frame id i + FRAME_VALIDATE_PERIOD
+#define FRAME_VALIDATE_PERIOD 100
+
+// lives in DX12SharedData, written by the FrameCapture writer thread, read once the run is over
+struct FrameValidationStats
+{
+  uint64_t validated;   // frames matching their reference
+  uint64_t failed;
+  uint64_t references;  // first frame of each phase, taken as its reference
+  uint64_t firstFailedFrame;
+};
+
+/*
+** The first presented frame of each phase (producer frame id modulo FRAME_VALIDATE_PERIOD) is
+** its reference, every following one of the phase must match it: a torn, stale or corrupted
+** frame shows up as a mismatch. With a zero tolerance only the hash of each reference is kept,
+** otherwise a frame with another hash is compared per channel against the reference image
+** (FRAME_VALIDATE_PERIOD frames of memory). A size or format change restarts the references.
+*/
+class FrameValidator
+{
+public:
+  void start(FrameValidationStats* stats, uint32_t tolerance);
+
+  // writer thread, false on a mismatch
+  bool check(uint64_t frameId, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t format);
+
+private:
+  struct Reference
+  {
+    bool known = false;
+    uint64_t hash = 0;
+    std::vector<uint8_t> pixels; // tightly packed, tolerance only
+  };
+
+  FrameValidationStats* stats = nullptr;
+  uint32_t tolerance = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t format = 0;
+  std::vector<Reference> references;
+};
+
+#endif // _FRAME_VALIDATOR_H_
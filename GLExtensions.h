@@ -35,6 +35,23 @@ typedef void (GLAPIENTRY* PFNglTextureParameteri) (GLuint texture, GLenum pname,
 typedef void (GLAPIENTRY* PFNglGenerateTextureMipmap) (GLuint texture);
 typedef void (GLAPIENTRY* PFNglTextureSubImage2D) (GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels);
 
+/* ------------------ GL_ARB_texture_float / GL_EXT_texture_sRGB ------------------ */
+
+#define GL_RGBA16F 0x881A
+#define GL_SRGB8_ALPHA8 0x8C43
+
+/* ------------------------- GL_ARB_framebuffer_sRGB ------------------------ */
+
+#define GL_FRAMEBUFFER_SRGB 0x8DB9
+
+/* ---------------------- GL_ARB_internalformat_query2 --------------------- */
+
+#define GL_INTERNALFORMAT_SUPPORTED 0x826F
+#define GL_FRAMEBUFFER_RENDERABLE 0x8289
+#define GL_FULL_SUPPORT 0x82B7
+
+typedef void (GLAPIENTRY* PFNglGetInternalformativ) (GLenum target, GLenum internalformat, GLenum pname, GLsizei bufSize, GLint* params);
+
 /* ---------------------------- GL_EXT_semaphore --------------------------- */
 
 typedef void (GLAPIENTRY* PFNglDeleteSemaphoresEXT) (GLsizei n, const GLuint* semaphores);
@@ -5,7 +5,6 @@
 ` --------------------------------------- . --------------------------------- */
 #include "GLRender.h" 
 
-#include <cmath>// for modf
 #include "SmodeErrorAndAssert.h"
 #include <type_traits> // for result_of
 #include "GLExtensions.h"
@@ -210,12 +209,45 @@ static bool checkFrameBufferStatus(GLenum target)
 #endif // _DEBUG
 }
 
+// same memory layout as the DXGI format of DX12Present, 0 when GL has no matching internal format (BGRA)
+static GLenum glInternalFormat(UINT format)
+{
+  switch (format)
+  {
+    case SHARED_FORMAT_RGBA8: return GL_RGBA8;
+    case SHARED_FORMAT_RGBA8_SRGB: return GL_SRGB8_ALPHA8;
+    case SHARED_FORMAT_RGB10A2: return GL_RGB10_A2;
+    case SHARED_FORMAT_RGBA16F: return GL_RGBA16F;
+    default: return 0;
+  }
+}
+
+// WGL needs a window DC even when nothing is shown, never made visible
+static HWND createHiddenWindow()
+{
+  static const char* className = "GLRenderHidden";
+  WNDCLASSA windowClass = { 0, };
+  windowClass.style = CS_OWNDC;
+  windowClass.lpfnWndProc = DefWindowProcA;
+  windowClass.hInstance = GetModuleHandle(nullptr);
+  windowClass.lpszClassName = className;
+  RegisterClassA(&windowClass); // fails harmlessly when already registered
+  return CreateWindowExA(0, className, "", WS_POPUP, 0, 0, 1, 1, nullptr, nullptr, windowClass.hInstance, nullptr);
+}
+
 bool GLRender::Init(DX12SharedData* pSharedData)
 {
   typedef const GLubyte* (WINAPI*PFNglGetStringi) (GLenum name, GLuint index);
   // create gl context
   this->pSharedData = pSharedData;
-  hDC = GetDC(pSharedData->hWnd);
+  config = pSharedData->ReadConfig();
+  if (config.recordYuvOnGpu)
+  {
+    std::cerr << "GLRender: no conversion pass, record with -yuv <format> cpu\n";
+    return false;
+  }
+  hContextWnd = config.hWnd ? config.hWnd : createHiddenWindow();
+  hDC = GetDC(hContextWnd);
   assert(hDC);
   hRC = createAndActivateGLContext(hDC);
   assert(hRC);
@@ -243,22 +275,29 @@ bool GLRender::Init(DX12SharedData* pSharedData)
     std::cerr << "memory_win32_object_supported: " << memory_win32_object_supported << ", semaphore_win32_supported: " << semaphore_win32_supported << '\n';
     return false;
   }
+
+  // the format negotiated by the presenter must also be renderable here
+  internalFormat = glInternalFormat(config.format);
+  GLint renderable = 0;
+  if (internalFormat)
+    GL_CALL(glGetInternalformativ, GL_TEXTURE_2D, internalFormat, GL_FRAMEBUFFER_RENDERABLE, 1, &renderable);
+  if (renderable != GL_FULL_SUPPORT)
+  {
+    std::cerr << "GLRender: " << SharedFormatName(config.format) << " shared textures not supported\n";
+    return false;
+  }
+  if (internalFormat == GL_SRGB8_ALPHA8)
+    glEnable(GL_FRAMEBUFFER_SRGB); // clears are linear, encoded on write like the Vulkan sRGB attachments
+
   // share objects
+  buffers.assign(pSharedData->numSharedBuffers, Buffer());
   for (UINT i = 0; i < pSharedData->numSharedBuffers; ++i)
   {
     GL_CALL(glGenSemaphoresEXT, 1, &buffers[i].semaphore);
-    GL_CALL(glImportSemaphoreWin32HandleEXT, buffers[i].semaphore, GL_HANDLE_TYPE_D3D12_FENCE_EXT, pSharedData->sharedFenceHandle[i]);
+    GL_CALL(glImportSemaphoreWin32HandleEXT, buffers[i].semaphore, GL_HANDLE_TYPE_D3D12_FENCE_EXT, pSharedData->Buffer(i).sharedFenceHandle);
     GLboolean res = GL_NON_VOID_CALL(glIsSemaphoreEXT, buffers[i].semaphore);
     assert(res);
-    GL_CALL(glCreateMemoryObjectsEXT, 1, &buffers[i].memoryObject);
-    //const GLuint64 importSize = GLuint64(pSharedData->width) * GLuint64(pSharedData->height) * 4/* GL_RGBA8 */; /* fixme find dx12 equivalent to vkGetBufferMemoryRequirements? */
-    GL_CALL(glImportMemoryWin32HandleEXT, buffers[i].memoryObject, 0, GL_HANDLE_TYPE_D3D12_RESOURCE_EXT, pSharedData->sharedMemHandle[i]);
-    GL_CALL(glCreateTextures, GL_TEXTURE_2D, 1, &buffers[i].textureId);
-    GL_CALL(glTextureStorageMem2DEXT, buffers[i].textureId, 1, GL_RGBA8, pSharedData->width, pSharedData->height, buffers[i].memoryObject, 0 /* fixme maybe not 0 offset on DX12 texture? */);
-    GL_CALL(glTextureParameteri, buffers[i].textureId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    GL_CALL(glTextureParameteri, buffers[i].textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    GL_CALL(glTextureParameteri, buffers[i].textureId, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    GL_CALL(glTextureParameteri, buffers[i].textureId, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    importTexture(i);
     buffers[i].rendered = false;
   }
   // create a framebuffer on the shared texture
@@ -267,6 +306,75 @@ bool GLRender::Init(DX12SharedData* pSharedData)
   return true;
 }
 
+// memory object and texture of a shared buffer, the semaphore survives a resize
+void GLRender::importTexture(UINT bufferIndex)
+{
+  Buffer& buffer = buffers[bufferIndex];
+  GLuint memoryObject;
+  if (pSharedData->sharedHeapSize)
+  {
+    // imported once, every texture is placed in it
+    if (!heapMemoryObject)
+    {
+      GL_CALL(glCreateMemoryObjectsEXT, 1, &heapMemoryObject);
+      GL_CALL(glImportMemoryWin32HandleEXT, heapMemoryObject, pSharedData->sharedHeapSize, GL_HANDLE_TYPE_D3D12_TILEPOOL_EXT, pSharedData->Buffer(0).sharedMemHandle);
+    }
+    buffer.memoryObject = 0;
+    memoryObject = heapMemoryObject;
+  }
+  else
+  {
+    GL_CALL(glCreateMemoryObjectsEXT, 1, &buffer.memoryObject);
+    //const GLuint64 importSize = GLuint64(config.width) * GLuint64(config.height) * 4/* GL_RGBA8 */; /* fixme find dx12 equivalent to vkGetBufferMemoryRequirements? */
+    GL_CALL(glImportMemoryWin32HandleEXT, buffer.memoryObject, 0, GL_HANDLE_TYPE_D3D12_RESOURCE_EXT, pSharedData->Buffer(bufferIndex).sharedMemHandle);
+    memoryObject = buffer.memoryObject;
+  }
+  GL_CALL(glCreateTextures, GL_TEXTURE_2D, 1, &buffer.textureId);
+  GL_CALL(glTextureStorageMem2DEXT, buffer.textureId, 1, internalFormat, config.width, config.height, memoryObject, pSharedData->Buffer(bufferIndex).sharedMemOffset);
+  GL_CALL(glTextureParameteri, buffer.textureId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  GL_CALL(glTextureParameteri, buffer.textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  GL_CALL(glTextureParameteri, buffer.textureId, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  GL_CALL(glTextureParameteri, buffer.textureId, GL_TEXTURE_WRAP_T, GL_REPEAT);
+}
+
+void GLRender::releaseTexture(UINT bufferIndex)
+{
+  Buffer& buffer = buffers[bufferIndex];
+  glDeleteTextures(1, &buffer.textureId);
+  checkGLErrors();
+  buffer.textureId = 0;
+  if (buffer.memoryObject)
+  {
+    GL_CALL(glDeleteMemoryObjectsEXT, 1, &buffer.memoryObject);
+    buffer.memoryObject = 0;
+  }
+}
+
+// once every texture placed in the heap is released
+void GLRender::releaseHeap()
+{
+  if (heapMemoryObject)
+  {
+    GL_CALL(glDeleteMemoryObjectsEXT, 1, &heapMemoryObject);
+    heapMemoryObject = 0;
+  }
+}
+
+// the presenter reallocated the shared buffers, the context and semaphores are kept
+bool GLRender::Resize()
+{
+  if (!initialized)
+    return false;
+  glFinish(); // frames in flight still render into the old textures
+  config = pSharedData->ReadConfig();
+  for (UINT i = 0; i < buffers.size(); ++i)
+    releaseTexture(i);
+  releaseHeap();
+  for (UINT i = 0; i < buffers.size(); ++i)
+    importTexture(i);
+  return true;
+}
+
 void GLRender::Cleanup()
 {
   initialized = false;
@@ -275,29 +383,30 @@ void GLRender::Cleanup()
   GL_CALL(glDeleteFramebuffers, 1, &frameBuffer);
   frameBuffer = 0;
   // cleanup sharing
-  for (UINT i = 0; i < pSharedData->numSharedBuffers; ++i)
+  for (UINT i = 0; i < buffers.size(); ++i)
   {
-    glDeleteTextures(1, &buffers[i].textureId);
-    checkGLErrors();
-    GL_CALL(glDeleteMemoryObjectsEXT, 1, &buffers[i].memoryObject);
+    releaseTexture(i);
     GL_CALL(glDeleteSemaphoresEXT, 1, &buffers[i].semaphore);
   } 
+  releaseHeap();
+  buffers.clear();
   // delete gl context
   deactivateAndDeleteGLContext(hRC);
   hRC = nullptr;
   // Release device Context
-  ReleaseDC(pSharedData->hWnd, hDC);
+  ReleaseDC(hContextWnd, hDC);
   hDC = nullptr;
+  if (hContextWnd != config.hWnd)
+    DestroyWindow(hContextWnd);
+  hContextWnd = nullptr;
 }
 
 static void paintIntoCurrentDrawFramebuffer()
 {
   static int frameCount = 0;
   ++frameCount;
-  std::cout << "frameCount: " << frameCount << std::endl;
 
-  float ipart = 0.f;
-  float clamped = std::modf(float(frameCount) / 100.f, &ipart);
+  float clamped = float(frameCount % FRAME_VALIDATE_PERIOD) / float(FRAME_VALIDATE_PERIOD);
   glClearColor(clamped, clamped, clamped, 1.0f);
   checkGLErrors();
   glClear(GL_COLOR_BUFFER_BIT);
@@ -309,7 +418,8 @@ void GLRender::Render()
   const uint32_t currentBuffer = pSharedData->currentBufferIndex;
   
   GLenum srcLayout = GL_LAYOUT_COLOR_ATTACHMENT_EXT;
-  GL_CALL(glSemaphoreParameterui64vEXT, buffers[currentBuffer].semaphore, GL_D3D12_FENCE_VALUE_EXT, &buffers[currentBuffer].semaphoreFenceValue);
+  GLuint64 semaphoreFenceValue = pSharedData->Buffer(currentBuffer).sharedFenceValue;
+  GL_CALL(glSemaphoreParameterui64vEXT, buffers[currentBuffer].semaphore, GL_D3D12_FENCE_VALUE_EXT, &semaphoreFenceValue);
   GL_CALL(glWaitSemaphoreEXT, buffers[currentBuffer].semaphore, 0, nullptr, 1, &buffers[currentBuffer].textureId, &srcLayout);
   
   // fill texture thanks to framebuffer renderer technics
@@ -317,15 +427,14 @@ void GLRender::Render()
   GL_CALL(glFramebufferTexture2D, GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, buffers[currentBuffer].textureId, 0);
   
   checkFrameBufferStatus(GL_DRAW_FRAMEBUFFER);
-  glViewport(0, 0, pSharedData->width, pSharedData->height);
+  glViewport(0, 0, config.width, config.height);
   checkGLErrors();
 
   paintIntoCurrentDrawFramebuffer();
-  buffers[currentBuffer].semaphoreFenceValue++;
-  buffers[currentBuffer].semaphoreFenceValue++;
-  std::cout << buffers[currentBuffer].semaphoreFenceValue << std::endl; 
+  semaphoreFenceValue++;
+  pSharedData->Buffer(currentBuffer).sharedFenceValue = semaphoreFenceValue;
   GL_CALL(glBindFramebuffer, GL_DRAW_FRAMEBUFFER, 0);
-  GL_CALL(glSemaphoreParameterui64vEXT, buffers[currentBuffer].semaphore, GL_D3D12_FENCE_VALUE_EXT, &buffers[currentBuffer].semaphoreFenceValue);
+  GL_CALL(glSemaphoreParameterui64vEXT, buffers[currentBuffer].semaphore, GL_D3D12_FENCE_VALUE_EXT, &semaphoreFenceValue);
   GL_CALL(glSignalSemaphoreEXT, buffers[currentBuffer].semaphore, 0, nullptr, 1, &buffers[currentBuffer].textureId, &srcLayout);
 
   buffers[currentBuffer].rendered = true;
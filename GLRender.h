@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include <gl/GL.h>
 #include "DX12SharedData.h" // for AbstractRender
+#include <vector>
 typedef uint64_t GLuint64;
 
 class GLRender : public AbstractRender
@@ -22,21 +23,29 @@ class GLRender : public AbstractRender
    void Cleanup() override;
    void Render() override;
    bool Initialized() override;
+   bool Resize() override;
 
 private:
+  void importTexture(UINT bufferIndex);
+  void releaseTexture(UINT bufferIndex);
+  void releaseHeap();
 
-  struct
+  struct Buffer
   {
     GLuint semaphore;
     GLuint memoryObject;
     GLuint textureId;
-    GLuint64 semaphoreFenceValue;
     bool rendered;
-  } buffers[MAX_SHARED_BUFFERS] = { 0, };
+  };
+  std::vector<Buffer> buffers; // one per shared buffer
+  GLenum internalFormat = 0;   // of the negotiated config.format
+  GLuint heapMemoryObject = 0; // single shared heap import, the textures are placed in it, 0 without
 
   DX12SharedData* pSharedData = nullptr;
+  DX12SharedConfig config = { 0, }; // snapshot taken at Init
   HGLRC hRC = nullptr;
   HDC hDC = nullptr;
+  HWND hContextWnd = nullptr; // config.hWnd, or a hidden window when headless
   bool initialized = false;
   GLuint frameBuffer = 0;
 };
@@ -0,0 +1,82 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : GpuTimeline.cpp              | GPU timestamps calibrated on the   |
+| Author   : Alexandre Buge               | CPU clock                          |
+| Started  : 16/10/2026 21:45             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "GpuTimeline.h"
+#include "SmodePlatform.h" // for getTicks
+
+uint64_t HostClock::getTimestampFrequency()
+  {return (uint64_t)smode::getTicksPerSecond();}
+
+bool HostClock::getCalibration(uint64_t& gpuTimestamp, int64_t& cpuTicks)
+{
+  cpuTicks = smode::getTicks();
+  gpuTimestamp = (uint64_t)cpuTicks;
+  return true;
+}
+
+/* ---------------------------------------- */
+
+bool GpuTimeline::init(GpuClock* clock, GpuQueueStats* stats, const char* trackName)
+{
+  clear();
+  const uint64_t gpuFrequency = clock->getTimestampFrequency();
+  if (!gpuFrequency)
+    return false;
+  this->clock = clock;
+  this->stats = stats;
+  cpuFrequency = smode::getTicksPerSecond();
+  gpuToCpu = (double)cpuFrequency / (double)gpuFrequency;
+  if (!calibrate())
+  {
+    clear();
+    return false;
+  }
+  track = trackName ? trace::getTrack(trackName) : nullptr;
+  return true;
+}
+
+void GpuTimeline::clear()
+{
+  clock = nullptr;
+  stats = nullptr;
+  track = nullptr;
+}
+
+bool GpuTimeline::calibrate()
+  {return clock->getCalibration(calibrationGpu, calibrationCpu);}
+
+int64_t GpuTimeline::toCpuTicks(uint64_t gpuTimestamp) const
+{
+  // signed, a timestamp taken before the calibration is common
+  const int64_t delta = (int64_t)(gpuTimestamp - calibrationGpu);
+  return calibrationCpu + (int64_t)((double)delta * gpuToCpu);
+}
+
+void GpuTimeline::report(uint64_t frameId, int64_t submitTicks, uint64_t gpuBegin, uint64_t gpuEnd)
+{
+  if (!clock || gpuEnd < gpuBegin)
+    return;
+
+  const int64_t begin = toCpuTicks(gpuBegin);
+  const int64_t end = toCpuTicks(gpuEnd);
+  // calibration error can put the GPU start slightly before the submission
+  const int64_t queued = begin > submitTicks ? begin - submitTicks : 0;
+  stats->queued.record((uint64_t)((double)queued * 1e9 / (double)cpuFrequency));
+  stats->execution.record((uint64_t)((double)(end - begin) * 1e9 / (double)cpuFrequency));
+
+  if (track && trace::isEnabled())
+  {
+    if (queued)
+      trace::complete(track, "Queued", submitTicks, begin, "frame", frameId);
+    trace::complete(track, "Execute", begin, end > begin ? end : begin + 1, "frame", frameId);
+  }
+
+  if (end - calibrationCpu > cpuFrequency)
+    calibrate();
+}
+
+GpuQueueSummary GpuTimeline::summarize(const GpuQueueStats& stats)
+  {return GpuQueueSummary{ stats.queued.summarize(0.0), stats.execution.summarize(0.0) };}
@@ -0,0 +1,85 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : GpuTimeline.h                | GPU timestamps calibrated on the   |
+| Author   : Alexandre Buge               | CPU clock                          |
+| Started  : 16/10/2026 21:45             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _GPU_TIMELINE_H_
+#define _GPU_TIMELINE_H_
+
+#include "FrameStats.h"
+#include "Trace.h"
+
+/*
+** Source of the calibration, implemented by each backend on top of its API
+** (vkGetCalibratedTimestampsEXT, ID3D12CommandQueue::GetClockCalibration),
+** a fake clock is enough to drive a GpuTimeline without a GPU.
+*/
+class GpuClock
+{
+public:
+  virtual ~GpuClock() {}
+
+  virtual uint64_t getTimestampFrequency() = 0; // GPU ticks per second
+  // a GPU timestamp and smode::getTicks() sampled at the same instant, false if unsupported
+  virtual bool getCalibration(uint64_t& gpuTimestamp, int64_t& cpuTicks) = 0;
+};
+
+// CPU emulated queues, the GPU timestamps are already smode::getTicks()
+class HostClock : public GpuClock
+{
+public:
+  uint64_t getTimestampFrequency() override;
+  bool getCalibration(uint64_t& gpuTimestamp, int64_t& cpuTicks) override;
+};
+
+// lives in DX12SharedData, written by the backend owning the queue, read once the run is over
+struct GpuQueueStats
+{
+  FrameStats queued;    // submission to GPU start, waits on the shared fence included
+  FrameStats execution; // GPU start to GPU end
+};
+
+struct GpuQueueSummary
+{
+  FrameStatsSummary queued;
+  FrameStatsSummary execution;
+};
+
+/*
+** Every submission of a queue is reported once its timestamps are resolved, usually a few
+** frames later: both timestamps are moved to the CPU timeline, recorded in the queue stats and
+** traced on a track of their own. The calibration is sampled again every second so the two
+** clocks cannot drift apart.
+** Not thread safe, report from one thread at a time.
+*/
+class GpuTimeline
+{
+public:
+  // trackName may be null to keep the queue out of the trace
+  bool init(GpuClock* clock, GpuQueueStats* stats, const char* trackName);
+  void clear();
+
+  bool isValid() const
+    {return clock != nullptr;}
+
+  // submitTicks is smode::getTicks() when the work was submitted
+  void report(uint64_t frameId, int64_t submitTicks, uint64_t gpuBegin, uint64_t gpuEnd);
+
+  int64_t toCpuTicks(uint64_t gpuTimestamp) const;
+
+  static GpuQueueSummary summarize(const GpuQueueStats& stats);
+
+private:
+  bool calibrate();
+
+  GpuClock* clock = nullptr;
+  GpuQueueStats* stats = nullptr;
+  trace::Track track = nullptr;
+  double gpuToCpu = 0.0; // CPU ticks per GPU tick
+  int64_t cpuFrequency = 0;
+  uint64_t calibrationGpu = 0;
+  int64_t calibrationCpu = 0;
+};
+
+#endif // _GPU_TIMELINE_H_
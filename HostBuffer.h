@@ -0,0 +1,98 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : HostBuffer.h                 | Shared buffer in host memory with  |
+| Author   : Alexandre Buge               | an emulated fence                  |
+| Started  : 16/10/2026 17:20             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _HOST_BUFFER_H_
+#define _HOST_BUFFER_H_
+
+#include "SmodePlatform.h" // for waitOnSharedAddress
+#include <atomic>
+#include <new> // for placement new
+
+#define HOST_BUFFER_MAGIC 0x5246554254534f48ULL // "HOSTBUFR"
+#define HOST_BUFFER_ALIGNMENT 64
+
+/*
+** Software backends share their buffers as anonymous shared memory: sharedMemHandle maps
+** this header followed by the pixels in config.format, sharedFenceHandle is unused.
+** The fence follows the D3D12 fence protocol of DX12SharedBuffer::sharedFenceValue.
+*/
+struct alignas(HOST_BUFFER_ALIGNMENT) HostBuffer
+{
+  uint64_t magic;
+  uint32_t width;
+  uint32_t height;
+  uint32_t pitch; // bytes
+  uint32_t format; // SharedBufferFormat
+
+  alignas(HOST_BUFFER_ALIGNMENT) std::atomic<uint64_t> completedFenceValue;
+  std::atomic<uint32_t> signalCount; // futex word, bumped by every signal or interrupt
+
+  static size_t sizeFor(uint32_t width, uint32_t height, uint32_t bytesPerPixel)
+    {return sizeof(HostBuffer) + (size_t)width * bytesPerPixel * height;}
+  // between two host buffers placed in a single heap
+  static size_t strideFor(uint32_t width, uint32_t height, uint32_t bytesPerPixel)
+    {return (sizeFor(width, height, bytesPerPixel) + HOST_BUFFER_ALIGNMENT - 1) & ~(size_t)(HOST_BUFFER_ALIGNMENT - 1);}
+
+  // memory must be zeroed and sizeFor(width, height, bytesPerPixel) bytes
+  static HostBuffer* construct(void* memory, uint32_t width, uint32_t height, uint32_t format, uint32_t bytesPerPixel)
+  {
+    HostBuffer* res = new (memory) HostBuffer();
+    res->magic = HOST_BUFFER_MAGIC;
+    res->width = width;
+    res->height = height;
+    res->pitch = width * bytesPerPixel;
+    res->format = format;
+    return res;
+  }
+
+  // null if the mapping is not a host buffer of at least width x height in format
+  static HostBuffer* fromMapping(void* memory, size_t size, uint32_t width, uint32_t height, uint32_t format)
+  {
+    HostBuffer* res = reinterpret_cast<HostBuffer*>(memory);
+    if (!memory || size < sizeof(HostBuffer) || res->magic != HOST_BUFFER_MAGIC || res->format != format ||
+        res->width < width || res->height < height || size < sizeof(HostBuffer) + (size_t)res->pitch * res->height)
+      return nullptr;
+    return res;
+  }
+
+  uint8_t* getPixels()
+    {return reinterpret_cast<uint8_t*>(this + 1);}
+  const uint8_t* getPixels() const
+    {return reinterpret_cast<const uint8_t*>(this + 1);}
+
+  // never moves the fence backwards, a skipped value is also completed
+  void signal(uint64_t value)
+  {
+    uint64_t completed = completedFenceValue.load(std::memory_order_relaxed);
+    while (completed < value && !completedFenceValue.compare_exchange_weak(completed, value, std::memory_order_release))
+      ;
+    signalCount.fetch_add(1, std::memory_order_release);
+    smode::wakeAllOnSharedAddress(&signalCount);
+  }
+
+  // returns false if interrupted before the value was reached
+  bool wait(uint64_t value, const std::atomic<bool>& interrupted) const
+  {
+    while (1)
+    {
+      const uint32_t count = signalCount.load(std::memory_order_acquire);
+      if (completedFenceValue.load(std::memory_order_acquire) >= value)
+        return true;
+      if (interrupted.load(std::memory_order_acquire))
+        return false;
+      smode::waitOnSharedAddress(&signalCount, count);
+    }
+  }
+
+  // wakes waiters so they can observe their interrupted flag
+  void interrupt()
+  {
+    signalCount.fetch_add(1, std::memory_order_release);
+    smode::wakeAllOnSharedAddress(&signalCount);
+  }
+};
+
+#endif // _HOST_BUFFER_H_
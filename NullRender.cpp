@@ -0,0 +1,218 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : NullRender.cpp               | CPU renderer into host buffers,    |
+| Author   : Alexandre Buge               | no GPU required                    |
+| Started  : 16/10/2026 17:20             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "NullRender.h"
+#include "ColorConvert.h"
+#include "FrameQueue.h"
+#include "SmodeErrorAndAssert.h"
+#include "Trace.h"
+
+#include <stdio.h>
+#include <string.h> // for memcpy
+#include <algorithm> // for fill_n
+
+// normalized values only, truncated
+static uint16_t unormToHalf(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if (value < 6.1035156e-5f) // smallest normal half
+    return 0;
+  return (uint16_t)(((((bits >> 23) & 0xff) - 127 + 15) << 10) | ((bits >> 13) & 0x3ff));
+}
+
+// opaque gray in the shared buffer format, gray is 0..255
+static uint64_t grayPixel(UINT format, uint32_t gray)
+{
+  switch (format)
+  {
+    case SHARED_FORMAT_RGB10A2:
+    {
+      const uint32_t gray10 = gray * 1023 / 255;
+      return gray10 | (gray10 << 10) | (gray10 << 20) | 0xc0000000;
+    }
+    case SHARED_FORMAT_RGBA16F:
+    {
+      const uint64_t half = unormToHalf((float)gray / 255.f);
+      return half | (half << 16) | (half << 32) | (0x3c00ULL << 48); // alpha 1.0
+    }
+    default: // 8 bits channels, same gray in RGBA or BGRA order
+      return gray | (gray << 8) | (gray << 16) | 0xff000000;
+  }
+}
+
+bool NullRender::Init(DX12SharedData* pSharedData)
+{
+  this->pSharedData = pSharedData;
+  config = pSharedData->ReadConfig();
+
+  buffers = std::vector<Buffer>(pSharedData->numSharedBuffers);
+  submittedFenceValues.assign(pSharedData->numSharedBuffers, 0);
+  if (!mapBuffers())
+    return false;
+
+  // the worker thread is the GPU, its timeline is already in the trace
+  gpuTimeline.init(&gpuClock, &pSharedData->renderQueue, nullptr);
+
+  latencyTicks = (int64_t)config.simulatedGpuLatency * smode::getTicksPerSecond() / 1000000;
+  frameCount = 0;
+  interrupted = false;
+
+  // as many submissions in flight as there are buffers, the queue is started on our side
+  gpuQueue = new FrameQueue(pSharedData->numSharedBuffers);
+  gpuQueue->Start();
+  if (!gpuThread.start(gpuThreadEntryPoint, this))
+  {
+    fprintf(stderr, "NullRender: cannot start the GPU thread.\n");
+    return false;
+  }
+
+  initialized = true;
+  return true;
+}
+
+bool NullRender::mapBuffers()
+{
+  const bool singleHeap = pSharedData->sharedHeapSize != 0;
+  if (singleHeap && !heap.map(pSharedData->Buffer(0).sharedMemHandle))
+  {
+    fprintf(stderr, "NullRender: cannot map the shared heap.\n");
+    return false;
+  }
+
+  for (UINT i = 0; i < pSharedData->numSharedBuffers; ++i)
+  {
+    Buffer& buffer = buffers[i];
+    const UINT64 offset = pSharedData->Buffer(i).sharedMemOffset;
+    buffer.hostBuffer = nullptr;
+    if (singleHeap)
+    {
+      if (offset < heap.getSize())
+        buffer.hostBuffer = HostBuffer::fromMapping(reinterpret_cast<uint8_t*>(heap.getData()) + offset, heap.getSize() - (size_t)offset, config.width, config.height, config.format);
+    }
+    else if (buffer.memory.map(pSharedData->Buffer(i).sharedMemHandle))
+      buffer.hostBuffer = HostBuffer::fromMapping(buffer.memory.getData(), buffer.memory.getSize(), config.width, config.height, config.format);
+    if (!buffer.hostBuffer)
+    {
+      fprintf(stderr, "NullRender: shared buffer %u is not in host memory, a software present backend is required.\n", i);
+      return false;
+    }
+    if (!pSharedData->planarSize)
+      buffer.planar.close();
+    else if (!buffer.planar.map(pSharedData->Buffer(i).planarMemHandle) || buffer.planar.getSize() < pSharedData->planarSize)
+    {
+      fprintf(stderr, "NullRender: cannot map planar buffer %u.\n", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+// the presenter reallocated the host buffers, the worker thread and its queue stay
+bool NullRender::Resize()
+{
+  // pending submissions still fill the old buffers
+  if (!initialized || !gpuQueue->WaitIdle())
+    return false;
+  config = pSharedData->ReadConfig();
+  return mapBuffers();
+}
+
+void NullRender::Cleanup()
+{
+  initialized = false;
+  if (gpuQueue)
+  {
+    // pending submissions are dropped, a fence wait is unblocked
+    interrupted = true;
+    gpuQueue->Close();
+    for (Buffer& buffer : buffers)
+      if (buffer.hostBuffer)
+        buffer.hostBuffer->interrupt();
+    gpuThread.join();
+    delete gpuQueue;
+    gpuQueue = nullptr;
+
+    for (size_t i = 0; i < buffers.size(); ++i)
+      if (buffers[i].hostBuffer)
+        buffers[i].hostBuffer->signal(submittedFenceValues[i]);
+  }
+  buffers.clear();
+  heap.close();
+  submittedFenceValues.clear();
+  pSharedData = nullptr;
+}
+
+void NullRender::Render()
+{
+  const uint32_t currentBuffer = pSharedData->currentBufferIndex;
+
+  // same fence protocol as GLRender: wait for the presenter value, signal +1
+  UINT64& sharedFenceValue = pSharedData->Buffer(currentBuffer).sharedFenceValue;
+  FrameSlot slot = { currentBuffer, sharedFenceValue, frameCount++, smode::getTicks() };
+  submittedFenceValues[currentBuffer] = ++sharedFenceValue;
+
+  gpuQueue->Push(slot); // blocks while every buffer has a submission in flight
+}
+
+bool NullRender::Initialized()
+  {return initialized;}
+
+uint32_t NullRender::gpuThreadEntryPoint(void* parameter)
+{
+  NullRender* self = reinterpret_cast<NullRender*>(parameter);
+  trace::setThreadName("null gpu");
+  FrameSlot slot;
+  while (self->gpuQueue->Pop(slot))
+  {
+    self->execute(slot);
+    self->gpuQueue->Release();
+  }
+  return 0;
+}
+
+void NullRender::execute(const FrameSlot& slot)
+{
+  HostBuffer* hostBuffer = buffers[slot.bufferIndex].hostBuffer;
+  {
+    TRACE_SCOPE_VALUE("GpuWait", "fence", slot.fenceValue);
+    if (!hostBuffer->wait(slot.fenceValue, interrupted))
+      return;
+  }
+  const int64_t gpuBegin = smode::getTicks();
+
+  {
+    TRACE_SCOPE_VALUE("GpuFill", "frame", slot.frameId);
+    // same gray ramp as GLRender clear, periodic for the validation
+    const uint32_t gray = (uint32_t)(slot.frameId % FRAME_VALIDATE_PERIOD) * 255 / FRAME_VALIDATE_PERIOD;
+    const uint64_t pixel = grayPixel(config.format, gray);
+    const bool widePixels = SharedFormatBytesPerPixel(config.format) == 8;
+    uint8_t* row = hostBuffer->getPixels();
+    for (UINT y = 0; y < config.height; ++y, row += hostBuffer->pitch)
+      if (widePixels)
+        std::fill_n(reinterpret_cast<uint64_t*>(row), config.width, pixel);
+      else
+        std::fill_n(reinterpret_cast<uint32_t*>(row), config.width, (uint32_t)pixel);
+  }
+
+  if (pSharedData->planarSize)
+  {
+    TRACE_SCOPE("GpuConvert");
+    colorconvert::convertShared(hostBuffer->getPixels(), hostBuffer->pitch, config.format, config.width, config.height, config.recordYuvFormat,
+                                reinterpret_cast<uint8_t*>(buffers[slot.bufferIndex].planar.getData()), convertScratch);
+  }
+
+  if (latencyTicks)
+  {
+    TRACE_SCOPE("GpuLatency");
+    smode::sleepUntil(slot.submitTicks + latencyTicks);
+  }
+  gpuTimeline.report(slot.frameId, slot.submitTicks, (uint64_t)gpuBegin, (uint64_t)smode::getTicks());
+  hostBuffer->signal(slot.fenceValue + 1);
+}
+
+AbstractRender* newNullRender()
+  {return new NullRender();}
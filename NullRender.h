@@ -0,0 +1,69 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : NullRender.h                 | CPU renderer into host buffers,    |
+| Author   : Alexandre Buge               | no GPU required                    |
+| Started  : 16/10/2026 17:20             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _NULL_RENDER_H_
+#define _NULL_RENDER_H_
+
+#include "DX12SharedData.h" // for AbstractRender
+#include "GpuTimeline.h"
+#include "HostBuffer.h"
+#include "SmodePlatform.h"
+#include <atomic>
+#include <vector>
+
+class FrameQueue;
+
+/*
+** Renders into the HostBuffer shared by a software present backend.
+** Render() only submits, like a GPU queue: a worker thread waits for the presenter fence,
+** fills the buffer, holds the frame until config.simulatedGpuLatency elapsed since submission
+** and signals the fence. Cleanup drops pending submissions but still signals their fence
+** values, a presenter waiting on one of them is released like after a device idle.
+** The worker thread reports its fence wait and fill as the render queue GPU timings.
+** With config.recordYuvOnGpu it also converts the frame into the planar buffer of the presenter,
+** standing in for the compute pass of VkRender.
+*/
+class NullRender : public AbstractRender
+{
+public:
+  ~NullRender()
+    {Cleanup();}
+
+  bool Init(DX12SharedData* pSharedData) override;
+  void Cleanup() override;
+  void Render() override;
+  bool Initialized() override;
+  bool Resize() override;
+
+private:
+  struct Buffer
+  {
+    smode::SharedMemory memory;
+    HostBuffer* hostBuffer = nullptr;
+    smode::SharedMemory planar; // pSharedData->planarSize
+  };
+  std::vector<Buffer> buffers; // one per shared buffer
+  smode::SharedMemory heap;    // mapped once when the presenter placed every buffer in a single heap
+  std::vector<UINT64> submittedFenceValues; // per buffer, signaled at Cleanup for dropped submissions
+
+  bool mapBuffers(); // maps every sharedMemHandle, previous mappings are dropped
+  static uint32_t gpuThreadEntryPoint(void* parameter);
+  void execute(const struct FrameSlot& slot);
+
+  DX12SharedData* pSharedData = nullptr;
+  DX12SharedConfig config = {}; // snapshot taken at Init
+  FrameQueue* gpuQueue = nullptr;
+  smode::Thread gpuThread;
+  std::atomic<bool> interrupted{false};
+  HostClock gpuClock;
+  GpuTimeline gpuTimeline; // worker thread only
+  std::vector<uint8_t> convertScratch; // worker thread only
+  int64_t latencyTicks = 0;
+  uint64_t frameCount = 0;
+  bool initialized = false;
+};
+
+#endif // _NULL_RENDER_H_
@@ -6,14 +6,24 @@
 
 #include "SmodeErrorAndAssert.h"
 
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
-#undef GetCurrentTime // please unreal
+#ifdef _WIN32
+# define WIN32_LEAN_AND_MEAN
+# include <Windows.h>
+# undef GetCurrentTime // please unreal
+#else // _WIN32
+# include <errno.h>
+# include <signal.h>
+# include <stdio.h>
+# include <string.h>
+# include <time.h>
+#endif // _WIN32
 
 # include <algorithm> // for remove
 
 using namespace smode;
 
+#ifdef _WIN32
+
 unsigned long smode::getLastSystemError()
 {
   return GetLastError();
@@ -44,3 +54,41 @@ void smode::breakIfDebuggerPresent()
   if (IsDebuggerPresent() != FALSE)
     __debugbreak(); // Assertion break, see your callstack
 }
+
+#else // _WIN32
+
+unsigned long smode::getLastSystemError()
+{
+  return (unsigned long)errno;
+}
+
+std::wstring smode::getSystemErrorMessage(unsigned long systemError)
+{
+  const char* message = strerror((int)systemError);
+  return std::wstring(message, message + strlen(message));
+}
+
+void smode::suspendCurrentThreadDuring(unsigned long milliseconds)
+{
+  struct timespec duration = { (time_t)(milliseconds / 1000), (long)(milliseconds % 1000) * 1000000L };
+  while (nanosleep(&duration, &duration) != 0 && errno == EINTR)
+    ;
+}
+
+void smode::breakIfDebuggerPresent()
+{
+  // a non zero TracerPid means a debugger is attached
+  FILE* status = fopen("/proc/self/status", "r");
+  if (!status)
+    return;
+  char line[256];
+  int tracerPid = 0;
+  while (fgets(line, sizeof(line), status))
+    if (sscanf(line, "TracerPid: %d", &tracerPid) == 1)
+      break;
+  fclose(status);
+  if (tracerPid)
+    raise(SIGTRAP); // Assertion break, see your callstack
+}
+
+#endif // _WIN32
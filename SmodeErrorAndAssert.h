@@ -16,7 +16,7 @@
    do { x } while (false) \
    __pragma(warning(pop))
 # else // _MSC_VER
-#  define SMODE_FORCE_USER_TO_PUT_SEMICOLON(x) do { x } while (false) 
+#  define SMODE_FORCE_CALLER_TO_ADD_SEMICOLON(x) do { x } while (false) 
 # endif // _MSC_VER 
 
 # ifdef _DEBUG 
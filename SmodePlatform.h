@@ -0,0 +1,319 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : SmodePlatform.h              | Operating system layer             |
+| Author   : Alexandre Buge               | Win32 and POSIX backends           |
+| Started  : 16/10/2026 15:02             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _SMODE_PLATFORM_H_
+#define _SMODE_PLATFORM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#ifdef _WIN32
+# include <windows.h>
+#else // _WIN32
+# include <strings.h> // for strcasecmp
+# include <pthread.h>
+# include <sys/types.h> // for pid_t
+
+// the few Win32 types DX12SharedData and the frame loop are written with
+typedef unsigned int UINT;
+typedef uint32_t DWORD;
+typedef uint64_t UINT64;
+typedef void* HANDLE;
+typedef void* HWND;
+typedef const char* LPCSTR;
+typedef struct _LUID {
+  uint32_t LowPart;
+  int32_t HighPart;
+} LUID;
+
+# if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define YieldProcessor() _mm_pause()
+# elif defined(__aarch64__) || defined(__arm__)
+#  define YieldProcessor() __asm__ __volatile__("yield")
+# else
+#  define YieldProcessor()
+# endif
+
+# define _stricmp strcasecmp
+#endif // _WIN32
+
+namespace smode
+{
+
+#ifdef _WIN32
+typedef HANDLE NativeHandle;
+# define SMODE_INVALID_NATIVE_HANDLE nullptr
+#else // _WIN32
+typedef int NativeHandle; // file descriptor
+# define SMODE_INVALID_NATIVE_HANDLE -1
+#endif // _WIN32
+
+void closeNativeHandle(NativeHandle handle);
+
+/*
+** Time
+*/
+int64_t getTicks(); // monotonic
+int64_t getTicksPerSecond();
+void sleepUntil(int64_t ticks); // returns at once if ticks is in the past
+
+/*
+** Memory
+*/
+void* alignedAlloc(size_t size, size_t alignment);
+void alignedFree(void* memory);
+
+/*
+** File
+*/
+// a file completely written aside takes the place of fileName at once, readers get the old or the new one
+bool replaceFile(const char* writtenFileName, const char* fileName);
+
+// futex / WaitOnAddress, process private, may return spuriously
+void waitOnAddress(const std::atomic<uint32_t>* address, uint32_t undesiredValue);
+void wakeOneOnAddress(std::atomic<uint32_t>* address);
+
+// same on an address mapped by several processes, Win32 falls back to 1ms polling across processes
+void waitOnSharedAddress(const std::atomic<uint32_t>* address, uint32_t undesiredValue);
+void wakeAllOnSharedAddress(std::atomic<uint32_t>* address);
+
+/*
+** Process
+*/
+class Process
+{
+public:
+  Process() {}
+  ~Process()
+    {close();}
+
+  // arguments is null terminated and does not include the program
+  bool spawn(const char* program, const char* const* arguments);
+  bool hasExited();
+  void wait();
+  void close();
+
+  bool isValid() const;
+
+private:
+#ifdef _WIN32
+  HANDLE process = nullptr;
+#else // _WIN32
+  pid_t pid = 0;
+  bool exited = false;
+#endif // _WIN32
+
+  friend class Event;
+  friend class HandleChannel;
+
+  Process(const Process&) = delete;
+  Process& operator=(const Process&) = delete;
+};
+
+/*
+** Event, auto reset, can be handed to a child process through a HandleChannel
+*/
+class Event
+{
+public:
+  Event() {}
+  ~Event()
+    {close();}
+
+  bool create();
+  void adopt(NativeHandle handle);
+  void close();
+
+  void set();
+  bool wait();
+  bool waitOrProcessExit(Process& process); // false if the process exited first
+
+  NativeHandle getNativeHandle() const
+    {return handle;}
+  bool isValid() const
+    {return handle != SMODE_INVALID_NATIVE_HANDLE;}
+
+private:
+  NativeHandle handle = SMODE_INVALID_NATIVE_HANDLE;
+
+  Event(const Event&) = delete;
+  Event& operator=(const Event&) = delete;
+};
+
+/*
+** Thread
+*/
+class Thread
+{
+public:
+  typedef uint32_t (*Function)(void* parameter);
+
+  Thread() {}
+  ~Thread()
+    {join();}
+
+  bool start(Function function, void* parameter);
+  uint32_t join(); // thread result, 0 if never started
+
+  bool isStarted() const
+    {return started;}
+
+private:
+  bool started = false;
+#ifdef _WIN32
+  HANDLE thread = nullptr;
+#else // _WIN32
+  pthread_t thread;
+  Function function = nullptr;
+  void* parameter = nullptr;
+  uint32_t result = 0;
+
+  static void* entryPoint(void* thread);
+#endif // _WIN32
+
+  Thread(const Thread&) = delete;
+  Thread& operator=(const Thread&) = delete;
+};
+
+/*
+** Shared memory, zero filled at creation.
+** Either named, or anonymous and handed to another process through a HandleChannel.
+*/
+class SharedMemory
+{
+public:
+  SharedMemory() {}
+  ~SharedMemory()
+    {close();}
+
+  bool create(const char* name, size_t size);
+  bool open(const char* name); // maps the whole object
+  bool create(size_t size);         // anonymous
+  bool map(NativeHandle handle);    // maps the whole object, the handle stays owned by the caller
+  void close();
+
+  void* getData() const
+    {return data;}
+  size_t getSize() const
+    {return size;}
+  NativeHandle getNativeHandle() const // anonymous objects, valid until close
+    {return handle;}
+
+private:
+  void* data = nullptr;
+  size_t size = 0;
+  NativeHandle handle = SMODE_INVALID_NATIVE_HANDLE; // owned mapping object
+#ifndef _WIN32
+  char unlinkName[64] = { 0, }; // set on the creating side
+#endif // !_WIN32
+
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+};
+
+/*
+** Sequential file writes through memory mapped segments: the file grows by one pre-allocated
+** segment at a time, pages are flushed by the system after unmapping, and the file is cut to
+** the written size at close.
+*/
+#define SMODE_MAPPED_FILE_GRANULARITY 65536 // segment sizes and offsets, the Win32 allocation granularity
+
+class MappedFileWriter
+{
+public:
+  MappedFileWriter() {}
+  ~MappedFileWriter()
+    {close();}
+
+  bool open(const char* fileName, size_t segmentSize); // segmentSize is rounded up to the granularity
+  bool write(const void* data, size_t size);
+  bool close();
+
+  bool isOpen() const;
+  uint64_t getSize() const
+    {return written;}
+
+private:
+  bool mapSegment(uint64_t offset);
+  void unmapSegment();
+
+  uint8_t* segment = nullptr;
+  size_t segmentSize = 0;
+  uint64_t segmentOffset = 0;
+  uint64_t written = 0;
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#else // _WIN32
+  int file = -1;
+#endif // _WIN32
+
+  MappedFileWriter(const MappedFileWriter&) = delete;
+  MappedFileWriter& operator=(const MappedFileWriter&) = delete;
+};
+
+/*
+** One way handle transfer from a parent to the child process it spawns.
+** Win32 duplicates into the child and writes the values to an inherited pipe,
+** POSIX passes file descriptors over an inherited socket (SCM_RIGHTS).
+** Invalid handles are transmitted as invalid.
+*/
+class HandleChannel
+{
+public:
+  HandleChannel() {}
+  ~HandleChannel()
+    {close();}
+
+  // parent side
+  bool create();                       // before spawning
+  const char* getChildArgument() const // to be passed on the child command line
+    {return childArgument;}
+  void closeChildEnd();                // once spawned
+  bool send(const Process& child, const NativeHandle* handles, uint32_t count);
+
+  // child side
+  bool attach(const char* childArgument);
+  bool receive(NativeHandle* handles, uint32_t count);
+
+  void close();
+
+private:
+  NativeHandle parentEnd = SMODE_INVALID_NATIVE_HANDLE;
+  NativeHandle childEnd = SMODE_INVALID_NATIVE_HANDLE;
+  char childArgument[32] = { 0, };
+
+  HandleChannel(const HandleChannel&) = delete;
+  HandleChannel& operator=(const HandleChannel&) = delete;
+};
+
+/*
+** Window, POSIX has none and only runs the update loop.
+** runHeadless never creates one on any platform: windowCreated receives a null HWND and
+** windowUpdate runs back to back, without message pump, until closeWindow(nullptr).
+*/
+class WindowListener
+{
+public:
+  virtual ~WindowListener() {}
+
+  virtual bool windowCreated(HWND hWnd, UINT width, UINT height) = 0;
+  virtual void windowClosing() = 0;
+  virtual void windowUpdate() = 0; // called whenever the message queue is empty
+  virtual void windowResized(UINT, UINT) {} // client area, never while minimized
+};
+
+// runs until closeWindow, false if the window could not be created or windowCreated failed
+bool runWindow(const char* title, UINT width, UINT height, WindowListener* listener);
+bool runHeadless(UINT width, UINT height, WindowListener* listener);
+void setWindowTitle(HWND hWnd, const char* title); // ignored when headless
+void closeWindow(HWND hWnd);                       // null for runHeadless
+
+}; /* namespace smode */
+
+#endif // _SMODE_PLATFORM_H_
@@ -0,0 +1,640 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : SmodePlatformPosix.cpp       | Operating system layer             |
+| Author   : Alexandre Buge               | POSIX backend                      |
+| Started  : 16/10/2026 15:02             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "SmodePlatform.h"
+#include "SmodeErrorAndAssert.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm> // for min
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __linux__
+# include <linux/futex.h>
+# include <sys/eventfd.h>
+# include <sys/syscall.h>
+#endif // __linux__
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif // !MSG_NOSIGNAL
+#ifndef MSG_CMSG_CLOEXEC
+# define MSG_CMSG_CLOEXEC 0
+#endif // !MSG_CMSG_CLOEXEC
+
+extern char** environ;
+
+using namespace smode;
+
+void smode::closeNativeHandle(NativeHandle handle)
+{
+  if (handle >= 0)
+    ::close(handle);
+}
+
+/*
+** Time
+*/
+int64_t smode::getTicks()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int64_t smode::getTicksPerSecond()
+  {return 1000000000LL;}
+
+void smode::sleepUntil(int64_t ticks)
+{
+  struct timespec deadline = { (time_t)(ticks / 1000000000LL), (long)(ticks % 1000000000LL) };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+    ;
+}
+
+/*
+** Memory
+*/
+void* smode::alignedAlloc(size_t size, size_t alignment)
+{
+  void* res = nullptr;
+  return posix_memalign(&res, alignment, size) == 0 ? res : nullptr;
+}
+
+void smode::alignedFree(void* memory)
+  {free(memory);}
+
+bool smode::replaceFile(const char* writtenFileName, const char* fileName)
+  {return rename(writtenFileName, fileName) == 0;}
+
+void smode::waitOnAddress(const std::atomic<uint32_t>* address, uint32_t undesiredValue)
+{
+#ifdef __linux__
+  syscall(SYS_futex, (const uint32_t*)address, FUTEX_WAIT_PRIVATE, undesiredValue, NULL, NULL, 0);
+#else // __linux__
+  // no portable address wait, the caller re-checks its condition anyway
+  if (address->load(std::memory_order_acquire) == undesiredValue)
+  {
+    struct timespec duration = { 0, 100000 };
+    nanosleep(&duration, NULL);
+  }
+#endif // __linux__
+}
+
+void smode::wakeOneOnAddress(std::atomic<uint32_t>* address)
+{
+#ifdef __linux__
+  syscall(SYS_futex, (uint32_t*)address, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else // __linux__
+  (void)address;
+#endif // __linux__
+}
+
+void smode::waitOnSharedAddress(const std::atomic<uint32_t>* address, uint32_t undesiredValue)
+{
+#ifdef __linux__
+  syscall(SYS_futex, (const uint32_t*)address, FUTEX_WAIT, undesiredValue, NULL, NULL, 0);
+#else // __linux__
+  waitOnAddress(address, undesiredValue);
+#endif // __linux__
+}
+
+void smode::wakeAllOnSharedAddress(std::atomic<uint32_t>* address)
+{
+#ifdef __linux__
+  syscall(SYS_futex, (uint32_t*)address, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+#else // __linux__
+  (void)address;
+#endif // __linux__
+}
+
+/*
+** Process
+*/
+bool Process::spawn(const char* program, const char* const* arguments)
+{
+  const char* argv[16];
+  size_t argc = 0;
+  argv[argc++] = program;
+  for (const char* const* argument = arguments; *argument; ++argument)
+  {
+    if (argc + 1 >= sizeof(argv) / sizeof(*argv))
+      return false;
+    argv[argc++] = *argument;
+  }
+  argv[argc] = nullptr;
+
+  exited = false;
+  // a bare program name from argv[0] is looked up in PATH like CreateProcess does
+  int res = strchr(program, '/') ?
+    posix_spawn(&pid, program, NULL, NULL, (char* const*)argv, environ) :
+    posix_spawnp(&pid, program, NULL, NULL, (char* const*)argv, environ);
+  if (res != 0)
+  {
+    pid = 0;
+    return false;
+  }
+  return true;
+}
+
+bool Process::hasExited()
+{
+  if (!pid || exited)
+    return true;
+  int status;
+  if (waitpid(pid, &status, WNOHANG) == pid)
+    exited = true;
+  return exited;
+}
+
+void Process::wait()
+{
+  if (!pid || exited)
+    return;
+  int status;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+  exited = true;
+}
+
+void Process::close()
+{
+  // the child is reaped by wait or hasExited, nothing to release otherwise
+  pid = 0;
+  exited = false;
+}
+
+bool Process::isValid() const
+  {return pid != 0;}
+
+/*
+** Event
+*/
+bool Event::create()
+{
+  close();
+#ifdef __linux__
+  handle = eventfd(0, EFD_CLOEXEC);
+  return handle >= 0;
+#else // __linux__
+  return false;
+#endif // __linux__
+}
+
+void Event::adopt(NativeHandle handle)
+{
+  close();
+  this->handle = handle;
+}
+
+void Event::close()
+{
+  if (handle >= 0)
+  {
+    ::close(handle);
+    handle = -1;
+  }
+}
+
+void Event::set()
+{
+  uint64_t value = 1;
+  while (write(handle, &value, sizeof(value)) < 0 && errno == EINTR)
+    ;
+}
+
+// reading the counter resets it, as an auto reset event
+bool Event::wait()
+{
+  uint64_t value;
+  ssize_t res;
+  while ((res = read(handle, &value, sizeof(value))) < 0 && errno == EINTR)
+    ;
+  return res == sizeof(value);
+}
+
+bool Event::waitOrProcessExit(Process& process)
+{
+  static const int processPollMs = 100;
+  struct pollfd pollFd = { handle, POLLIN, 0 };
+  while (1)
+  {
+    int res = poll(&pollFd, 1, processPollMs);
+    if (res > 0)
+      return wait();
+    if (res < 0 && errno != EINTR)
+      return false;
+    if (process.hasExited())
+      return false;
+  }
+}
+
+/*
+** Thread
+*/
+void* Thread::entryPoint(void* thread)
+{
+  Thread* self = reinterpret_cast<Thread*>(thread);
+  self->result = self->function(self->parameter);
+  return nullptr;
+}
+
+bool Thread::start(Function function, void* parameter)
+{
+  assert(!started);
+  this->function = function;
+  this->parameter = parameter;
+  started = pthread_create(&thread, NULL, entryPoint, this) == 0;
+  return started;
+}
+
+uint32_t Thread::join()
+{
+  if (!started)
+    return 0;
+  pthread_join(thread, NULL);
+  started = false;
+  return result;
+}
+
+/*
+** Shared memory
+*/
+bool SharedMemory::create(const char* name, size_t size)
+{
+  close();
+  char path[sizeof(unlinkName)];
+  snprintf(path, sizeof(path), "/%s", name);
+  shm_unlink(path); // left over by a crashed run
+  int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+    return false;
+  memcpy(unlinkName, path, sizeof(path));
+  if (ftruncate(fd, (off_t)size) != 0)
+  {
+    ::close(fd);
+    close();
+    return false;
+  }
+  data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+  {
+    data = nullptr;
+    close();
+    return false;
+  }
+  this->size = size;
+  return true;
+}
+
+bool SharedMemory::open(const char* name)
+{
+  close();
+  char path[sizeof(unlinkName)];
+  snprintf(path, sizeof(path), "/%s", name);
+  int fd = shm_open(path, O_RDWR, 0);
+  if (fd < 0)
+    return false;
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size <= 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  data = mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+  {
+    data = nullptr;
+    return false;
+  }
+  size = (size_t)status.st_size;
+  return true;
+}
+
+bool SharedMemory::create(size_t size)
+{
+  close();
+#ifdef __linux__
+  handle = (int)syscall(SYS_memfd_create, "smode", 1 /* MFD_CLOEXEC */);
+#else // __linux__
+  char path[sizeof(unlinkName)];
+  snprintf(path, sizeof(path), "/smode-%d-%p", (int)getpid(), (void*)this);
+  handle = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (handle >= 0)
+  {
+    shm_unlink(path); // only reachable through the descriptor from now on
+    fcntl(handle, F_SETFD, FD_CLOEXEC);
+  }
+#endif // __linux__
+  if (handle < 0 || ftruncate(handle, (off_t)size) != 0)
+  {
+    close();
+    return false;
+  }
+  data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+  if (data == MAP_FAILED)
+  {
+    data = nullptr;
+    close();
+    return false;
+  }
+  this->size = size;
+  return true;
+}
+
+bool SharedMemory::map(NativeHandle handle)
+{
+  close();
+  struct stat status;
+  if (handle < 0 || fstat(handle, &status) != 0 || status.st_size <= 0)
+    return false;
+  data = mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+  if (data == MAP_FAILED)
+  {
+    data = nullptr;
+    return false;
+  }
+  size = (size_t)status.st_size;
+  return true;
+}
+
+void SharedMemory::close()
+{
+  if (data)
+  {
+    munmap(data, size);
+    data = nullptr;
+  }
+  if (handle >= 0)
+  {
+    ::close(handle);
+    handle = -1;
+  }
+  if (unlinkName[0])
+  {
+    shm_unlink(unlinkName);
+    unlinkName[0] = 0;
+  }
+  size = 0;
+}
+
+/*
+** Mapped file writer
+*/
+bool MappedFileWriter::open(const char* fileName, size_t segmentSize)
+{
+  close();
+  file = ::open(fileName, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (file < 0)
+    return false;
+  this->segmentSize = (segmentSize + SMODE_MAPPED_FILE_GRANULARITY - 1) / SMODE_MAPPED_FILE_GRANULARITY * SMODE_MAPPED_FILE_GRANULARITY;
+  written = 0;
+  if (!mapSegment(0))
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool MappedFileWriter::mapSegment(uint64_t offset)
+{
+  const off_t end = (off_t)(offset + segmentSize);
+#ifdef __linux__
+  // real blocks, a full disk fails here rather than with a SIGBUS on a page write
+  const int error = posix_fallocate(file, (off_t)offset, (off_t)segmentSize);
+  if (error == ENOSPC || (error && ftruncate(file, end) != 0))
+    return false;
+#else // __linux__
+  if (ftruncate(file, end) != 0)
+    return false;
+#endif // __linux__
+  void* data = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, (off_t)offset);
+  if (data == MAP_FAILED)
+    return false;
+  segment = reinterpret_cast<uint8_t*>(data);
+  segmentOffset = offset;
+  return true;
+}
+
+void MappedFileWriter::unmapSegment()
+{
+  if (segment)
+  {
+    munmap(segment, segmentSize);
+    segment = nullptr;
+  }
+}
+
+bool MappedFileWriter::write(const void* data, size_t size)
+{
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  while (size)
+  {
+    if (written == segmentOffset + segmentSize)
+    {
+      unmapSegment();
+      if (!mapSegment(written))
+        return false;
+    }
+    const size_t chunk = std::min<size_t>(size, (size_t)(segmentOffset + segmentSize - written));
+    memcpy(segment + (written - segmentOffset), bytes, chunk);
+    written += chunk;
+    bytes += chunk;
+    size -= chunk;
+  }
+  return true;
+}
+
+bool MappedFileWriter::close()
+{
+  if (file < 0)
+    return true;
+  unmapSegment();
+  const bool res = ftruncate(file, (off_t)written) == 0;
+  ::close(file);
+  file = -1;
+  return res;
+}
+
+bool MappedFileWriter::isOpen() const
+  {return file >= 0;}
+
+/*
+** Handle channel
+*/
+bool HandleChannel::create()
+{
+  close();
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    return false;
+  parentEnd = fds[0];
+  childEnd = fds[1];
+  fcntl(parentEnd, F_SETFD, FD_CLOEXEC); // only the child end is inherited
+  snprintf(childArgument, sizeof(childArgument), "%d", childEnd);
+  return true;
+}
+
+void HandleChannel::closeChildEnd()
+{
+  if (childEnd >= 0)
+  {
+    ::close(childEnd);
+    childEnd = -1;
+  }
+}
+
+// one message per handle: a validity byte, plus the descriptor in SCM_RIGHTS when valid
+bool HandleChannel::send(const Process& child, const NativeHandle* handles, uint32_t count)
+{
+  (void)child;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    char valid = handles[i] >= 0 ? 1 : 0;
+    struct iovec iov = { &valid, 1 };
+    union
+    {
+      char buffer[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    if (valid)
+    {
+      message.msg_control = control.buffer;
+      message.msg_controllen = sizeof(control.buffer);
+      struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+      header->cmsg_level = SOL_SOCKET;
+      header->cmsg_type = SCM_RIGHTS;
+      header->cmsg_len = CMSG_LEN(sizeof(int));
+      memcpy(CMSG_DATA(header), &handles[i], sizeof(int));
+    }
+
+    ssize_t res;
+    while ((res = sendmsg(parentEnd, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+      ;
+    if (res != 1)
+      return false;
+  }
+  return true;
+}
+
+bool HandleChannel::attach(const char* childArgument)
+{
+  close();
+  char* end = nullptr;
+  long fd = strtol(childArgument, &end, 10);
+  if (end == childArgument || fd < 0)
+    return false;
+  childEnd = (int)fd;
+  fcntl(childEnd, F_SETFD, FD_CLOEXEC);
+  return true;
+}
+
+bool HandleChannel::receive(NativeHandle* handles, uint32_t count)
+{
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    char valid = 0;
+    struct iovec iov = { &valid, 1 };
+    union
+    {
+      char buffer[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr align;
+    } control;
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t res;
+    while ((res = recvmsg(childEnd, &message, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR)
+      ;
+    if (res != 1)
+      return false;
+
+    handles[i] = -1;
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (valid)
+    {
+      if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+        return false;
+      memcpy(&handles[i], CMSG_DATA(header), sizeof(int));
+    }
+  }
+  return true;
+}
+
+void HandleChannel::close()
+{
+  closeChildEnd();
+  if (parentEnd >= 0)
+  {
+    ::close(parentEnd);
+    parentEnd = -1;
+  }
+  childArgument[0] = 0;
+}
+
+/*
+** Window
+*/
+static WindowListener* runningListener = nullptr;
+static bool running = false;
+
+bool smode::runWindow(const char* title, UINT width, UINT height, WindowListener* listener)
+{
+  (void)title;
+  return runHeadless(width, height, listener);
+}
+
+bool smode::runHeadless(UINT width, UINT height, WindowListener* listener)
+{
+  if (!listener->windowCreated(nullptr, width, height))
+    return false;
+  runningListener = listener;
+  running = true;
+  while (running)
+    listener->windowUpdate();
+  runningListener = nullptr;
+  return true;
+}
+
+void smode::setWindowTitle(HWND hWnd, const char* title)
+{
+  (void)hWnd;
+  (void)title;
+}
+
+void smode::closeWindow(HWND hWnd)
+{
+  (void)hWnd;
+  if (running)
+  {
+    running = false;
+    runningListener->windowClosing();
+  }
+}
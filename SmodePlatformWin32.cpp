@@ -0,0 +1,587 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : SmodePlatformWin32.cpp       | Operating system layer             |
+| Author   : Alexandre Buge               | Win32 backend                      |
+| Started  : 16/10/2026 15:02             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "SmodePlatform.h"
+#include "SmodeErrorAndAssert.h"
+
+#include <stdio.h>
+#include <stdlib.h> // for _strtoui64
+#include <string.h> // for memcpy
+#include <malloc.h> // for _aligned_malloc
+
+#pragma comment(lib, "Synchronization.lib") // for WaitOnAddress
+
+using namespace smode;
+
+void smode::closeNativeHandle(NativeHandle handle)
+{
+  if (handle)
+    CloseHandle(handle);
+}
+
+/*
+** Time
+*/
+int64_t smode::getTicks()
+{
+  LARGE_INTEGER res;
+  QueryPerformanceCounter(&res);
+  return res.QuadPart;
+}
+
+int64_t smode::getTicksPerSecond()
+{
+  LARGE_INTEGER res;
+  QueryPerformanceFrequency(&res);
+  return res.QuadPart;
+}
+
+// Sleep has a scheduler tick granularity, the last milliseconds are yielded away
+void smode::sleepUntil(int64_t ticks)
+{
+  const int64_t frequency = getTicksPerSecond();
+  int64_t remaining;
+  while ((remaining = ticks - getTicks()) > 0)
+  {
+    const int64_t ms = remaining * 1000 / frequency;
+    if (ms > 2)
+      Sleep((DWORD)(ms - 2));
+    else
+      SwitchToThread();
+  }
+}
+
+/*
+** Memory
+*/
+void* smode::alignedAlloc(size_t size, size_t alignment)
+  {return _aligned_malloc(size, alignment);}
+
+void smode::alignedFree(void* memory)
+  {_aligned_free(memory);}
+
+bool smode::replaceFile(const char* writtenFileName, const char* fileName)
+  {return MoveFileExA(writtenFileName, fileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;}
+
+void smode::waitOnAddress(const std::atomic<uint32_t>* address, uint32_t undesiredValue)
+  {WaitOnAddress((volatile VOID*)address, &undesiredValue, sizeof(undesiredValue), INFINITE);}
+
+void smode::wakeOneOnAddress(std::atomic<uint32_t>* address)
+  {WakeByAddressSingle((PVOID)address);}
+
+// WaitOnAddress only sees wakes from the same process, the timeout covers the other ones
+void smode::waitOnSharedAddress(const std::atomic<uint32_t>* address, uint32_t undesiredValue)
+  {WaitOnAddress((volatile VOID*)address, &undesiredValue, sizeof(undesiredValue), 1);}
+
+void smode::wakeAllOnSharedAddress(std::atomic<uint32_t>* address)
+  {WakeByAddressAll((PVOID)address);}
+
+/*
+** Process
+*/
+bool Process::spawn(const char* program, const char* const* arguments)
+{
+  char cmdLine[1024];
+  int length = snprintf(cmdLine, sizeof(cmdLine), "\"%s\"", program);
+  for (const char* const* argument = arguments; *argument && length > 0 && length < (int)sizeof(cmdLine); ++argument)
+    length += snprintf(cmdLine + length, sizeof(cmdLine) - length, " %s", *argument);
+  if (length <= 0 || length >= (int)sizeof(cmdLine))
+    return false;
+
+  STARTUPINFOA si;
+  PROCESS_INFORMATION pi;
+  ZeroMemory(&si, sizeof(si));
+  si.cb = sizeof(si);
+  ZeroMemory(&pi, sizeof(pi));
+  if (!CreateProcessA(NULL, cmdLine, NULL, NULL, TRUE /* the handle channel is inherited */, 0, NULL, NULL, &si, &pi))
+    return false;
+  CloseHandle(pi.hThread);
+  process = pi.hProcess;
+  return true;
+}
+
+bool Process::hasExited()
+  {return !process || WaitForSingleObject(process, 0) == WAIT_OBJECT_0;}
+
+void Process::wait()
+{
+  if (process)
+    WaitForSingleObject(process, INFINITE);
+}
+
+void Process::close()
+{
+  if (process)
+  {
+    CloseHandle(process);
+    process = nullptr;
+  }
+}
+
+bool Process::isValid() const
+  {return process != nullptr;}
+
+/*
+** Event
+*/
+bool Event::create()
+{
+  close();
+  handle = CreateEvent(NULL, FALSE, FALSE, NULL);
+  return handle != nullptr;
+}
+
+void Event::adopt(NativeHandle handle)
+{
+  close();
+  this->handle = handle;
+}
+
+void Event::close()
+{
+  if (handle)
+  {
+    CloseHandle(handle);
+    handle = nullptr;
+  }
+}
+
+void Event::set()
+  {SetEvent(handle);}
+
+bool Event::wait()
+  {return WaitForSingleObject(handle, INFINITE) == WAIT_OBJECT_0;}
+
+bool Event::waitOrProcessExit(Process& process)
+{
+  if (!process.process)
+    return wait();
+  HANDLE waitHandles[] = { handle, process.process };
+  return WaitForMultipleObjects(2, waitHandles, FALSE, INFINITE) == WAIT_OBJECT_0;
+}
+
+/*
+** Thread
+*/
+struct ThreadStart
+{
+  Thread::Function function;
+  void* parameter;
+};
+
+static DWORD WINAPI threadEntryPoint(void* parameter)
+{
+  ThreadStart start = *reinterpret_cast<ThreadStart*>(parameter);
+  delete reinterpret_cast<ThreadStart*>(parameter);
+  return start.function(start.parameter);
+}
+
+bool Thread::start(Function function, void* parameter)
+{
+  assert(!started);
+  ThreadStart* start = new ThreadStart{ function, parameter };
+  thread = CreateThread(NULL, 0, threadEntryPoint, start, 0, NULL);
+  if (!thread)
+  {
+    delete start;
+    return false;
+  }
+  started = true;
+  return true;
+}
+
+uint32_t Thread::join()
+{
+  if (!started)
+    return 0;
+  WaitForSingleObject(thread, INFINITE);
+  DWORD res = 0;
+  GetExitCodeThread(thread, &res);
+  CloseHandle(thread);
+  thread = nullptr;
+  started = false;
+  return res;
+}
+
+/*
+** Shared memory
+*/
+bool SharedMemory::create(const char* name, size_t size)
+{
+  close();
+  handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+  if (!handle)
+    return false;
+  data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if (!data)
+  {
+    close();
+    return false;
+  }
+  this->size = size;
+  return true;
+}
+
+bool SharedMemory::open(const char* name)
+{
+  close();
+  handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+  if (!handle)
+    return false;
+  data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  MEMORY_BASIC_INFORMATION info;
+  if (!data || !VirtualQuery(data, &info, sizeof(info)))
+  {
+    close();
+    return false;
+  }
+  size = info.RegionSize; // rounded up to pages
+  return true;
+}
+
+bool SharedMemory::create(size_t size)
+  {return create(nullptr, size);}
+
+bool SharedMemory::map(NativeHandle handle)
+{
+  close();
+  data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  MEMORY_BASIC_INFORMATION info;
+  if (!data || !VirtualQuery(data, &info, sizeof(info)))
+  {
+    close();
+    return false;
+  }
+  size = info.RegionSize; // rounded up to pages
+  return true;
+}
+
+void SharedMemory::close()
+{
+  if (data)
+  {
+    UnmapViewOfFile(data);
+    data = nullptr;
+  }
+  if (handle)
+  {
+    CloseHandle(handle);
+    handle = nullptr;
+  }
+  size = 0;
+}
+
+/*
+** Mapped file writer
+*/
+bool MappedFileWriter::open(const char* fileName, size_t segmentSize)
+{
+  close();
+  file = CreateFileA(fileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  this->segmentSize = (segmentSize + SMODE_MAPPED_FILE_GRANULARITY - 1) / SMODE_MAPPED_FILE_GRANULARITY * SMODE_MAPPED_FILE_GRANULARITY;
+  written = 0;
+  if (!mapSegment(0))
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool MappedFileWriter::mapSegment(uint64_t offset)
+{
+  // a mapping larger than the file extends it
+  const uint64_t end = offset + segmentSize;
+  mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(end >> 32), (DWORD)end, NULL);
+  if (!mapping)
+    return false;
+  segment = reinterpret_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)(offset >> 32), (DWORD)offset, segmentSize));
+  if (!segment)
+  {
+    CloseHandle(mapping);
+    mapping = nullptr;
+    return false;
+  }
+  segmentOffset = offset;
+  return true;
+}
+
+void MappedFileWriter::unmapSegment()
+{
+  if (segment)
+  {
+    UnmapViewOfFile(segment);
+    segment = nullptr;
+  }
+  if (mapping)
+  {
+    CloseHandle(mapping);
+    mapping = nullptr;
+  }
+}
+
+bool MappedFileWriter::write(const void* data, size_t size)
+{
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  while (size)
+  {
+    if (written == segmentOffset + segmentSize)
+    {
+      unmapSegment();
+      if (!mapSegment(written))
+        return false;
+    }
+    const uint64_t available = segmentOffset + segmentSize - written;
+    const size_t chunk = (uint64_t)size < available ? size : (size_t)available;
+    memcpy(segment + (written - segmentOffset), bytes, chunk);
+    written += chunk;
+    bytes += chunk;
+    size -= chunk;
+  }
+  return true;
+}
+
+bool MappedFileWriter::close()
+{
+  if (file == INVALID_HANDLE_VALUE)
+    return true;
+  unmapSegment();
+  LARGE_INTEGER size;
+  size.QuadPart = (LONGLONG)written;
+  const bool res = SetFilePointerEx(file, size, NULL, FILE_BEGIN) && SetEndOfFile(file);
+  CloseHandle(file);
+  file = INVALID_HANDLE_VALUE;
+  return res;
+}
+
+bool MappedFileWriter::isOpen() const
+  {return file != INVALID_HANDLE_VALUE;}
+
+/*
+** Handle channel
+*/
+bool HandleChannel::create()
+{
+  close();
+  SECURITY_ATTRIBUTES securityAttributes = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+  if (!CreatePipe(&childEnd, &parentEnd, &securityAttributes, 0))
+    return false;
+  SetHandleInformation(parentEnd, HANDLE_FLAG_INHERIT, 0);
+  snprintf(childArgument, sizeof(childArgument), "%llu", (unsigned long long)(uintptr_t)childEnd);
+  return true;
+}
+
+void HandleChannel::closeChildEnd()
+{
+  if (childEnd)
+  {
+    CloseHandle(childEnd);
+    childEnd = nullptr;
+  }
+}
+
+bool HandleChannel::send(const Process& child, const NativeHandle* handles, uint32_t count)
+{
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    HANDLE remoteHandle = nullptr;
+    if (handles[i] && !DuplicateHandle(GetCurrentProcess(), handles[i], child.process, &remoteHandle, 0, FALSE, DUPLICATE_SAME_ACCESS))
+      return false;
+    uint64_t value = (uint64_t)(uintptr_t)remoteHandle;
+    DWORD written = 0;
+    if (!WriteFile(parentEnd, &value, sizeof(value), &written, NULL) || written != sizeof(value))
+      return false;
+  }
+  return true;
+}
+
+bool HandleChannel::attach(const char* childArgument)
+{
+  close();
+  childEnd = (HANDLE)(uintptr_t)_strtoui64(childArgument, NULL, 10);
+  return childEnd != nullptr;
+}
+
+bool HandleChannel::receive(NativeHandle* handles, uint32_t count)
+{
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    uint64_t value = 0;
+    DWORD read = 0;
+    if (!ReadFile(childEnd, &value, sizeof(value), &read, NULL) || read != sizeof(value))
+      return false;
+    handles[i] = (HANDLE)(uintptr_t)value;
+  }
+  return true;
+}
+
+void HandleChannel::close()
+{
+  closeChildEnd();
+  if (parentEnd)
+  {
+    CloseHandle(parentEnd);
+    parentEnd = nullptr;
+  }
+  childArgument[0] = 0;
+}
+
+/*
+** Window
+*/
+static LRESULT CALLBACK windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+  switch (uMsg)
+  {
+  case WM_CREATE:
+    {
+      LPCREATESTRUCTA pCreateStruct = reinterpret_cast<LPCREATESTRUCTA>(lParam);
+      WindowListener* listener = reinterpret_cast<WindowListener*>(pCreateStruct->lpCreateParams);
+      SetWindowLongPtr(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(listener));
+      RECT rc;
+      GetClientRect(hWnd, &rc);
+      // -1 destroys the window, CreateWindowEx then fails
+      return listener->windowCreated(hWnd, rc.right - rc.left, rc.bottom - rc.top) ? 0 : -1;
+    }
+  case WM_CLOSE:
+    {
+      WindowListener* listener = reinterpret_cast<WindowListener*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+      listener->windowClosing();
+      DestroyWindow(hWnd);
+      PostQuitMessage(0);
+      return TRUE;
+    }
+  case WM_SIZE:
+    {
+      // a minimized window keeps its buffers
+      WindowListener* listener = reinterpret_cast<WindowListener*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+      if (listener && wParam != SIZE_MINIMIZED && LOWORD(lParam) && HIWORD(lParam))
+        listener->windowResized(LOWORD(lParam), HIWORD(lParam));
+      return 0;
+    }
+  case WM_DESTROY:
+    return TRUE;
+  case WM_ERASEBKGND:
+    break;
+  case WM_PAINT:
+    {
+      WindowListener* listener = reinterpret_cast<WindowListener*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+      PAINTSTRUCT ps;
+      BeginPaint(hWnd, &ps);
+      listener->windowUpdate();
+      EndPaint(hWnd, &ps);
+      return TRUE;
+    }
+  }
+
+  return DefWindowProcA(hWnd, uMsg, wParam, lParam);
+}
+
+static bool registerWindowClass(HINSTANCE hInstance, const char* className)
+{
+  static bool registered = false;
+  if (registered)
+    return true;
+
+  WNDCLASSEXA wndClass;
+  wndClass.cbSize = sizeof(WNDCLASSEXA);
+  wndClass.style = CS_HREDRAW | CS_VREDRAW;
+  wndClass.lpfnWndProc = windowProc;
+  wndClass.cbClsExtra = 0;
+  wndClass.cbWndExtra = 0;
+  wndClass.hInstance = hInstance;
+  wndClass.hIcon = LoadIcon(NULL, IDI_APPLICATION);
+  wndClass.hCursor = LoadCursor(NULL, IDC_ARROW);
+  wndClass.hbrBackground = (HBRUSH)GetStockObject(BLACK_BRUSH);
+  wndClass.lpszMenuName = NULL;
+  wndClass.lpszClassName = className;
+  wndClass.hIconSm = LoadIcon(NULL, IDI_WINLOGO);
+  registered = RegisterClassExA(&wndClass) != 0;
+  return registered;
+}
+
+bool smode::runWindow(const char* title, UINT width, UINT height, WindowListener* listener)
+{
+  HINSTANCE hInstance = GetModuleHandle(NULL);
+  if (!registerWindowClass(hInstance, title))
+    return false;
+
+  DWORD dwExStyle = WS_EX_APPWINDOW | WS_EX_WINDOWEDGE;
+  DWORD dwStyle = WS_OVERLAPPEDWINDOW | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+
+  RECT windowRect;
+  windowRect.left = 0;
+  windowRect.right = width;
+  windowRect.top = 0;
+  windowRect.bottom = height;
+  AdjustWindowRectEx(&windowRect, dwStyle, FALSE, dwExStyle);
+
+  HWND hWnd = CreateWindowExA(dwExStyle, title, title, dwStyle | WS_CLIPSIBLINGS | WS_CLIPCHILDREN,
+    CW_USEDEFAULT, CW_USEDEFAULT, windowRect.right - windowRect.left, windowRect.bottom - windowRect.top,
+    NULL, NULL, hInstance, listener);
+  if (!hWnd)
+    return false;
+
+  ShowWindow(hWnd, SW_SHOW);
+  SetForegroundWindow(hWnd);
+  SetFocus(hWnd);
+
+  bool running = true;
+  MSG msg;
+  while (running)
+  {
+    if (PeekMessage(&msg, 0, 0, 0, PM_NOREMOVE))
+    {
+      if (GetMessage(&msg, 0, 0, 0))
+      {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+      }
+      else
+        running = false;
+    }
+    else
+    {
+      listener->windowUpdate();
+      ValidateRect(hWnd, NULL);
+    }
+  }
+  return true;
+}
+
+static WindowListener* headlessListener = nullptr;
+static bool headlessRunning = false;
+
+bool smode::runHeadless(UINT width, UINT height, WindowListener* listener)
+{
+  if (!listener->windowCreated(nullptr, width, height))
+    return false;
+  headlessListener = listener;
+  headlessRunning = true;
+  while (headlessRunning)
+    listener->windowUpdate();
+  headlessListener = nullptr;
+  return true;
+}
+
+void smode::setWindowTitle(HWND hWnd, const char* title)
+{
+  if (hWnd)
+    SetWindowTextA(hWnd, title);
+}
+
+void smode::closeWindow(HWND hWnd)
+{
+  if (hWnd)
+    SendMessage(hWnd, WM_CLOSE, 0, 0);
+  else if (headlessRunning)
+  {
+    headlessRunning = false;
+    headlessListener->windowClosing();
+  }
+}
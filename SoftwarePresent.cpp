@@ -0,0 +1,223 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : SoftwarePresent.cpp          | Headless present backend into host |
+| Author   : Alexandre Buge               | memory                             |
+| Started  : 16/10/2026 18:05             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "SoftwarePresent.h"
+#include "ColorConvert.h"
+#include "SmodeErrorAndAssert.h"
+#include "Trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SOFTWARE_PRESENT_DEFAULT_REFRESH_RATE 60
+
+bool SoftwarePresent::Init(DX12SharedData* pSharedData)
+{
+  this->pSharedData = pSharedData;
+  config = pSharedData->ReadConfig();
+  // every format is supported, nothing to negotiate
+  if (config.format >= NUM_SHARED_FORMATS)
+  {
+    fprintf(stderr, "SoftwarePresent: unknown shared buffer format %u.\n", config.format);
+    return false;
+  }
+
+  buffers = std::vector<Buffer>(pSharedData->numSharedBuffers);
+  for (UINT i = 0; i < pSharedData->numSharedBuffers; ++i)
+  {
+    pSharedData->Buffer(i).sharedFenceHandle = SMODE_INVALID_NATIVE_HANDLE; // the fence lives in the buffer
+    pSharedData->Buffer(i).sharedFenceValue = 0;
+  }
+  if (!allocateBuffers())
+    return false;
+
+  const UINT refreshRate = config.refreshRate ? config.refreshRate : SOFTWARE_PRESENT_DEFAULT_REFRESH_RATE;
+  refreshPeriod = smode::getTicksPerSecond() / refreshRate;
+  firstVBlank = smode::getTicks();
+  gpuTimeline.init(&gpuClock, &pSharedData->presentQueue, nullptr); // already traced on the presenter thread
+
+  interrupted = false;
+  frameIndex = 0;
+  numFrames = 0;
+  hash = 0xcbf29ce484222325ULL;
+  pSharedData->currentBufferIndex = frameIndex;
+  if (FrameCapture::isNeeded(config) && !capture.start(pSharedData, this))
+    return false;
+  initialized = true;
+  return true;
+}
+
+// at the config size, the fence of each buffer starts at its current sharedFenceValue
+bool SoftwarePresent::allocateBuffers()
+{
+  const UINT bytesPerPixel = SharedFormatBytesPerPixel(config.format);
+  const size_t stride = HostBuffer::strideFor(config.width, config.height, bytesPerPixel);
+  pSharedData->sharedHeapSize = 0;
+  if (config.singleHeap)
+  {
+    if (!heap.create(stride * pSharedData->numSharedBuffers))
+    {
+      fprintf(stderr, "SoftwarePresent: cannot allocate the shared heap.\n");
+      return false;
+    }
+    pSharedData->sharedHeapSize = heap.getSize();
+  }
+  // separate from the heap, only the recording reads them
+  pSharedData->planarSize = config.recordYuvOnGpu ? colorconvert::getSize(config.width, config.height, config.recordYuvFormat) : 0;
+
+  for (UINT i = 0; i < pSharedData->numSharedBuffers; ++i)
+  {
+    Buffer& buffer = buffers[i];
+    DX12SharedBuffer& sharedBuffer = pSharedData->Buffer(i);
+    buffer.hostBuffer = nullptr;
+    if (config.singleHeap)
+    {
+      sharedBuffer.sharedMemHandle = heap.getNativeHandle();
+      sharedBuffer.sharedMemOffset = stride * i;
+      buffer.hostBuffer = HostBuffer::construct(reinterpret_cast<uint8_t*>(heap.getData()) + sharedBuffer.sharedMemOffset, config.width, config.height, config.format, bytesPerPixel);
+    }
+    else
+    {
+      if (!buffer.memory.create(HostBuffer::sizeFor(config.width, config.height, bytesPerPixel)))
+      {
+        fprintf(stderr, "SoftwarePresent: cannot allocate shared buffer %u.\n", i);
+        return false;
+      }
+      sharedBuffer.sharedMemHandle = buffer.memory.getNativeHandle();
+      sharedBuffer.sharedMemOffset = 0;
+      buffer.hostBuffer = HostBuffer::construct(buffer.memory.getData(), config.width, config.height, config.format, bytesPerPixel);
+    }
+    buffer.hostBuffer->completedFenceValue = sharedBuffer.sharedFenceValue;
+
+    sharedBuffer.planarMemHandle = SMODE_INVALID_NATIVE_HANDLE;
+    if (!pSharedData->planarSize)
+      buffer.planar.close();
+    else if (buffer.planar.create((size_t)pSharedData->planarSize))
+      sharedBuffer.planarMemHandle = buffer.planar.getNativeHandle();
+    else
+    {
+      fprintf(stderr, "SoftwarePresent: cannot allocate planar buffer %u.\n", i);
+      return false;
+    }
+  }
+  frame.assign((size_t)config.width * bytesPerPixel * config.height, 0);
+  planarFrame.assign((size_t)pSharedData->planarSize, 0);
+  return true;
+}
+
+// every frame is presented and signaled, the producer keeps its mapping of the old buffers until it re-imports
+bool SoftwarePresent::Resize()
+{
+  if (!initialized)
+    return false;
+  config = pSharedData->ReadConfig();
+  return allocateBuffers();
+}
+
+void SoftwarePresent::Cleanup()
+{
+  if (initialized && config.hashFrames)
+    printf("SoftwarePresent: %llu frame(s), hash %016llx\n", (unsigned long long)numFrames, (unsigned long long)hash);
+  initialized = false;
+  capture.stop();
+
+  interrupted = true;
+  for (Buffer& buffer : buffers)
+    if (buffer.hostBuffer)
+      buffer.hostBuffer->interrupt();
+  buffers.clear(); // the producer has detached, unmapping is safe
+  heap.close();
+  frame.clear();
+  planarFrame.clear();
+}
+
+bool SoftwarePresent::Render()
+{
+  if (!Render(frameIndex))
+    return false;
+
+  // no swap chain, back buffers rotate in order
+  frameIndex = (frameIndex + 1) % pSharedData->numSharedBuffers;
+  pSharedData->currentBufferIndex = frameIndex;
+  return true;
+}
+
+bool SoftwarePresent::Render(UINT bufferIndex)
+{
+  HostBuffer* hostBuffer = buffers[bufferIndex].hostBuffer;
+  UINT64& sharedFenceValue = pSharedData->Buffer(bufferIndex).sharedFenceValue;
+  FrameLatencySample latency = { pSharedData->Buffer(bufferIndex).SubmitTicks(sharedFenceValue), smode::getTicks(), 0, 0, 0 };
+  const UINT64 frameId = pSharedData->Buffer(bufferIndex).frameId.load(std::memory_order_relaxed);
+
+  {
+    TRACE_SCOPE_VALUE("FenceWait", "fence", sharedFenceValue);
+    if (!hostBuffer->wait(sharedFenceValue, interrupted))
+      return false;
+  }
+
+  latency.renderedTicks = smode::getTicks();
+  {
+    TRACE_SCOPE("Copy");
+    const size_t rowSize = (size_t)config.width * SharedFormatBytesPerPixel(config.format);
+    const uint8_t* src = hostBuffer->getPixels();
+    uint8_t* dst = frame.data();
+    for (UINT y = 0; y < config.height; ++y, src += hostBuffer->pitch, dst += rowSize)
+      memcpy(dst, src, rowSize);
+    if (!planarFrame.empty())
+      memcpy(planarFrame.data(), buffers[bufferIndex].planar.getData(), planarFrame.size());
+  }
+
+  latency.copiedTicks = smode::getTicks();
+  gpuTimeline.report(frameId, latency.acquireTicks, (uint64_t)latency.renderedTicks, (uint64_t)latency.copiedTicks);
+
+  // the copy is done, the producer may render into the buffer again
+  hostBuffer->signal(++sharedFenceValue);
+
+  if (config.hashFrames)
+  {
+    // FNV-1a over 64 bits words, an odd width leaves one last pixel
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(frame.data());
+    const size_t count = frame.size() / 8;
+    for (size_t i = 0; i < count; ++i)
+      hash = (hash ^ words[i]) * 0x100000001b3ULL;
+    if (frame.size() % 8)
+    {
+      uint32_t last;
+      memcpy(&last, frame.data() + count * 8, sizeof(last));
+      hash = (hash ^ last) * 0x100000001b3ULL;
+    }
+  }
+
+  const int captureSlot = capture.acquire(numFrames);
+  if (captureSlot >= 0)
+  {
+    TRACE_SCOPE("CaptureCopy");
+    // the slot is free, the writer thread is done with its previous frame
+    captureSlots[captureSlot].assign(frame.begin(), frame.end());
+    captureSlots[captureSlot].insert(captureSlots[captureSlot].end(), planarFrame.begin(), planarFrame.end());
+    capture.submit(captureSlot, numFrames, frameId, 0, config.width, config.height, config.width * SharedFormatBytesPerPixel(config.format), config.format,
+                   planarFrame.empty() ? 0 : (uint32_t)frame.size());
+  }
+
+  ++numFrames;
+
+  if (config.vsync)
+  {
+    TRACE_SCOPE("VSync");
+    // next virtual vertical blank, a late frame waits for the following one like a real flip
+    const int64_t now = smode::getTicks();
+    const int64_t vblank = firstVBlank + ((now - firstVBlank) / refreshPeriod + 1) * refreshPeriod;
+    smode::sleepUntil(vblank);
+    latency.presentedTicks = vblank;
+  }
+  else
+    latency.presentedTicks = smode::getTicks();
+  pSharedData->latency.record(latency);
+  return true;
+}
+
+AbstractPresent* newSoftwarePresent()
+  {return new SoftwarePresent();}
@@ -0,0 +1,75 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : SoftwarePresent.h            | Headless present backend into host |
+| Author   : Alexandre Buge               | memory                             |
+| Started  : 16/10/2026 18:05             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _SOFTWARE_PRESENT_H_
+#define _SOFTWARE_PRESENT_H_
+
+#include "DX12SharedData.h" // for AbstractPresent
+#include "FrameCapture.h"
+#include "GpuTimeline.h"
+#include "HostBuffer.h"
+#include "SmodePlatform.h"
+#include <atomic>
+#include <vector>
+
+/*
+** Allocates the shared buffers as HostBuffers and copies the presented one into a host
+** frame, no display and no GPU. With config.vsync, presents are paced to a virtual vertical
+** blank at config.refreshRate. config.hashFrames folds every presented frame into a hash
+** printed at Cleanup, captured, validated and recorded frames are copied into host readback
+** slots handed to FrameCapture. With config.recordYuvOnGpu each buffer also gets a planar host
+** buffer the producer converts its frame into, copied along with the pixels.
+** The fence wait and the copy stand for the present queue GPU timings, the virtual vertical
+** blank for the flip of the frame latency.
+*/
+class SoftwarePresent : public AbstractPresent, private FrameCapture::Readback
+{
+public:
+  ~SoftwarePresent()
+    {Cleanup();}
+
+  bool Init(DX12SharedData* pSharedData) override;
+  void Cleanup() override;
+  bool Render() override;
+  bool Render(UINT bufferIndex) override;
+  bool Resize() override;
+
+private:
+  struct Buffer
+  {
+    smode::SharedMemory memory;
+    smode::SharedMemory planar; // pSharedData->planarSize, raw colorconvert layout without fence
+    HostBuffer* hostBuffer = nullptr;
+  };
+  std::vector<Buffer> buffers; // one per shared buffer
+  smode::SharedMemory heap;    // config.singleHeap, holds every host buffer instead of their own memory
+  std::vector<uint8_t> frame;  // last presented frame, tightly packed in config.format
+  std::vector<uint8_t> planarFrame; // its planar buffer, empty without
+  std::vector<uint8_t> captureSlots[FRAME_CAPTURE_RING_SIZE];
+  FrameCapture capture;
+
+  bool allocateBuffers();
+
+  // FrameCapture::Readback, the frame is copied when submitted
+  bool waitCopy(uint32_t, uint64_t) override
+    {return true;}
+  const uint8_t* getPixels(uint32_t slot) override
+    {return captureSlots[slot].data();}
+
+  DX12SharedData* pSharedData = nullptr;
+  DX12SharedConfig config = {}; // snapshot taken at Init
+  std::atomic<bool> interrupted{false};
+  HostClock gpuClock;
+  GpuTimeline gpuTimeline;
+  int64_t refreshPeriod = 0; // ticks
+  int64_t firstVBlank = 0;
+  UINT frameIndex = 0;
+  UINT64 numFrames = 0;
+  uint64_t hash = 0;
+  bool initialized = false;
+};
+
+#endif // _SOFTWARE_PRESENT_H_
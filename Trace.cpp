@@ -0,0 +1,213 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : Trace.cpp                    | Hot path tracing, Chrome trace     |
+| Author   : Alexandre Buge               | export                             |
+| Started  : 16/10/2026 20:30             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#include "Trace.h"
+#include "SmodePlatform.h" // for getTicks
+
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+namespace trace
+{
+
+std::atomic<bool> enabled{false};
+
+static const uint32_t ringCapacity = 1 << 15; // power of two, events per thread
+
+struct Event
+{
+  const char* name;
+  const char* argName;
+  int64_t begin;
+  int64_t end; // 0 for a counter
+  uint64_t argValue;
+};
+
+struct Ring
+{
+  uint32_t threadId;
+  char threadName[32];
+  bool retired; // its thread exited, the next new thread takes it over and keeps its events
+  bool track;   // not owned by a thread
+  std::atomic<uint64_t> head{0}; // written by the owner thread only
+  Event events[ringCapacity];
+};
+
+static std::mutex ringsMutex; // ring creation, retirement and write() only
+static std::vector<Ring*> rings;
+
+// rings are never freed, memory is bounded by the number of threads alive at once
+struct RingOwner
+{
+  Ring* ring = nullptr;
+  ~RingOwner()
+  {
+    if (ring)
+    {
+      std::lock_guard<std::mutex> lock(ringsMutex);
+      ring->retired = true;
+    }
+  }
+};
+static thread_local RingOwner threadRing;
+
+static int64_t traceEpoch = 0;
+static double ticksToMicroseconds = 0.0;
+static uint32_t traceProcessId = 1;
+static char traceProcessName[32] = { 0, };
+
+static Ring* getThreadRing()
+{
+  if (!threadRing.ring)
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (Ring* ring : rings)
+      if (ring->retired && !ring->track)
+      {
+        ring->retired = false;
+        threadRing.ring = ring;
+        return ring;
+      }
+    Ring* ring = new Ring();
+    ring->threadId = (uint32_t)rings.size() + 1;
+    snprintf(ring->threadName, sizeof(ring->threadName), "thread %u", ring->threadId);
+    ring->retired = false;
+    ring->track = false;
+    rings.push_back(ring);
+    threadRing.ring = ring;
+  }
+  return threadRing.ring;
+}
+
+Track getTrack(const char* name)
+{
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  for (Ring* ring : rings)
+    if (ring->track && !strcmp(ring->threadName, name))
+      return ring;
+  Ring* ring = new Ring();
+  ring->threadId = (uint32_t)rings.size() + 1;
+  snprintf(ring->threadName, sizeof(ring->threadName), "%s", name);
+  ring->retired = false;
+  ring->track = true;
+  rings.push_back(ring);
+  return ring;
+}
+
+static void push(Ring* ring, const Event& event)
+{
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+  ring->events[head & (ringCapacity - 1)] = event;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void start(int64_t epoch, uint32_t processId, const char* processName)
+{
+  traceEpoch = epoch;
+  ticksToMicroseconds = 1e6 / (double)smode::getTicksPerSecond();
+  traceProcessId = processId;
+  snprintf(traceProcessName, sizeof(traceProcessName), "%s", processName);
+  enabled.store(true, std::memory_order_relaxed);
+}
+
+void stop()
+  {enabled.store(false, std::memory_order_relaxed);}
+
+int64_t getEpoch()
+  {return traceEpoch;}
+
+void setThreadName(const char* name)
+{
+  Ring* ring = getThreadRing();
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  snprintf(ring->threadName, sizeof(ring->threadName), "%s", name);
+}
+
+int64_t now()
+  {return isEnabled() ? smode::getTicks() : 0;}
+
+void complete(const char* name, int64_t beginTicks, int64_t endTicks, const char* argName, uint64_t argValue)
+  {push(getThreadRing(), Event{ name, argName, beginTicks, endTicks, argValue });}
+
+void counter(const char* name, uint64_t value)
+  {push(getThreadRing(), Event{ name, nullptr, smode::getTicks(), 0, value });}
+
+void complete(Track track, const char* name, int64_t beginTicks, int64_t endTicks, const char* argName, uint64_t argValue)
+  {push(track, Event{ name, argName, beginTicks, endTicks, argValue });}
+
+static void writeEvents(FILE* file, bool& first)
+{
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  const char* separator = first ? "" : ",\n";
+  fprintf(file, "%s{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %u, \"args\": {\"name\": \"%s\"}}", separator, traceProcessId, traceProcessName);
+  first = false;
+  for (Ring* ring : rings)
+  {
+    fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %u, \"tid\": %u, \"args\": {\"name\": \"%s\"}}", traceProcessId, ring->threadId, ring->threadName);
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    const uint64_t oldest = head > ringCapacity ? head - ringCapacity : 0;
+    for (uint64_t i = oldest; i < head; ++i)
+    {
+      const Event& event = ring->events[i & (ringCapacity - 1)];
+      const double ts = (double)(event.begin - traceEpoch) * ticksToMicroseconds;
+      if (!event.end)
+        fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"C\", \"pid\": %u, \"tid\": %u, \"ts\": %.3f, \"args\": {\"value\": %llu}}",
+          event.name, traceProcessId, ring->threadId, ts, (unsigned long long)event.argValue);
+      else if (event.argName)
+        fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %u, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"%s\": %llu}}",
+          event.name, traceProcessId, ring->threadId, ts, (double)(event.end - event.begin) * ticksToMicroseconds, event.argName, (unsigned long long)event.argValue);
+      else
+        fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %u, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+          event.name, traceProcessId, ring->threadId, ts, (double)(event.end - event.begin) * ticksToMicroseconds);
+    }
+  }
+}
+
+bool write(const char* fileName, const char* mergedFileName)
+{
+  FILE* file = fopen(fileName, "w");
+  if (!file)
+  {
+    fprintf(stderr, "Cannot open %s.\n", fileName);
+    return false;
+  }
+  fprintf(file, "[\n");
+  bool first = true;
+  writeEvents(file, first);
+
+  FILE* merged = mergedFileName ? fopen(mergedFileName, "r") : nullptr;
+  if (merged)
+  {
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), merged)) > 0)
+      fwrite(buffer, 1, size, file);
+    fclose(merged);
+  }
+  fprintf(file, "\n]\n");
+
+  const bool res = !ferror(file);
+  fclose(file);
+  if (!res)
+    fprintf(stderr, "Cannot write %s.\n", fileName);
+  return res;
+}
+
+bool appendTo(const char* fileName)
+{
+  FILE* file = fopen(fileName, "a");
+  if (!file)
+    return false;
+  bool first = false; // always follows the events of the writing process
+  writeEvents(file, first);
+  const bool res = !ferror(file);
+  fclose(file);
+  return res;
+}
+
+}; /* namespace trace */
@@ -0,0 +1,71 @@
+/* -------------------------------------- . ---------------------------------- .
+| Filename : Trace.h                      | Hot path tracing, Chrome trace     |
+| Author   : Alexandre Buge               | export                             |
+| Started  : 16/10/2026 20:30             |                                    |
+` --------------------------------------- . --------------------------------- */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+** Every thread writes its events into its own ring, no lock nor allocation once the ring
+** exists. A full ring overwrites its oldest events, the file keeps the end of the run.
+** Names are string literals, only their pointer is stored.
+** Timestamps come from smode::getTicks(), a system wide clock: processes tracing against the
+** same epoch land on the same timeline.
+*/
+namespace trace
+{
+
+void start(int64_t epoch, uint32_t processId, const char* processName);
+void stop(); // recording only, events stay until written
+int64_t getEpoch();
+
+// Chrome trace JSON array, and the event lines of another process appended by appendTo
+bool write(const char* fileName, const char* mergedFileName);
+bool appendTo(const char* fileName); // event lines only, for write() to merge
+
+void setThreadName(const char* name);
+
+void complete(const char* name, int64_t beginTicks, int64_t endTicks, const char* argName, uint64_t argValue);
+void counter(const char* name, uint64_t value);
+
+// timeline that is not a thread (a GPU queue), written by one thread at a time
+typedef struct Ring* Track;
+Track getTrack(const char* name); // the same name gives the same track
+void complete(Track track, const char* name, int64_t beginTicks, int64_t endTicks, const char* argName, uint64_t argValue);
+
+extern std::atomic<bool> enabled;
+
+inline bool isEnabled()
+  {return enabled.load(std::memory_order_relaxed);}
+
+int64_t now(); // smode::getTicks(), 0 when disabled
+
+class Scope
+{
+public:
+  Scope(const char* name, const char* argName = nullptr, uint64_t argValue = 0)
+    : name(name), argName(argName), argValue(argValue), begin(now()) {}
+  ~Scope()
+    {if (begin) complete(name, begin, now(), argName, argValue);}
+
+private:
+  const char* name;
+  const char* argName;
+  uint64_t argValue;
+  int64_t begin;
+};
+
+}; /* namespace trace */
+
+#define TRACE_CONCATENATE_(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_(a, b)
+#define TRACE_SCOPE(name) trace::Scope TRACE_CONCATENATE(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_VALUE(name, argName, argValue) trace::Scope TRACE_CONCATENATE(traceScope, __LINE__)(name, argName, argValue)
+#define TRACE_COUNTER(name, value) do { if (trace::isEnabled()) trace::counter(name, value); } while (false)
+
+#endif // _TRACE_H_
@@ -9,9 +9,21 @@
 #include "SmodeErrorAndAssert.h"
 #include <vector>
 #include "VkRender.h"
+#include "SmodePlatform.h" // for getTicks, replaceFile
+#include "ColorConvert.h"
+#include "FrameCompare.h" // for hash
+
+// SPIR-V of VkRender.vert, VkRender.frag and VkRenderConvert.comp, built by EmbedSpirv.cmake
+#include "VkRender.vert.h"
+#include "VkRender.frag.h"
+#include "VkRenderConvert.comp.h"
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 
+#define PIPELINE_CACHE_FILE_MAGIC 0x43505653 // "SVPC"
+#define PIPELINE_CACHE_FILE_VERSION 1
+#define PIPELINE_CACHE_FILE_MAX_SIZE (256u << 20)
+
 static inline void matrix_multiply(Mat4x4 m, Mat4x4 a, Mat4x4 b)
 {
     for (int i = 0; i < 4; i++) {
@@ -111,7 +123,7 @@ static uint32_t getMemoryTypeIndex(const VkPhysicalDeviceMemoryProperties& memor
     return VK_MAX_MEMORY_TYPES;
 }
 
-static VkShaderModule createShaderModule(VkDevice device, const void *code, size_t size)
+static VkShaderModule createShaderModule(VkDevice device, const uint32_t *code, size_t size)
 {
     VkShaderModule module;
     VkResult err;
@@ -119,7 +131,7 @@ static VkShaderModule createShaderModule(VkDevice device, const void *code, size
     VkShaderModuleCreateInfo shaderModuleCreateInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
 
     shaderModuleCreateInfo.codeSize = size;
-    shaderModuleCreateInfo.pCode = (const uint32_t*)code;
+    shaderModuleCreateInfo.pCode = code;
     shaderModuleCreateInfo.flags = 0;
     err = vkCreateShaderModule(device, &shaderModuleCreateInfo, NULL, &module);
     assert(!err);
@@ -127,6 +139,28 @@ static VkShaderModule createShaderModule(VkDevice device, const void *code, size
     return module;
 }
 
+uint64_t VkGpuClock::getTimestampFrequency()
+{
+    return timestampPeriod > 0.f ? (uint64_t)(1e9 / timestampPeriod) : 0;
+}
+
+bool VkGpuClock::getCalibration(uint64_t& gpuTimestamp, int64_t& cpuTicks)
+{
+    VkCalibratedTimestampInfoEXT timestampInfos[2] = { { VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT },
+                                                       { VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT } };
+    timestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    timestampInfos[1].timeDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+
+    uint64_t timestamps[2];
+    uint64_t maxDeviation;
+    if (vkGetCalibratedTimestampsEXT(device, 2, timestampInfos, timestamps, &maxDeviation) != VK_SUCCESS)
+        return false;
+
+    gpuTimestamp = timestamps[0];
+    cpuTicks = (int64_t)timestamps[1];
+    return true;
+}
+
 VkRender::VkRender()
 {
 }
@@ -136,9 +170,26 @@ VkRender::~VkRender()
     Cleanup();
 }
 
+// same memory layout as the DXGI format of DX12Present
+static VkFormat SharedImageFormat(UINT format)
+{
+    switch (format) {
+    case SHARED_FORMAT_RGBA8_SRGB:  return VK_FORMAT_R8G8B8A8_SRGB;
+    case SHARED_FORMAT_BGRA8:       return VK_FORMAT_B8G8R8A8_UNORM;
+    case SHARED_FORMAT_BGRA8_SRGB:  return VK_FORMAT_B8G8R8A8_SRGB;
+    case SHARED_FORMAT_RGB10A2:     return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+    case SHARED_FORMAT_RGBA16F:     return VK_FORMAT_R16G16B16A16_SFLOAT;
+    default:                        return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
 bool VkRender::Init(DX12SharedData* pSharedData)
 {
     m_pSharedData = pSharedData;
+    m_config = pSharedData->ReadConfig();
+    m_format = SharedImageFormat(m_config.format);
+    const int64_t initTicks = smode::getTicks();
+    m_pipelineTicks = 0;
 
     VkResult err;
     VkInstanceCreateInfo instanceCreateInfo = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
@@ -163,7 +214,7 @@ bool VkRender::Init(DX12SharedData* pSharedData)
 
             vkGetPhysicalDeviceProperties2(physical_devices[i], &physicalDeviceProperties2);
 
-            if (!memcmp(physicalDeviceIDProperties.deviceLUID, &m_pSharedData->AdapterLuid, VK_LUID_SIZE)) {
+            if (!memcmp(physicalDeviceIDProperties.deviceLUID, &m_config.AdapterLuid, VK_LUID_SIZE)) {
                 physicalDevice = physical_devices[i];
                 break;
             }
@@ -180,37 +231,46 @@ bool VkRender::Init(DX12SharedData* pSharedData)
     vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
 
     VkPhysicalDeviceExternalImageFormatInfo externalImageFormatInfo = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO };
-    externalImageFormatInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT;
+    externalImageFormatInfo.handleType = m_config.singleHeap ? VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_HEAP_BIT : VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT;
 
     VkPhysicalDeviceImageFormatInfo2 imageFormatInfo = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2, &externalImageFormatInfo };
     imageFormatInfo.format  = m_format;
     imageFormatInfo.type    = VK_IMAGE_TYPE_2D;
     imageFormatInfo.tiling  = VK_IMAGE_TILING_OPTIMAL;
-    imageFormatInfo.usage   = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    imageFormatInfo.usage   = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (m_config.recordYuvOnGpu ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
     imageFormatInfo.flags   = 0;
 
     VkExternalImageFormatProperties externalImageFormatProperties = { VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES };
     VkImageFormatProperties2 imageFormatProperties = { VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2, &externalImageFormatProperties };
 
+    // the format negotiated by the presenter must also be importable and renderable here
     err = vkGetPhysicalDeviceImageFormatProperties2(physicalDevice, &imageFormatInfo, &imageFormatProperties);
     if ((err == VK_ERROR_FORMAT_NOT_SUPPORTED) ||
         !(externalImageFormatProperties.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT)) {
-        fprintf(stderr, "Vulkan: D3D12 memory import not supported.\n");
+        fprintf(stderr, "Vulkan: D3D12 memory import of %s images not supported.\n", SharedFormatName(m_config.format));
         return false;
     }
     assert(!err);
 
+    // the D3D12 fence payload is a 64 bits value either way, a timeline semaphore also waits on it from the CPU
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue = 0;
+
     VkPhysicalDeviceExternalSemaphoreInfo externalSemaphoreInfo = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO };
+    externalSemaphoreInfo.pNext = m_config.timelineSemaphores ? &semaphoreTypeCreateInfo : NULL;
     externalSemaphoreInfo.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_D3D12_FENCE_BIT;
 
     VkExternalSemaphoreProperties externalSemaphoreProperties = { VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES };
     vkGetPhysicalDeviceExternalSemaphoreProperties(physicalDevice, &externalSemaphoreInfo, &externalSemaphoreProperties);
 
     if (!(externalSemaphoreProperties.externalSemaphoreFeatures & VK_EXTERNAL_SEMAPHORE_FEATURE_IMPORTABLE_BIT)) {
-        fprintf(stderr, "Vulkan: Import of VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_D3D12_FENCE_BIT not supported.\n");
+        fprintf(stderr, "Vulkan: Import of VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_D3D12_FENCE_BIT%s not supported.\n", m_config.timelineSemaphores ? " as timeline semaphore" : "");
         return false;
     }
     uint32_t enabled_device_extensions = 0;
+    bool calibratedTimestamps = false; // optional, for GPU timings
+    bool timelineSemaphores = false;   // config.timelineSemaphores
     const char* required_device_extensions[] = {
         VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME,
         VK_KHR_EXTERNAL_SEMAPHORE_WIN32_EXTENSION_NAME,
@@ -231,6 +291,14 @@ bool VkRender::Init(DX12SharedData* pSharedData)
             }
         }
     }
+    for (uint32_t j = 0; j < device_extension_count; j++) {
+        if (!strcmp(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME, device_extensions[j].extensionName)) {
+            calibratedTimestamps = true;
+        }
+        if (!strcmp(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, device_extensions[j].extensionName)) {
+            timelineSemaphores = true;
+        }
+    }
 
     free(device_extensions);
 
@@ -239,6 +307,18 @@ bool VkRender::Init(DX12SharedData* pSharedData)
         return false;
     }
 
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+    if (m_config.timelineSemaphores) {
+        VkPhysicalDeviceFeatures2 physicalDeviceFeatures2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &timelineSemaphoreFeatures };
+        if (timelineSemaphores) {
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &physicalDeviceFeatures2);
+        }
+        if (!timelineSemaphoreFeatures.timelineSemaphore) {
+            fprintf(stderr, "Vulkan: VK_KHR_timeline_semaphore not supported.\n");
+            return false;
+        }
+    }
+
     uint32_t queueCount;
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, NULL);
     assert(queueCount >= 1);
@@ -248,11 +328,20 @@ bool VkRender::Init(DX12SharedData* pSharedData)
     queueCreateInfo.queueCount = 1;
     queueCreateInfo.pQueuePriorities = queuePriorities;
 
+    std::vector<const char*> device_extension_names(required_device_extensions, required_device_extensions + ARRAY_SIZE(required_device_extensions));
+    if (calibratedTimestamps) {
+        device_extension_names.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    }
+    if (m_config.timelineSemaphores) {
+        device_extension_names.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
+
     VkDeviceCreateInfo deviceCreateInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+    deviceCreateInfo.pNext = m_config.timelineSemaphores ? &timelineSemaphoreFeatures : NULL; // timelineSemaphore is VK_TRUE
     deviceCreateInfo.queueCreateInfoCount = 1;
     deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
-    deviceCreateInfo.enabledExtensionCount = enabled_device_extensions;
-    deviceCreateInfo.ppEnabledExtensionNames = required_device_extensions;
+    deviceCreateInfo.enabledExtensionCount = (uint32_t)device_extension_names.size();
+    deviceCreateInfo.ppEnabledExtensionNames = device_extension_names.data();
 
     err = vkCreateDevice(physicalDevice, &deviceCreateInfo, NULL, &m_device);
     if (err) {
@@ -267,60 +356,38 @@ bool VkRender::Init(DX12SharedData* pSharedData)
         fprintf(stderr, "Vulkan: Proc address for \"vkImportSemaphoreWin32HandleKHR\" not found.\n");
         return false;
     }
+    if (m_config.timelineSemaphores) {
+        vkWaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(m_device, "vkWaitSemaphoresKHR");
+        if (vkWaitSemaphoresKHR == NULL) {
+            fprintf(stderr, "Vulkan: Proc address for \"vkWaitSemaphoresKHR\" not found.\n");
+            return false;
+        }
+    }
+
+    // GPU timings are optional, the queue renders the same without them
+    InitTimestamps(physicalDevice, calibratedTimestamps);
 
     VkCommandPoolCreateInfo cmdPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
     cmdPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     err = vkCreateCommandPool(m_device, &cmdPoolCreateInfo, NULL, &m_cmdPool);
     assert(!err);
 
-    // define depth buffer
-    VkImageCreateInfo depthImageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
-    depthImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-    depthImageCreateInfo.format = VK_FORMAT_D16_UNORM;
-    depthImageCreateInfo.extent = {(uint32_t)m_pSharedData->width, (uint32_t)m_pSharedData->height, (uint32_t)1};
-    depthImageCreateInfo.mipLevels = 1;
-    depthImageCreateInfo.arrayLayers = 1;
-    depthImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    depthImageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    depthImageCreateInfo.flags = 0;
+    if (!CreateDepthBuffer()) {
+        return false;
+    }
 
     VkMemoryRequirements mem_reqs;
 
-    err = vkCreateImage(m_device, &depthImageCreateInfo, NULL, &m_depthImage);
-    assert(!err);
-
-    vkGetImageMemoryRequirements(m_device, m_depthImage, &mem_reqs);
-    assert(!err);
-
-    VkMemoryAllocateInfo depthMemAllocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-    depthMemAllocInfo.allocationSize = mem_reqs.size;
-    depthMemAllocInfo.memoryTypeIndex = getMemoryTypeIndex(m_memoryProperties, mem_reqs.memoryTypeBits);
-
-    err = vkAllocateMemory(m_device, &depthMemAllocInfo, NULL, &m_depthMem);
-    assert(!err);
-
-    err = vkBindImageMemory(m_device, m_depthImage, m_depthMem, 0);
-    assert(!err);
-
-    VkImageViewCreateInfo depthImageViewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-    depthImageViewCreateInfo.image = VK_NULL_HANDLE;
-    depthImageViewCreateInfo.format = depthImageCreateInfo.format;
-    depthImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    depthImageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-    depthImageViewCreateInfo.subresourceRange.levelCount = 1;
-    depthImageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-    depthImageViewCreateInfo.subresourceRange.layerCount = 1;
-    depthImageViewCreateInfo.flags = 0;
-    depthImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    depthImageViewCreateInfo.image = m_depthImage;
-    err = vkCreateImageView(m_device, &depthImageViewCreateInfo, NULL, &m_depthView);
-    assert(!err);
-
     // initialize vertex daza
+    // the MVP of a frame goes to the slot of its buffer, rewritten only once the buffer fence is signaled
+    VkPhysicalDeviceProperties physicalDeviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+    const VkDeviceSize ubufAlignment = physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+    m_ubufStride = (sizeof(Mat4x4) + ubufAlignment - 1) & ~(ubufAlignment - 1);
+
     VkBufferCreateInfo ubufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
     ubufCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-    ubufCreateInfo.size = sizeof(Mat4x4);
+    ubufCreateInfo.size = m_ubufStride * m_pSharedData->numSharedBuffers;
     err = vkCreateBuffer(m_device, &ubufCreateInfo, NULL, &m_ubuf);
     assert(!err);
 
@@ -328,13 +395,18 @@ bool VkRender::Init(DX12SharedData* pSharedData)
 
     VkMemoryAllocateInfo ubufMemAllocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
     ubufMemAllocInfo.allocationSize = mem_reqs.size;
-    ubufMemAllocInfo.memoryTypeIndex = getMemoryTypeIndex(m_memoryProperties, mem_reqs.memoryTypeBits);
+    ubufMemAllocInfo.memoryTypeIndex = getMemoryTypeIndex(m_memoryProperties, mem_reqs.memoryTypeBits,
+                                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     err = vkAllocateMemory(m_device, &ubufMemAllocInfo, NULL, &m_ubufMem);
     assert(!err);
 
     err = vkBindBufferMemory(m_device, m_ubuf, m_ubufMem, 0);
     assert(!err);
 
+    // host writes before vkQueueSubmit are visible to the submission, no flush nor barrier
+    err = vkMapMemory(m_device, m_ubufMem, 0, VK_WHOLE_SIZE, 0, (void**)&m_ubufMapped);
+    assert(!err);
+
     const float verticesAndColors[] = {
         // vertices
         -1.0f,  1.0f,  1.0f,  1.f, 
@@ -416,7 +488,7 @@ bool VkRender::Init(DX12SharedData* pSharedData)
     VkDescriptorSetLayoutBinding bindings[2];
     memset(&bindings, 0, sizeof(bindings));
     bindings[0].binding = 0;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     bindings[0].descriptorCount = 1;
     bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     bindings[0].pImmutableSamplers = NULL;
@@ -450,7 +522,7 @@ bool VkRender::Init(DX12SharedData* pSharedData)
     attachmentDesc[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachmentDesc[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     attachmentDesc[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    attachmentDesc[1].format = depthImageCreateInfo.format;
+    attachmentDesc[1].format = m_depthFormat;
     attachmentDesc[1].samples = VK_SAMPLE_COUNT_1_BIT;
     attachmentDesc[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachmentDesc[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -549,43 +621,8 @@ bool VkRender::Init(DX12SharedData* pSharedData)
     multiSampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
     // create shader
-    const char vertShaderCode[] = 
-        "#version 450\n"
-        "\n"
-        "layout(binding = 0) uniform _ubuf {\n"
-        "    mat4 MVP;\n"
-        "} ubuf;\n"
-        "\n"
-        "layout(binding = 1) uniform _vbuf {\n"
-        "    vec4 position[12 * 3];\n"
-        "    vec4 color[6];\n"
-        "} vbuf;\n"
-        "\n"
-        "layout (location = 0) out vec4 color;\n"
-        "\n"
-        "void main()\n"
-        "{\n"
-        "   color = vbuf.color[gl_VertexIndex / 6];\n"
-        "   gl_Position = ubuf.MVP * vbuf.position[gl_VertexIndex];\n"
-        "\n"
-        "   // GL->VK conventions\n"
-        "   gl_Position.y = -gl_Position.y;\n"
-        "   gl_Position.z = (gl_Position.z + gl_Position.w) / 2.0;\n"
-        "}\n";
-
-    VkShaderModule vs = createShaderModule(m_device, vertShaderCode, sizeof(vertShaderCode));
-
-    const char fragShaderCode[] = 
-        "#version 450\n"
-        "\n"
-        "layout (location = 0) in vec4 color;\n"
-        "layout (location = 0) out vec4 uFragColor;\n"
-        "\n"
-        "void main() \n"
-        "{\n"
-        "    uFragColor = color;\n"
-        "}\n";
-    VkShaderModule fs = createShaderModule(m_device, fragShaderCode, sizeof(fragShaderCode));
+    VkShaderModule vs = createShaderModule(m_device, VkRender_vert_spirv, sizeof(VkRender_vert_spirv));
+    VkShaderModule fs = createShaderModule(m_device, VkRender_frag_spirv, sizeof(VkRender_frag_spirv));
 
     pipeline.stageCount = 2;
     VkPipelineShaderStageCreateInfo shaderStages[2] = { { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO }, 
@@ -599,10 +636,9 @@ bool VkRender::Init(DX12SharedData* pSharedData)
     shaderStages[1].module = fs;
     shaderStages[1].pName = "main";
 
-    VkPipelineCacheCreateInfo pipelineCache = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
-
-    err = vkCreatePipelineCache(m_device, &pipelineCache, NULL, &m_pipelineCache);
-    assert(!err);
+    if (!LoadPipelineCache(physicalDevice)) {
+        return false;
+    }
 
     pipeline.pVertexInputState = &vertexInputState;
     pipeline.pInputAssemblyState = &inputAssemblyState;
@@ -617,22 +653,26 @@ bool VkRender::Init(DX12SharedData* pSharedData)
 
     pipeline.renderPass = m_renderPass;
 
+    const int64_t pipelineTicks = smode::getTicks();
     err = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipeline, NULL, &m_pipeline);
     assert(!err);
+    m_pipelineTicks += smode::getTicks() - pipelineTicks;
 
     vkDestroyShaderModule(m_device, vs, NULL);
     vkDestroyShaderModule(m_device, fs, NULL);
 
     // initialize descriptor set
-    VkDescriptorPoolSize type_count;
-    memset(&type_count, 0, sizeof(type_count));
-    type_count.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    type_count.descriptorCount = 1;
+    VkDescriptorPoolSize type_counts[2];
+    memset(type_counts, 0, sizeof(type_counts));
+    type_counts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    type_counts[0].descriptorCount = 1;
+    type_counts[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    type_counts[1].descriptorCount = 1;
 
     VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
     descriptorPoolCreateInfo.maxSets = 1;
-    descriptorPoolCreateInfo.poolSizeCount = 1;
-    descriptorPoolCreateInfo.pPoolSizes = &type_count;
+    descriptorPoolCreateInfo.poolSizeCount = 2;
+    descriptorPoolCreateInfo.pPoolSizes = type_counts;
 
     err = vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, NULL, &m_descPool);
     assert(!err);
@@ -652,7 +692,7 @@ bool VkRender::Init(DX12SharedData* pSharedData)
     descriptorWrites[0].dstSet = m_descSet;
     descriptorWrites[0].dstBinding = 0;
     descriptorWrites[0].descriptorCount = 1;
-    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     descriptorWrites[0].pBufferInfo = &descBufferInfo[0];
 
     descriptorWrites[1].dstSet = m_descSet;
@@ -663,17 +703,27 @@ bool VkRender::Init(DX12SharedData* pSharedData)
 
     vkUpdateDescriptorSets(m_device, 2, descriptorWrites, 0, NULL);
 
-    bool useDedicatedMemory = (m_pSharedData->forceDedicatedMemory || 
-                               (externalImageFormatProperties.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_DEDICATED_ONLY_BIT));
+    m_useDedicatedMemory = (m_config.forceDedicatedMemory || 
+                            (externalImageFormatProperties.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_DEDICATED_ONLY_BIT));
+
+    m_buffer.assign(m_pSharedData->numSharedBuffers, _Buffer());
+
+    if (m_config.recordYuvOnGpu && !InitConvert()) {
+        return false;
+    }
 
     for (uint32_t i = 0; i < m_pSharedData->numSharedBuffers; i++) {
-        VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-        err = vkCreateFence(m_device, &fenceInfo, NULL, &m_buffer[i].fence);
-        assert(!err);
+        // a timeline semaphore is waited on directly, a binary one through a fence of the submission
+        if (!m_config.timelineSemaphores) {
+            VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+            err = vkCreateFence(m_device, &fenceInfo, NULL, &m_buffer[i].fence);
+            assert(!err);
+        }
 
-        m_buffer[i].sharedFenceHandle = pSharedData->sharedFenceHandle[i];
+        m_buffer[i].sharedFenceHandle = pSharedData->Buffer(i).sharedFenceHandle;
 
         VkSemaphoreCreateInfo semCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+        semCreateInfo.pNext = m_config.timelineSemaphores ? &semaphoreTypeCreateInfo : NULL;
         err = vkCreateSemaphore(m_device, &semCreateInfo, NULL, &m_buffer[i].semaphore);
         assert(!err);
 
@@ -684,179 +734,708 @@ bool VkRender::Init(DX12SharedData* pSharedData)
         err = vkImportSemaphoreWin32HandleKHR(m_device, &importSemWin32Info);
         assert(!err);
 
-        m_buffer[i].semaphoreFenceValue = 0;
-
-        m_buffer[i].sharedMemHandle = pSharedData->sharedMemHandle[i];
-
         VkCommandBufferAllocateInfo cmdAllocInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
         cmdAllocInfo.commandPool = m_cmdPool;
         cmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        cmdAllocInfo.commandBufferCount = 2;
+        cmdAllocInfo.commandBufferCount = 1;
 
-        err = vkAllocateCommandBuffers(m_device, &cmdAllocInfo, m_buffer[i].cmd);
+        err = vkAllocateCommandBuffers(m_device, &cmdAllocInfo, &m_buffer[i].cmd);
         assert(!err);
 
-        VkExternalMemoryImageCreateInfo externalMemoryImageCreateInfo = { VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO };
-        externalMemoryImageCreateInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT;
-
-        VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, &externalMemoryImageCreateInfo };
-        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-        imageCreateInfo.extent.width = m_pSharedData->width;
-        imageCreateInfo.extent.height = m_pSharedData->height;
-        imageCreateInfo.extent.depth = 1;
-        imageCreateInfo.mipLevels = 1;
-        imageCreateInfo.arrayLayers = 1;
-        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-        imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-        imageCreateInfo.flags = 0;
-        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        err = vkCreateImage(m_device, &imageCreateInfo, NULL, &m_buffer[i].image);
-        assert(!err);
-
-        VkMemoryRequirements memReqs = { };
-        vkGetImageMemoryRequirements(m_device, m_buffer[i].image, &memReqs);
-
-        uint32_t memoryTypeIndex = getMemoryTypeIndex(m_memoryProperties, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        if (memoryTypeIndex >= m_memoryProperties.memoryTypeCount) {
-            fprintf(stderr, "Vulkan: Memory doesn't support sharing.\n");
+        if (!CreateBufferImage(i)) {
             return false;
         }
 
-        VkImportMemoryWin32HandleInfoKHR importMemInfo = { VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR };
-        importMemInfo.handleType = (VkExternalMemoryHandleTypeFlagBits)externalMemoryImageCreateInfo.handleTypes;
-        importMemInfo.handle = m_buffer[i].sharedMemHandle;
+        m_buffer[i].rendered = false;
+        m_buffer[i].timestampsPending = false;
+    }
+
+    UpdateViewProjection();
+
+    //m_currentBuffer = 0;
+    //m_numFrames = 0;
+
+    // cold against warm start, compare two runs with the same -pipelinecache
+    const double millisecondsPerTick = 1000.0 / (double)smode::getTicksPerSecond();
+    printf("Vulkan: Init %.1f ms, pipelines %.1f ms, pipeline cache %s (%zu bytes)\n",
+           (double)(smode::getTicks() - initTicks) * millisecondsPerTick, (double)m_pipelineTicks * millisecondsPerTick,
+           m_pipelineCacheStatus, m_pipelineCacheLoadedSize);
+
+    m_initialized = true;
+
+    return true;
+}
 
-        VkMemoryAllocateInfo memInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &importMemInfo };
-        memInfo.allocationSize = memReqs.size;
-        memInfo.memoryTypeIndex = memoryTypeIndex;
+// config.pipelineCacheFile of a previous run on the same device and driver, an empty cache otherwise
+bool VkRender::LoadPipelineCache(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceIDProperties physicalDeviceIDProperties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+    VkPhysicalDeviceProperties2 physicalDeviceProperties2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &physicalDeviceIDProperties };
+    vkGetPhysicalDeviceProperties2(physicalDevice, &physicalDeviceProperties2);
+
+    // zeroed padding included, the key is compared as bytes up to dataSize
+    VkPipelineCacheFileHeader& key = m_pipelineCacheKey;
+    memset(&key, 0, sizeof(key));
+    key.magic = PIPELINE_CACHE_FILE_MAGIC;
+    key.version = PIPELINE_CACHE_FILE_VERSION;
+    key.vendorID = physicalDeviceProperties2.properties.vendorID;
+    key.deviceID = physicalDeviceProperties2.properties.deviceID;
+    key.driverVersion = physicalDeviceProperties2.properties.driverVersion;
+    memcpy(key.driverUUID, physicalDeviceIDProperties.driverUUID, VK_UUID_SIZE);
+    memcpy(key.pipelineCacheUUID, physicalDeviceProperties2.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    std::vector<uint8_t> data;
+    uint64_t dataHash = 0;
+    m_pipelineCacheStatus = m_config.pipelineCacheFile[0] ? "missing" : "disabled";
+    FILE* file = m_config.pipelineCacheFile[0] ? fopen(m_config.pipelineCacheFile, "rb") : NULL;
+    if (file) {
+        VkPipelineCacheFileHeader header;
+        m_pipelineCacheStatus = "rejected";
+        if ((fread(&header, sizeof(header), 1, file) == 1) &&
+            !memcmp(&header, &key, offsetof(VkPipelineCacheFileHeader, dataSize)) &&
+            (header.dataSize >= sizeof(VkPipelineCacheHeaderVersionOne)) && (header.dataSize <= PIPELINE_CACHE_FILE_MAX_SIZE)) {
+            data.resize((size_t)header.dataSize);
+            if ((fread(data.data(), data.size(), 1, file) != 1) ||
+                (framecompare::hash(data.data(), (uint32_t)data.size(), 1, (uint32_t)data.size()) != header.dataHash)) {
+                data.clear();
+            }
+            dataHash = header.dataHash;
+        }
+        fclose(file);
+    }
 
-        VkMemoryDedicatedAllocateInfo memoryDedicatedAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
-        if (useDedicatedMemory) {
-            memoryDedicatedAllocateInfo.image = m_buffer[i].image;
-            importMemInfo.pNext = &memoryDedicatedAllocateInfo;
+    // the driver header of the blob has to agree as well
+    if (!data.empty()) {
+        VkPipelineCacheHeaderVersionOne blobHeader;
+        memcpy(&blobHeader, data.data(), sizeof(blobHeader));
+        if ((blobHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) || (blobHeader.headerSize < sizeof(blobHeader)) ||
+            (blobHeader.vendorID != key.vendorID) || (blobHeader.deviceID != key.deviceID) ||
+            memcmp(blobHeader.pipelineCacheUUID, key.pipelineCacheUUID, VK_UUID_SIZE)) {
+            data.clear();
         }
+    }
 
-        err = vkAllocateMemory(m_device, &memInfo, 0, &m_buffer[i].mem);
-        assert(!err);
+    VkPipelineCacheCreateInfo pipelineCache = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    pipelineCache.initialDataSize = data.size();
+    pipelineCache.pInitialData = data.empty() ? NULL : data.data();
+    VkResult err = vkCreatePipelineCache(m_device, &pipelineCache, NULL, &m_pipelineCache);
+    if (err && !data.empty()) {
+        data.clear();
+        pipelineCache.initialDataSize = 0;
+        pipelineCache.pInitialData = NULL;
+        err = vkCreatePipelineCache(m_device, &pipelineCache, NULL, &m_pipelineCache);
+    }
+    if (err) {
+        fprintf(stderr, "Vulkan: cannot create the pipeline cache.\n");
+        return false;
+    }
+    if (!data.empty()) {
+        m_pipelineCacheStatus = "loaded";
+    }
+    m_pipelineCacheLoadedSize = data.size();
+    m_pipelineCacheLoadedHash = data.empty() ? 0 : dataHash;
+    return true;
+}
 
-        err = vkBindImageMemory(m_device, m_buffer[i].image, m_buffer[i].mem, 0);
-        assert(!err);
+// at Cleanup when the cache differs from the loaded one, written aside then renamed over config.pipelineCacheFile
+void VkRender::SavePipelineCache()
+{
+    size_t size = 0;
+    if (!m_config.pipelineCacheFile[0] ||
+        (vkGetPipelineCacheData(m_device, m_pipelineCache, &size, NULL) != VK_SUCCESS) ||
+        (size <= sizeof(VkPipelineCacheHeaderVersionOne))) {
+        return;
+    }
+    std::vector<uint8_t> data(size);
+    if (vkGetPipelineCacheData(m_device, m_pipelineCache, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
 
-        VkImageViewCreateInfo imageView = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-        imageView.image = m_buffer[i].image;
-        imageView.format = m_format;
-        imageView.components.r = VK_COMPONENT_SWIZZLE_R;
-        imageView.components.g = VK_COMPONENT_SWIZZLE_G;
-        imageView.components.b = VK_COMPONENT_SWIZZLE_B;
-        imageView.components.a = VK_COMPONENT_SWIZZLE_A;
-        imageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageView.subresourceRange.baseMipLevel = 0;
-        imageView.subresourceRange.levelCount = 1;
-        imageView.subresourceRange.baseArrayLayer = 0;
-        imageView.subresourceRange.layerCount = 1;
-        imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        imageView.flags = 0;
-
-        err = vkCreateImageView(m_device, &imageView, NULL, &m_buffer[i].view);
-        assert(!err);
+    // a driver may rewrite entries in place, only the content tells the cache is unchanged
+    VkPipelineCacheFileHeader header = m_pipelineCacheKey;
+    header.dataSize = size;
+    header.dataHash = framecompare::hash(data.data(), (uint32_t)size, 1, (uint32_t)size);
+    if (m_pipelineCacheLoadedSize && (size == m_pipelineCacheLoadedSize) && (header.dataHash == m_pipelineCacheLoadedHash)) {
+        return;
+    }
 
-        VkImageView attachments[2];
-        attachments[1] = m_depthView;
+    // per process, producers of concurrent runs may save at once
+    char writtenFile[sizeof(m_config.pipelineCacheFile) + 16];
+    snprintf(writtenFile, sizeof(writtenFile), "%s.%lu", m_config.pipelineCacheFile, (unsigned long)GetCurrentProcessId());
+    FILE* file = fopen(writtenFile, "wb");
+    bool res = file && (fwrite(&header, sizeof(header), 1, file) == 1) && (fwrite(data.data(), size, 1, file) == 1);
+    if (file) {
+        res = (fclose(file) == 0) && res;
+    }
+    if (!res || !smode::replaceFile(writtenFile, m_config.pipelineCacheFile)) {
+        remove(writtenFile);
+        fprintf(stderr, "Vulkan: cannot write the pipeline cache %s.\n", m_config.pipelineCacheFile);
+    }
+}
 
-        VkFramebufferCreateInfo frameBufferCreateInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-        frameBufferCreateInfo.renderPass = m_renderPass;
-        frameBufferCreateInfo.attachmentCount = 2;
-        frameBufferCreateInfo.pAttachments = attachments;
-        frameBufferCreateInfo.width = m_pSharedData->width;
-        frameBufferCreateInfo.height = m_pSharedData->height;
-        frameBufferCreateInfo.layers = 1;
+// sized like the shared buffers, recreated by Resize
+bool VkRender::CreateDepthBuffer()
+{
+    VkResult err;
+    VkImageCreateInfo depthImageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    depthImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    depthImageCreateInfo.format = m_depthFormat;
+    depthImageCreateInfo.extent = {(uint32_t)m_config.width, (uint32_t)m_config.height, (uint32_t)1};
+    depthImageCreateInfo.mipLevels = 1;
+    depthImageCreateInfo.arrayLayers = 1;
+    depthImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    depthImageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depthImageCreateInfo.flags = 0;
 
-        attachments[0] = m_buffer[i].view;
-        err = vkCreateFramebuffer(m_device, &frameBufferCreateInfo, NULL, &m_buffer[i].framebuffer);
-        assert(!err);
+    VkMemoryRequirements mem_reqs;
 
-        VkCommandBuffer cmd = m_buffer[i].cmd[1];
-
-        VkCommandBufferInheritanceInfo cmdInheritanceInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
-        cmdInheritanceInfo.renderPass = VK_NULL_HANDLE;
-        cmdInheritanceInfo.subpass = 0;
-        cmdInheritanceInfo.framebuffer = VK_NULL_HANDLE;
-        cmdInheritanceInfo.occlusionQueryEnable = VK_FALSE;
-        cmdInheritanceInfo.queryFlags = 0;
-        cmdInheritanceInfo.pipelineStatistics = 0;
-
-        VkCommandBufferBeginInfo cmdBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-        cmdBeginInfo.flags = 0;
-        cmdBeginInfo.pInheritanceInfo = &cmdInheritanceInfo;
-
-        VkClearValue clearValues[2];
-        memset(clearValues, 0, sizeof(clearValues));
-        clearValues[0].color.float32[0] = 0.1f;
-        clearValues[0].color.float32[1] = 0.1f;
-        clearValues[0].color.float32[2] = 0.4f;
-        clearValues[0].color.float32[3] = 1.0f;
-        clearValues[1].depthStencil.depth = 1.0f;
-        clearValues[1].depthStencil.stencil = 0;
-
-        VkRenderPassBeginInfo renderPassBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-        renderPassBeginInfo.renderPass = m_renderPass;
-        renderPassBeginInfo.framebuffer = m_buffer[i].framebuffer;
-        renderPassBeginInfo.renderArea.offset.x = 0;
-        renderPassBeginInfo.renderArea.offset.y = 0;
-        renderPassBeginInfo.renderArea.extent.width = m_pSharedData->width;
-        renderPassBeginInfo.renderArea.extent.height = m_pSharedData->height;
-        renderPassBeginInfo.clearValueCount = 2;
-        renderPassBeginInfo.pClearValues = clearValues;
-
-        err = vkBeginCommandBuffer(cmd, &cmdBeginInfo);
-        assert(!err);
+    err = vkCreateImage(m_device, &depthImageCreateInfo, NULL, &m_depthImage);
+    assert(!err);
 
-        vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkGetImageMemoryRequirements(m_device, m_depthImage, &mem_reqs);
+    assert(!err);
 
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descSet, 0, NULL);
+    VkMemoryAllocateInfo depthMemAllocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    depthMemAllocInfo.allocationSize = mem_reqs.size;
+    depthMemAllocInfo.memoryTypeIndex = getMemoryTypeIndex(m_memoryProperties, mem_reqs.memoryTypeBits);
 
-        VkViewport viewport;
-        memset(&viewport, 0, sizeof(viewport));
-        viewport.width = (float)m_pSharedData->width;
-        viewport.height = (float)m_pSharedData->height;
-        viewport.minDepth = (float)0.0f;
-        viewport.maxDepth = (float)1.0f;
-        vkCmdSetViewport(cmd, 0, 1, &viewport);
+    err = vkAllocateMemory(m_device, &depthMemAllocInfo, NULL, &m_depthMem);
+    assert(!err);
 
-        VkRect2D scissor;
-        memset(&scissor, 0, sizeof(scissor));
-        scissor.extent.width = m_pSharedData->width;
-        scissor.extent.height = m_pSharedData->height;
-        scissor.offset.x = 0;
-        scissor.offset.y = 0;
-        vkCmdSetScissor(cmd, 0, 1, &scissor);
+    err = vkBindImageMemory(m_device, m_depthImage, m_depthMem, 0);
+    assert(!err);
 
-        vkCmdDraw(cmd, 12 * 3, 1, 0, 0);
-        vkCmdEndRenderPass(cmd);
+    VkImageViewCreateInfo depthImageViewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    depthImageViewCreateInfo.image = VK_NULL_HANDLE;
+    depthImageViewCreateInfo.format = depthImageCreateInfo.format;
+    depthImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    depthImageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+    depthImageViewCreateInfo.subresourceRange.levelCount = 1;
+    depthImageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    depthImageViewCreateInfo.subresourceRange.layerCount = 1;
+    depthImageViewCreateInfo.flags = 0;
+    depthImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    depthImageViewCreateInfo.image = m_depthImage;
+    err = vkCreateImageView(m_device, &depthImageViewCreateInfo, NULL, &m_depthView);
+    assert(!err);
+    return true;
+}
+
+void VkRender::DestroyDepthBuffer()
+{
+    if (m_depthView) {
+        vkDestroyImageView(m_device, m_depthView, NULL);
+        m_depthView = 0;
+    }
+
+    if (m_depthImage) {
+        vkDestroyImage(m_device, m_depthImage, NULL);
+        m_depthImage = 0;
+    }
+
+    if (m_depthMem) {
+        vkFreeMemory(m_device, m_depthMem, NULL);
+        m_depthMem = 0;
+    }
+}
+
+// the heap the presenter placed every shared texture in, imported once for all the buffers
+bool VkRender::ImportSharedHeap(uint32_t memoryTypeIndex)
+{
+    VkImportMemoryWin32HandleInfoKHR importMemInfo = { VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR };
+    importMemInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_HEAP_BIT;
+    importMemInfo.handle = m_pSharedData->Buffer(0).sharedMemHandle;
+
+    VkMemoryAllocateInfo memInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &importMemInfo };
+    memInfo.allocationSize = m_pSharedData->sharedHeapSize;
+    memInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkResult err = vkAllocateMemory(m_device, &memInfo, 0, &m_heapMem);
+    if (err) {
+        fprintf(stderr, "Vulkan: cannot import the shared heap.\n");
+        return false;
+    }
+    return true;
+}
+
+// once every image bound in it is destroyed
+void VkRender::ReleaseSharedHeap()
+{
+    if (m_heapMem) {
+        vkFreeMemory(m_device, m_heapMem, NULL);
+        m_heapMem = 0;
+    }
+}
+
+// imports the shared memory of a buffer, its view, framebuffer and prerecorded draw
+bool VkRender::CreateBufferImage(uint32_t bufferIndex)
+{
+    VkResult err;
+    _Buffer& buffer = m_buffer[bufferIndex];
+    buffer.sharedMemHandle = m_pSharedData->Buffer(bufferIndex).sharedMemHandle;
+    const bool singleHeap = m_pSharedData->sharedHeapSize != 0;
+
+    VkExternalMemoryImageCreateInfo externalMemoryImageCreateInfo = { VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO };
+    externalMemoryImageCreateInfo.handleTypes = singleHeap ? VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_HEAP_BIT : VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT;
+
+    VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, &externalMemoryImageCreateInfo };
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = m_format;
+    imageCreateInfo.extent.width = m_config.width;
+    imageCreateInfo.extent.height = m_config.height;
+    imageCreateInfo.extent.depth = 1;
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (m_convertPipeline ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
+    imageCreateInfo.flags = 0;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    err = vkCreateImage(m_device, &imageCreateInfo, NULL, &buffer.image);
+    assert(!err);
+
+    VkMemoryRequirements memReqs = { };
+    vkGetImageMemoryRequirements(m_device, buffer.image, &memReqs);
+
+    uint32_t memoryTypeIndex = getMemoryTypeIndex(m_memoryProperties, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memoryTypeIndex >= m_memoryProperties.memoryTypeCount) {
+        fprintf(stderr, "Vulkan: Memory doesn't support sharing.\n");
+        return false;
+    }
+
+    if (m_convertPipeline && !ImportPlanarBuffer(bufferIndex)) {
+        return false;
+    }
 
-        err = vkEndCommandBuffer(cmd);
+    if (singleHeap) {
+        // placed by the presenter, no dedicated allocation
+        if (!m_heapMem && !ImportSharedHeap(memoryTypeIndex)) {
+            return false;
+        }
+        err = vkBindImageMemory(m_device, buffer.image, m_heapMem, m_pSharedData->Buffer(bufferIndex).sharedMemOffset);
         assert(!err);
+        return CreateBufferView(bufferIndex);
+    }
 
-        m_buffer[i].rendered = false;
+    VkImportMemoryWin32HandleInfoKHR importMemInfo = { VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR };
+    importMemInfo.handleType = (VkExternalMemoryHandleTypeFlagBits)externalMemoryImageCreateInfo.handleTypes;
+    importMemInfo.handle = buffer.sharedMemHandle;
+
+    VkMemoryAllocateInfo memInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &importMemInfo };
+    memInfo.allocationSize = memReqs.size;
+    memInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkMemoryDedicatedAllocateInfo memoryDedicatedAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+    if (m_useDedicatedMemory) {
+        memoryDedicatedAllocateInfo.image = buffer.image;
+        importMemInfo.pNext = &memoryDedicatedAllocateInfo;
+    }
+
+    err = vkAllocateMemory(m_device, &memInfo, 0, &buffer.mem);
+    assert(!err);
+
+    err = vkBindImageMemory(m_device, buffer.image, buffer.mem, 0);
+    assert(!err);
+
+    return CreateBufferView(bufferIndex);
+}
+
+// view, framebuffer and prerecorded draw of a buffer image bound to its memory
+bool VkRender::CreateBufferView(uint32_t bufferIndex)
+{
+    VkResult err;
+    _Buffer& buffer = m_buffer[bufferIndex];
+
+    VkImageViewCreateInfo imageView = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    imageView.image = buffer.image;
+    imageView.format = m_format;
+    imageView.components.r = VK_COMPONENT_SWIZZLE_R;
+    imageView.components.g = VK_COMPONENT_SWIZZLE_G;
+    imageView.components.b = VK_COMPONENT_SWIZZLE_B;
+    imageView.components.a = VK_COMPONENT_SWIZZLE_A;
+    imageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageView.subresourceRange.baseMipLevel = 0;
+    imageView.subresourceRange.levelCount = 1;
+    imageView.subresourceRange.baseArrayLayer = 0;
+    imageView.subresourceRange.layerCount = 1;
+    imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageView.flags = 0;
+
+    err = vkCreateImageView(m_device, &imageView, NULL, &buffer.view);
+    assert(!err);
+
+    VkImageView attachments[2];
+    attachments[1] = m_depthView;
+
+    VkFramebufferCreateInfo frameBufferCreateInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+    frameBufferCreateInfo.renderPass = m_renderPass;
+    frameBufferCreateInfo.attachmentCount = 2;
+    frameBufferCreateInfo.pAttachments = attachments;
+    frameBufferCreateInfo.width = m_config.width;
+    frameBufferCreateInfo.height = m_config.height;
+    frameBufferCreateInfo.layers = 1;
+
+    attachments[0] = buffer.view;
+    err = vkCreateFramebuffer(m_device, &frameBufferCreateInfo, NULL, &buffer.framebuffer);
+    assert(!err);
+
+    VkCommandBuffer cmd = buffer.cmd;
+
+    VkCommandBufferInheritanceInfo cmdInheritanceInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    cmdInheritanceInfo.renderPass = VK_NULL_HANDLE;
+    cmdInheritanceInfo.subpass = 0;
+    cmdInheritanceInfo.framebuffer = VK_NULL_HANDLE;
+    cmdInheritanceInfo.occlusionQueryEnable = VK_FALSE;
+    cmdInheritanceInfo.queryFlags = 0;
+    cmdInheritanceInfo.pipelineStatistics = 0;
+
+    VkCommandBufferBeginInfo cmdBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    cmdBeginInfo.flags = 0;
+    cmdBeginInfo.pInheritanceInfo = &cmdInheritanceInfo;
+
+    VkClearValue clearValues[2];
+    memset(clearValues, 0, sizeof(clearValues));
+    clearValues[0].color.float32[0] = 0.1f;
+    clearValues[0].color.float32[1] = 0.1f;
+    clearValues[0].color.float32[2] = 0.4f;
+    clearValues[0].color.float32[3] = 1.0f;
+    clearValues[1].depthStencil.depth = 1.0f;
+    clearValues[1].depthStencil.stencil = 0;
+
+    VkRenderPassBeginInfo renderPassBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+    renderPassBeginInfo.renderPass = m_renderPass;
+    renderPassBeginInfo.framebuffer = buffer.framebuffer;
+    renderPassBeginInfo.renderArea.offset.x = 0;
+    renderPassBeginInfo.renderArea.offset.y = 0;
+    renderPassBeginInfo.renderArea.extent.width = m_config.width;
+    renderPassBeginInfo.renderArea.extent.height = m_config.height;
+    renderPassBeginInfo.clearValueCount = 2;
+    renderPassBeginInfo.pClearValues = clearValues;
+
+    err = vkBeginCommandBuffer(cmd, &cmdBeginInfo);
+    assert(!err);
+
+    if (m_queryPool) {
+        // after the shared fence wait, the submission waits on it at the top of the pipe
+        vkCmdResetQueryPool(cmd, m_queryPool, 2 * bufferIndex, 2);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, 2 * bufferIndex);
+    }
+
+    vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    // the MVP slot of this buffer, written by Render before each submission
+    const uint32_t ubufOffset = (uint32_t)(m_ubufStride * bufferIndex);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descSet, 1, &ubufOffset);
+
+    VkViewport viewport;
+    memset(&viewport, 0, sizeof(viewport));
+    viewport.width = (float)m_config.width;
+    viewport.height = (float)m_config.height;
+    viewport.minDepth = (float)0.0f;
+    viewport.maxDepth = (float)1.0f;
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+    VkRect2D scissor;
+    memset(&scissor, 0, sizeof(scissor));
+    scissor.extent.width = m_config.width;
+    scissor.extent.height = m_config.height;
+    scissor.offset.x = 0;
+    scissor.offset.y = 0;
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    vkCmdDraw(cmd, 12 * 3, 1, 0, 0);
+    vkCmdEndRenderPass(cmd);
+
+    if (m_convertPipeline) {
+        RecordConvert(bufferIndex, cmd);
+    }
+
+    if (m_queryPool) {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, 2 * bufferIndex + 1);
+    }
+
+    err = vkEndCommandBuffer(cmd);
+    assert(!err);
+    return true;
+}
+
+// the semaphore, fence and command buffers survive a resize
+void VkRender::DestroyBufferImage(uint32_t bufferIndex)
+{
+    _Buffer& buffer = m_buffer[bufferIndex];
+    if (buffer.framebuffer) {
+        vkDestroyFramebuffer(m_device, buffer.framebuffer, NULL);
+        buffer.framebuffer = 0;
+    }
+    if (buffer.view) {
+        vkDestroyImageView(m_device, buffer.view, NULL);
+        buffer.view = 0;
+    }
+    if (buffer.image) {
+        vkDestroyImage(m_device, buffer.image, NULL);
+        buffer.image = 0;
+    }
+    if (buffer.mem) {
+        vkFreeMemory(m_device, buffer.mem, NULL);
+        buffer.mem = 0;
+    }
+    if (buffer.planarBuffer) {
+        vkDestroyBuffer(m_device, buffer.planarBuffer, NULL);
+        buffer.planarBuffer = 0;
+    }
+    if (buffer.planarMem) {
+        vkFreeMemory(m_device, buffer.planarMem, NULL);
+        buffer.planarMem = 0;
+    }
+}
+
+// the planar buffer of the presenter, rewritten by the compute pass after each draw
+bool VkRender::ImportPlanarBuffer(uint32_t bufferIndex)
+{
+    VkResult err;
+    _Buffer& buffer = m_buffer[bufferIndex];
+
+    VkExternalMemoryBufferCreateInfo externalMemoryBufferCreateInfo = { VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO };
+    externalMemoryBufferCreateInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT;
+
+    VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, &externalMemoryBufferCreateInfo };
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferCreateInfo.size = m_pSharedData->planarSize;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    err = vkCreateBuffer(m_device, &bufferCreateInfo, NULL, &buffer.planarBuffer);
+    assert(!err);
+
+    VkMemoryRequirements memReqs = { };
+    vkGetBufferMemoryRequirements(m_device, buffer.planarBuffer, &memReqs);
+
+    uint32_t memoryTypeIndex = getMemoryTypeIndex(m_memoryProperties, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memoryTypeIndex >= m_memoryProperties.memoryTypeCount) {
+        fprintf(stderr, "Vulkan: Memory doesn't support sharing.\n");
+        return false;
+    }
+
+    VkImportMemoryWin32HandleInfoKHR importMemInfo = { VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR };
+    importMemInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT;
+    importMemInfo.handle = m_pSharedData->Buffer(bufferIndex).planarMemHandle;
+
+    // a committed resource, always a dedicated allocation
+    VkMemoryDedicatedAllocateInfo memoryDedicatedAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+    memoryDedicatedAllocateInfo.buffer = buffer.planarBuffer;
+    importMemInfo.pNext = &memoryDedicatedAllocateInfo;
+
+    VkMemoryAllocateInfo memInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &importMemInfo };
+    memInfo.allocationSize = memReqs.size;
+    memInfo.memoryTypeIndex = memoryTypeIndex;
+
+    err = vkAllocateMemory(m_device, &memInfo, 0, &buffer.planarMem);
+    if (err) {
+        fprintf(stderr, "Vulkan: cannot import planar buffer %u.\n", bufferIndex);
+        return false;
+    }
+
+    err = vkBindBufferMemory(m_device, buffer.planarBuffer, buffer.planarMem, 0);
+    assert(!err);
+    return true;
+}
+
+// push constants of VkRenderConvert.comp
+struct ConvertParams {
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitchWords;  // of both planes
+    uint32_t chromaWords; // offset of the chroma plane
+    uint32_t flags;       // 1 P010, 2 sRGB image, its samples are encoded back to the stored bytes
+};
+
+// config.recordYuvOnGpu: compute pipeline and one descriptor set per buffer, written when its image is recorded
+bool VkRender::InitConvert()
+{
+    VkResult err;
+    if (!m_pSharedData->planarSize) {
+        fprintf(stderr, "Vulkan: the presenter shares no planar buffer to convert into.\n");
+        return false;
+    }
+
+    VkSamplerCreateInfo samplerCreateInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    err = vkCreateSampler(m_device, &samplerCreateInfo, NULL, &m_convertSampler);
+    assert(!err);
+
+    VkDescriptorSetLayoutBinding bindings[2];
+    memset(&bindings, 0, sizeof(bindings));
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    descriptorSetLayoutCreateInfo.bindingCount = 2;
+    descriptorSetLayoutCreateInfo.pBindings = bindings;
+    err = vkCreateDescriptorSetLayout(m_device, &descriptorSetLayoutCreateInfo, NULL, &m_convertDescLayout);
+    assert(!err);
+
+    VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ConvertParams) };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &m_convertDescLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    err = vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, NULL, &m_convertPipelineLayout);
+    assert(!err);
+
+    VkShaderModule cs = createShaderModule(m_device, VkRenderConvert_comp_spirv, sizeof(VkRenderConvert_comp_spirv));
+
+    VkComputePipelineCreateInfo pipeline = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    pipeline.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline.stage.module = cs;
+    pipeline.stage.pName = "main";
+    pipeline.layout = m_convertPipelineLayout;
+
+    const int64_t pipelineTicks = smode::getTicks();
+    err = vkCreateComputePipelines(m_device, m_pipelineCache, 1, &pipeline, NULL, &m_convertPipeline);
+    m_pipelineTicks += smode::getTicks() - pipelineTicks;
+    vkDestroyShaderModule(m_device, cs, NULL);
+    if (err) {
+        fprintf(stderr, "Vulkan: cannot create the conversion pipeline.\n");
+        return false;
+    }
+
+    const uint32_t numBuffers = (uint32_t)m_buffer.size();
+    VkDescriptorPoolSize typeCounts[2] = { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, numBuffers },
+                                           { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, numBuffers } };
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    descriptorPoolCreateInfo.maxSets = numBuffers;
+    descriptorPoolCreateInfo.poolSizeCount = 2;
+    descriptorPoolCreateInfo.pPoolSizes = typeCounts;
+    err = vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, NULL, &m_convertDescPool);
+    assert(!err);
+
+    std::vector<VkDescriptorSetLayout> setLayouts(numBuffers, m_convertDescLayout);
+    std::vector<VkDescriptorSet> descSets(numBuffers);
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    descriptorSetAllocInfo.descriptorPool = m_convertDescPool;
+    descriptorSetAllocInfo.descriptorSetCount = numBuffers;
+    descriptorSetAllocInfo.pSetLayouts = setLayouts.data();
+    err = vkAllocateDescriptorSets(m_device, &descriptorSetAllocInfo, descSets.data());
+    assert(!err);
+    for (uint32_t i = 0; i < numBuffers; i++) {
+        m_buffer[i].convertDescSet = descSets[i];
     }
+    return true;
+}
+
+// behind the render pass: the image is sampled into the planar buffer, then goes back to the attachment layout
+void VkRender::RecordConvert(uint32_t bufferIndex, VkCommandBuffer cmd)
+{
+    _Buffer& buffer = m_buffer[bufferIndex];
 
+    // the device is idle, nothing in flight uses the set
+    VkDescriptorImageInfo descImageInfo = { m_convertSampler, buffer.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkDescriptorBufferInfo descBufferInfo = { buffer.planarBuffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet descriptorWrites[] = { { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET },
+                                                { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET } };
+    descriptorWrites[0].dstSet = buffer.convertDescSet;
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[0].pImageInfo = &descImageInfo;
+
+    descriptorWrites[1].dstSet = buffer.convertDescSet;
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrites[1].pBufferInfo = &descBufferInfo;
+
+    vkUpdateDescriptorSets(m_device, 2, descriptorWrites, 0, NULL);
+
+    VkImageMemoryBarrier imageBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = buffer.image;
+    imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarrier.subresourceRange.levelCount = 1;
+    imageBarrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &imageBarrier);
+
+    const uint32_t format = m_config.recordYuvFormat;
+    ConvertParams params;
+    params.width = m_config.width;
+    params.height = m_config.height;
+    params.pitchWords = colorconvert::getPitch(m_config.width, format) / 4;
+    params.chromaWords = (uint32_t)(colorconvert::getChromaOffset(m_config.width, m_config.height, format) / 4);
+    params.flags = (format == colorconvert::FORMAT_P010 ? 1 : 0) |
+                   ((m_config.format == SHARED_FORMAT_RGBA8_SRGB || m_config.format == SHARED_FORMAT_BGRA8_SRGB) ? 2 : 0);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_convertPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_convertPipelineLayout, 0, 1, &buffer.convertDescSet, 0, NULL);
+    vkCmdPushConstants(cmd, m_convertPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vkCmdDispatch(cmd, ((m_config.width + 3) / 4 + 7) / 8, ((m_config.height + 1) / 2 + 7) / 8, 1);
+
+    // the shared fence signal makes the buffer writes visible to the presenter
+    imageBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, &imageBarrier);
+}
+
+void VkRender::UpdateViewProjection()
+{
     Vec3 eyePos = { 0.f, 3.f, -6.f };
     Vec3 origin = { 0.f, 0.5f, 0.f };
     Vec3 upVector = { 0.f, 1.f, 0.f };
 
     Mat4x4 projMatrix, viewMatrix;
-    perspective(projMatrix, (float)(45.f * M_PI / 180.f), (float)m_pSharedData->width / (float)m_pSharedData->height, 0.1f, 100.0f);
+    perspective(projMatrix, (float)(45.f * M_PI / 180.f), (float)m_config.width / (float)m_config.height, 0.1f, 100.0f);
     lookAt(viewMatrix, eyePos, origin, upVector);
     matrix_multiply(m_viewProjMatrix, projMatrix, viewMatrix);
+}
 
-    //m_currentBuffer = 0;
-    //m_numFrames = 0;
+// the presenter reallocated the shared buffers: only the memory imports and what depends on the size are recreated
+bool VkRender::Resize()
+{
+    if (!m_initialized)
+        return false;
 
-    m_initialized = true;
+    // frames in flight still render into the old images
+    vkDeviceWaitIdle(m_device);
+    for (uint32_t i = 0; i < m_buffer.size(); i++) {
+        ReadTimestamps(i);
+        DestroyBufferImage(i);
+    }
+    ReleaseSharedHeap();
+    DestroyDepthBuffer();
 
+    m_config = m_pSharedData->ReadConfig();
+    if (!CreateDepthBuffer()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < m_buffer.size(); i++) {
+        if (!CreateBufferImage(i)) {
+            return false;
+        }
+    }
+    UpdateViewProjection();
     return true;
 }
 
@@ -867,17 +1446,52 @@ void VkRender::Cleanup()
     if (m_device) {
         vkDeviceWaitIdle(m_device);
 
+        if (m_queryPool) {
+            for (uint32_t i = 0; i < m_buffer.size(); i++) {
+                ReadTimestamps(i);
+            }
+            vkDestroyQueryPool(m_device, m_queryPool, NULL);
+            m_queryPool = 0;
+        }
+        m_gpuTimeline.clear();
+
         if (m_descPool) {
             vkDestroyDescriptorPool(m_device, m_descPool, NULL);
             m_descPool = 0;
         }
 
+        if (m_convertDescPool) {
+            vkDestroyDescriptorPool(m_device, m_convertDescPool, NULL);
+            m_convertDescPool = 0;
+        }
+
+        if (m_convertPipeline) {
+            vkDestroyPipeline(m_device, m_convertPipeline, NULL);
+            m_convertPipeline = 0;
+        }
+
+        if (m_convertPipelineLayout) {
+            vkDestroyPipelineLayout(m_device, m_convertPipelineLayout, NULL);
+            m_convertPipelineLayout = 0;
+        }
+
+        if (m_convertDescLayout) {
+            vkDestroyDescriptorSetLayout(m_device, m_convertDescLayout, NULL);
+            m_convertDescLayout = 0;
+        }
+
+        if (m_convertSampler) {
+            vkDestroySampler(m_device, m_convertSampler, NULL);
+            m_convertSampler = 0;
+        }
+
         if (m_pipeline) {
             vkDestroyPipeline(m_device, m_pipeline, NULL);
             m_pipeline = 0;
         }
 
         if (m_pipelineCache) {
+            SavePipelineCache();
             vkDestroyPipelineCache(m_device, m_pipelineCache, NULL);
             m_pipelineCache = 0;
         }
@@ -897,11 +1511,8 @@ void VkRender::Cleanup()
             m_descLayout = 0;
         }
 
-        for (uint32_t i = 0; i < m_pSharedData->numSharedBuffers; i++) {
-            if (m_buffer[i].framebuffer) {
-                vkDestroyFramebuffer(m_device, m_buffer[i].framebuffer, NULL);
-                m_buffer[i].framebuffer = 0;
-            }
+        for (uint32_t i = 0; i < m_buffer.size(); i++) {
+            DestroyBufferImage(i);
             if (m_buffer[i].fence) {
                 vkDestroyFence(m_device, m_buffer[i].fence, NULL);
                 m_buffer[i].fence = 0;
@@ -910,48 +1521,25 @@ void VkRender::Cleanup()
                 vkDestroySemaphore(m_device, m_buffer[i].semaphore, NULL);
                 m_buffer[i].semaphore = 0;
             }
-            if (m_buffer[i].image) {
-                vkDestroyImage(m_device, m_buffer[i].image, NULL);
-                m_buffer[i].image = 0;
-            }
-            if (m_buffer[i].view) {
-                vkDestroyImageView(m_device, m_buffer[i].view, NULL);
-                m_buffer[i].view = 0;
-            }
-            if (m_buffer[i].mem) {
-                vkFreeMemory(m_device, m_buffer[i].mem, NULL);
-                m_buffer[i].mem = 0;
-            }
-            if (m_buffer[i].cmd[0]) {
-                vkFreeCommandBuffers(m_device, m_cmdPool, 1, &m_buffer[i].cmd[0]);
-                m_buffer[i].cmd[0] = 0;
-            }
-            if (m_buffer[i].cmd[1]) {
-                vkFreeCommandBuffers(m_device, m_cmdPool, 1, &m_buffer[i].cmd[1]);
-                m_buffer[i].cmd[1] = 0;
+            if (m_buffer[i].cmd) {
+                vkFreeCommandBuffers(m_device, m_cmdPool, 1, &m_buffer[i].cmd);
+                m_buffer[i].cmd = 0;
             }
         }
+        ReleaseSharedHeap();
 
-        if (m_depthView) {
-            vkDestroyImageView(m_device, m_depthView, NULL);
-            m_depthView = 0;
-        }
-
-        if (m_depthImage) {
-            vkDestroyImage(m_device, m_depthImage, NULL);
-            m_depthImage = 0;
-        }
-
-        if (m_depthMem) {
-            vkFreeMemory(m_device, m_depthMem, NULL);
-            m_depthMem = 0;
-        }
+        DestroyDepthBuffer();
 
         if (m_ubuf) {
             vkDestroyBuffer(m_device, m_ubuf, NULL);
             m_ubuf = 0;
         }
 
+        if (m_ubufMapped) {
+            vkUnmapMemory(m_device, m_ubufMem);
+            m_ubufMapped = nullptr;
+        }
+
         if (m_ubufMem) {
             vkFreeMemory(m_device, m_ubufMem, NULL);
             m_ubufMem = 0;
@@ -992,9 +1580,10 @@ void VkRender::Render()
     uint32_t m_currentBuffer = m_pSharedData->currentBufferIndex;
 
     float angle;
-    /*if (m_pSharedData->verify) {
-        angle = (float)M_PI * (m_numFrames % 4) / 2.f;
-    } else if (m_pSharedData->captureFile) {
+    if (m_config.validate) {
+        // periodic in the frame id, every frame of a phase is identical
+        angle = 2.f * (float)M_PI * (float)(m_submitCount % FRAME_VALIDATE_PERIOD) / (float)FRAME_VALIDATE_PERIOD;
+    } else /*if (m_pSharedData->captureFile) {
         angle = (float)M_PI * (m_numFrames % 1000) / 500.f;
     } else*/ {
         static ULONGLONG timeStart = 0;
@@ -1010,24 +1599,26 @@ void VkRender::Render()
     matrix_multiply(modelViewProjMatrix, m_viewProjMatrix, modelMatrix);
 
     if (m_buffer[m_currentBuffer].rendered) {
-        vkWaitForFences(m_device, 1, &m_buffer[m_currentBuffer].fence, VK_TRUE, 0xFFFFFFFFFFFFFFFFULL);
+        if (m_config.timelineSemaphores) {
+            // the shared fence itself, the presenter may already have signaled it further
+            VkSemaphoreWaitInfo semaphoreWaitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+            semaphoreWaitInfo.semaphoreCount = 1;
+            semaphoreWaitInfo.pSemaphores = &m_buffer[m_currentBuffer].semaphore;
+            semaphoreWaitInfo.pValues = &m_buffer[m_currentBuffer].signalValue;
+            vkWaitSemaphoresKHR(m_device, &semaphoreWaitInfo, 0xFFFFFFFFFFFFFFFFULL);
+        } else {
+            vkWaitForFences(m_device, 1, &m_buffer[m_currentBuffer].fence, VK_TRUE, 0xFFFFFFFFFFFFFFFFULL);
+            vkResetFences(m_device, 1, &m_buffer[m_currentBuffer].fence); // else the next wait returns at once
+        }
+        ReadTimestamps(m_currentBuffer);
     }
-    err = vkResetCommandBuffer(m_buffer[m_currentBuffer].cmd[0], 0);
-    assert(!err);
+    // the previous submission of this buffer is done with its slot, the prerecorded command buffer reads it
+    memcpy(m_ubufMapped + m_ubufStride * m_currentBuffer, &modelViewProjMatrix[0][0], sizeof(modelViewProjMatrix));
 
-    VkCommandBufferBeginInfo cmdBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    err = vkBeginCommandBuffer(m_buffer[m_currentBuffer].cmd[0], &cmdBeginInfo);
-    assert(!err);
-
-    vkCmdUpdateBuffer(m_buffer[m_currentBuffer].cmd[0], m_ubuf, 0, sizeof(modelViewProjMatrix), reinterpret_cast<uint32_t const *>(&modelViewProjMatrix[0][0]));
-
-    err = vkEndCommandBuffer(m_buffer[m_currentBuffer].cmd[0]);
-    assert(!err);
-
-    const UINT64 waitFence = ((UINT64)m_buffer[m_currentBuffer].semaphoreFenceValue);
+    const UINT64 waitFence = m_pSharedData->Buffer(m_currentBuffer).sharedFenceValue;
     const UINT64 signalFence = waitFence + 1;
 
-    m_buffer[m_currentBuffer].semaphoreFenceValue += 2;
+    m_pSharedData->Buffer(m_currentBuffer).sharedFenceValue = signalFence;
 
 
     VkD3D12FenceSubmitInfoKHR fenceSubmitInfo = { VK_STRUCTURE_TYPE_D3D12_FENCE_SUBMIT_INFO_KHR };
@@ -1036,15 +1627,30 @@ void VkRender::Render()
     fenceSubmitInfo.signalSemaphoreValuesCount = 1;
     fenceSubmitInfo.pSignalSemaphoreValues = &signalFence; 
 
-    VkSubmitInfo submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO, &fenceSubmitInfo };
-    submit_info.commandBufferCount = 2;
-    submit_info.pCommandBuffers = m_buffer[m_currentBuffer].cmd;
+    // same values, the semaphore type carries them
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timelineSubmitInfo.waitSemaphoreValueCount = 1;
+    timelineSubmitInfo.pWaitSemaphoreValues = &waitFence;
+    timelineSubmitInfo.signalSemaphoreValueCount = 1;
+    timelineSubmitInfo.pSignalSemaphoreValues = &signalFence;
+
+    VkSubmitInfo submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submit_info.pNext = m_config.timelineSemaphores ? (const void*)&timelineSubmitInfo : (const void*)&fenceSubmitInfo;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &m_buffer[m_currentBuffer].cmd;
+    const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
     submit_info.waitSemaphoreCount = 1;
     submit_info.pWaitSemaphores = &m_buffer[m_currentBuffer].semaphore;
+    submit_info.pWaitDstStageMask = &waitStageMask;
     submit_info.signalSemaphoreCount = 1;
     submit_info.pSignalSemaphores = &m_buffer[m_currentBuffer].semaphore;
 
-    err = vkQueueSubmit(m_queue, 1, &submit_info, m_buffer[m_currentBuffer].fence);
+    m_buffer[m_currentBuffer].submitTicks = smode::getTicks();
+    m_buffer[m_currentBuffer].frameId = m_submitCount++;
+    m_buffer[m_currentBuffer].timestampsPending = m_queryPool != nullptr;
+    m_buffer[m_currentBuffer].signalValue = signalFence;
+
+    err = vkQueueSubmit(m_queue, 1, &submit_info, m_buffer[m_currentBuffer].fence); // null with timeline semaphores
     assert(!err);
 
     m_buffer[m_currentBuffer].rendered = true;
@@ -1052,5 +1658,79 @@ void VkRender::Render()
     //m_numFrames++;
 }
 
+bool VkRender::InitTimestamps(VkPhysicalDevice physicalDevice, bool calibratedTimestamps)
+{
+    if (!calibratedTimestamps)
+        return false;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    // queue family 0 is the one in use
+    uint32_t queueFamilyCount = 1;
+    VkQueueFamilyProperties queueFamilyProperties;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, &queueFamilyProperties);
+    if (!queueFamilyCount || !queueFamilyProperties.timestampValidBits || properties.limits.timestampPeriod <= 0.f)
+        return false;
+    m_timestampMask = queueFamilyProperties.timestampValidBits >= 64 ? ~0ULL : (1ULL << queueFamilyProperties.timestampValidBits) - 1;
+
+    // the calibration reads the device clock and QueryPerformanceCounter together
+    PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT vkGetPhysicalDeviceCalibrateableTimeDomainsEXT =
+        (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(m_inst, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+    if (!vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+        return false;
+
+    uint32_t timeDomainCount = 0;
+    vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &timeDomainCount, NULL);
+    std::vector<VkTimeDomainEXT> timeDomains(timeDomainCount);
+    vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &timeDomainCount, timeDomains.data());
+
+    bool deviceDomain = false;
+    bool performanceCounterDomain = false;
+    for (uint32_t i = 0; i < timeDomainCount; i++) {
+        deviceDomain |= timeDomains[i] == VK_TIME_DOMAIN_DEVICE_EXT;
+        performanceCounterDomain |= timeDomains[i] == VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+    }
+    if (!deviceDomain || !performanceCounterDomain)
+        return false;
+
+    m_gpuClock.device = m_device;
+    m_gpuClock.vkGetCalibratedTimestampsEXT = (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(m_device, "vkGetCalibratedTimestampsEXT");
+    m_gpuClock.timestampPeriod = properties.limits.timestampPeriod;
+    if (!m_gpuClock.vkGetCalibratedTimestampsEXT)
+        return false;
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = 2 * m_pSharedData->numSharedBuffers;
+    if (vkCreateQueryPool(m_device, &queryPoolCreateInfo, NULL, &m_queryPool) != VK_SUCCESS) {
+        m_queryPool = nullptr;
+        return false;
+    }
+
+    if (!m_gpuTimeline.init(&m_gpuClock, &m_pSharedData->renderQueue, "vulkan queue")) {
+        vkDestroyQueryPool(m_device, m_queryPool, NULL);
+        m_queryPool = nullptr;
+        return false;
+    }
+    return true;
+}
+
+// once the buffer fence is signaled, a few frames after the submission
+void VkRender::ReadTimestamps(uint32_t bufferIndex)
+{
+    _Buffer& buffer = m_buffer[bufferIndex];
+    if (!buffer.timestampsPending)
+        return;
+    buffer.timestampsPending = false;
+
+    uint64_t timestamps[2];
+    VkResult err = vkGetQueryPoolResults(m_device, m_queryPool, 2 * bufferIndex, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (err != VK_SUCCESS)
+        return;
+
+    m_gpuTimeline.report(buffer.frameId, buffer.submitTicks, timestamps[0] & m_timestampMask, timestamps[1] & m_timestampMask);
+}
+
 AbstractRender* newVKRender()
   {return new VkRender();}
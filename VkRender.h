@@ -10,18 +10,51 @@
 #define _VK_RENDER_H_
 
 #include <vulkan/vulkan.h>
-#include "DX12SharedData.h" // for MAX_SHARED_BUFFERS && AbstractRender
+#include "DX12SharedData.h" // for AbstractRender
+#include "GpuTimeline.h"
+#include <vector>
 
 typedef float Vec3[3];
 typedef float Vec4[4];
 typedef Vec4 Mat4x4[4];
 
+// device timestamps against QueryPerformanceCounter, the smode::getTicks() clock (VK_EXT_calibrated_timestamps)
+class VkGpuClock : public GpuClock
+{
+public:
+    VkDevice device = nullptr;
+    PFN_vkGetCalibratedTimestampsEXT vkGetCalibratedTimestampsEXT = nullptr;
+    float timestampPeriod = 0.f; // nanoseconds per timestamp tick
+
+    uint64_t getTimestampFrequency() override;
+    bool getCalibration(uint64_t& gpuTimestamp, int64_t& cpuTicks) override;
+};
+
+// ahead of the vkGetPipelineCacheData blob in config.pipelineCacheFile, the blob is only handed back to
+// the device and driver that produced it: a driver is not required to survive a foreign or torn one
+struct VkPipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t driverUUID[VK_UUID_SIZE];
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    uint64_t dataHash; // framecompare::hash of the blob
+};
+
 class VkRender : public AbstractRender // SMODE
 {
 private:
     struct DX12SharedData* m_pSharedData = nullptr;
+    DX12SharedConfig m_config = { 0, }; // snapshot taken at Init
     PFN_vkImportSemaphoreWin32HandleKHR vkImportSemaphoreWin32HandleKHR = nullptr;
+    PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR = nullptr; // config.timelineSemaphores
     VkFormat m_format = VK_FORMAT_R8G8B8A8_UNORM;
+    VkFormat m_depthFormat = VK_FORMAT_D16_UNORM;
+    bool m_useDedicatedMemory = false;
     VkPhysicalDeviceMemoryProperties m_memoryProperties = { 0, };
     Mat4x4 m_viewProjMatrix = { 0, };
 
@@ -30,6 +63,11 @@ private:
     VkQueue m_queue = nullptr;
     VkCommandPool m_cmdPool = nullptr;
     VkPipelineCache m_pipelineCache = nullptr;
+    VkPipelineCacheFileHeader m_pipelineCacheKey = { 0, }; // of this device, dataSize and dataHash unset
+    size_t m_pipelineCacheLoadedSize = 0;
+    uint64_t m_pipelineCacheLoadedHash = 0;              // dataHash of the loaded file, SavePipelineCache skips an identical cache
+    const char* m_pipelineCacheStatus = "disabled";      // startup report, see LoadPipelineCache
+    int64_t m_pipelineTicks = 0;                          // spent creating pipelines at Init
     VkPipeline m_pipeline = nullptr;
     VkRenderPass m_renderPass = nullptr;
     VkPipelineLayout m_pipelineLayout = nullptr;
@@ -39,10 +77,25 @@ private:
     VkImage m_depthImage = nullptr;
     VkDeviceMemory m_depthMem = nullptr;
     VkImageView m_depthView = nullptr;
-    VkBuffer m_ubuf = nullptr;
+    VkBuffer m_ubuf = nullptr;          // one MVP slot per shared buffer, bound at its dynamic offset
     VkDeviceMemory m_ubufMem = nullptr;
+    uint8_t* m_ubufMapped = nullptr;    // m_ubufMem persistently mapped, host coherent
+    VkDeviceSize m_ubufStride = 0;      // between two slots, minUniformBufferOffsetAlignment
     VkBuffer m_vbuf = nullptr;
     VkDeviceMemory m_vbufMem = nullptr;
+    VkDeviceMemory m_heapMem = nullptr; // single shared heap import every buffer image is bound in, null without
+    VkQueryPool m_queryPool = nullptr; // begin and end timestamps of each buffer submission, null when unsupported
+    uint64_t m_timestampMask = 0;      // timestampValidBits
+    VkGpuClock m_gpuClock;
+    GpuTimeline m_gpuTimeline;
+    UINT64 m_submitCount = 0;
+
+    // config.recordYuvOnGpu: compute pass converting each frame into the planar buffer of the presenter
+    VkPipeline m_convertPipeline = nullptr;
+    VkPipelineLayout m_convertPipelineLayout = nullptr;
+    VkDescriptorSetLayout m_convertDescLayout = nullptr;
+    VkDescriptorPool m_convertDescPool = nullptr;
+    VkSampler m_convertSampler = nullptr;
 
     struct _Buffer {
         HANDLE                  sharedMemHandle;
@@ -50,13 +103,20 @@ private:
         VkFramebuffer           framebuffer;
         VkImage                 image;
         VkDeviceMemory          mem;
-        VkCommandBuffer         cmd[2];
+        VkCommandBuffer         cmd;               // prerecorded, resubmitted as is every frame
         VkImageView             view;
-        VkSemaphore             semaphore;
-        uint64_t                semaphoreFenceValue;
-        VkFence                 fence;
+        VkBuffer                planarBuffer;      // imported planarMemHandle, null without conversion
+        VkDeviceMemory          planarMem;
+        VkDescriptorSet         convertDescSet;
+        VkSemaphore             semaphore;         // the imported shared fence, binary or timeline
+        VkFence                 fence;             // signaled with the submission, null with timeline semaphores
+        UINT64                  signalValue;       // of the last submission, waited on the timeline semaphore
         bool                    rendered;
-    } m_buffer[MAX_SHARED_BUFFERS] = { 0, };
+        bool                    timestampsPending; // submitted with timestamps not read back yet
+        int64_t                 submitTicks;
+        UINT64                  frameId;
+    };
+    std::vector<_Buffer> m_buffer; // one per shared buffer
 
     //uint32_t m_currentBuffer = 0;
     //uint32_t m_numFrames = 0;
@@ -70,6 +130,24 @@ public:
     void Cleanup() override;
     void Render() override;
     bool Initialized() override  { return m_initialized; }
+    bool Resize() override;
+
+private:
+    bool CreateDepthBuffer();
+    void DestroyDepthBuffer();
+    bool CreateBufferImage(uint32_t bufferIndex);
+    bool CreateBufferView(uint32_t bufferIndex);
+    bool ImportPlanarBuffer(uint32_t bufferIndex);
+    void RecordConvert(uint32_t bufferIndex, VkCommandBuffer cmd);
+    bool InitConvert();
+    void DestroyBufferImage(uint32_t bufferIndex);
+    bool ImportSharedHeap(uint32_t memoryTypeIndex);
+    void ReleaseSharedHeap();
+    void UpdateViewProjection();
+    bool InitTimestamps(VkPhysicalDevice physicalDevice, bool calibratedTimestamps);
+    bool LoadPipelineCache(VkPhysicalDevice physicalDevice);
+    void SavePipelineCache();
+    void ReadTimestamps(uint32_t bufferIndex);
 };
 
 #endif // _VK_RENDER_H_
@@ -0,0 +1,22 @@
+#version 450
+
+layout(binding = 0) uniform _ubuf {
+    mat4 MVP;
+} ubuf;
+
+layout(binding = 1) uniform _vbuf {
+    vec4 position[12 * 3];
+    vec4 color[6];
+} vbuf;
+
+layout (location = 0) out vec4 color;
+
+void main()
+{
+   color = vbuf.color[gl_VertexIndex / 6];
+   gl_Position = ubuf.MVP * vbuf.position[gl_VertexIndex];
+
+   // GL->VK conventions
+   gl_Position.y = -gl_Position.y;
+   gl_Position.z = (gl_Position.z + gl_Position.w) / 2.0;
+}